@@ -0,0 +1,438 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "autostartlauncher.h"
+#include "autostartlauncher_p.h"
+#include "xdgdirs_p_p.h"
+#include "logging_p.h"
+
+namespace Liri {
+
+// Session phases of gnome-session, in order
+static const char *const phaseNames[] = {
+    "EarlyInitialization",
+    "PreDisplayServer",
+    "DisplayServer",
+    "Initialization",
+    "WindowManager",
+    "Panel",
+    "Desktop",
+    "Applications",
+};
+
+static bool isEnabled(const DesktopFile &file)
+{
+    static const char *const keys[] = { "X-Liri-Autostart-Enabled", "X-GNOME-Autostart-enabled" };
+
+    for (const char *key : keys) {
+        const QString value = file.value(QLatin1String(key)).toString();
+        if (!value.isEmpty())
+            return value != QLatin1String("false");
+    }
+
+    return true;
+}
+
+static int phaseOf(const DesktopFile &file)
+{
+    const QStringList phases = AutoStartLauncher::phases();
+
+    QString phase = file.value(QStringLiteral("X-Liri-Autostart-Phase")).toString();
+    if (phase.isEmpty())
+        phase = file.value(QStringLiteral("X-GNOME-Autostart-Phase")).toString();
+    if (phase.isEmpty()) {
+        static const char *const kdePhases[] = { "Initialization", "Desktop", "Applications" };
+
+        bool ok = false;
+        const int kdePhase = file.value(QStringLiteral("X-KDE-autostart-phase")).toString().toInt(&ok);
+        if (ok && kdePhase >= 0 && kdePhase < 3)
+            phase = QLatin1String(kdePhases[kdePhase]);
+    }
+
+    const int index = static_cast<int>(phases.indexOf(phase));
+    return index >= 0 ? index : static_cast<int>(phases.size()) - 1;
+}
+
+// Name of an entry as used by the ordering hints
+static QString entryName(const QString &fileName)
+{
+    QString name = QFileInfo(fileName).fileName();
+    if (name.endsWith(QLatin1String(".desktop")))
+        name.chop(8);
+    return name;
+}
+
+/*
+ * AutoStartLauncherPrivate
+ */
+
+AutoStartLauncherPrivate::AutoStartLauncherPrivate(AutoStartLauncher *self)
+    : q_ptr(self)
+{
+    dirs << XdgDirs::autostartHome(false) << XdgDirs::autostartDirs();
+}
+
+/*
+ * Runs on a worker thread, entry is only accessed by this task until
+ * all of them are done.
+ */
+void AutoStartLauncherPrivate::load(const QString &fileName, AutoStartLauncherEntry *entry) const
+{
+    DesktopFile &file = entry->file;
+
+    if (!file.load(fileName))
+        return;
+    if (excludeHidden && !file.isVisible())
+        return;
+    if (!file.isSuitable(desktopEnvironment))
+        return;
+    if (!isEnabled(file))
+        return;
+
+    entry->phase = phaseOf(file);
+
+    const int delay = file.value(QStringLiteral("X-Liri-Autostart-Delay"),
+                                 file.value(QStringLiteral("X-GNOME-Autostart-Delay"))).toInt();
+    entry->delay = qMax(0, delay) * 1000;
+
+    entry->after = file.value(QStringLiteral("X-Liri-Autostart-After")).toStringList()
+            + file.value(QStringLiteral("X-KDE-autostart-after")).toStringList();
+
+    entry->valid = true;
+}
+
+void AutoStartLauncherPrivate::loadFinished()
+{
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const AutoStartLauncherEntry &entry) { return !entry.valid; }),
+                  entries.end());
+
+    const QStringList phases = AutoStartLauncher::phases();
+
+    QHash<QString, int> byName;
+    for (int i = 0; i < entries.size(); ++i) {
+        AutoStartLauncherEntry &entry = entries[i];
+        entry.timing.fileName = entry.file.fileName();
+        entry.timing.phase = phases.at(entry.phase);
+        byName.insert(entryName(entry.timing.fileName), i);
+    }
+
+    // Dependencies on entries of earlier phases are satisfied already,
+    // those on entries of later phases can't be honoured
+    for (int i = 0; i < entries.size(); ++i) {
+        for (const QString &name : const_cast<const QStringList &>(entries.at(i).after)) {
+            auto it = byName.constFind(entryName(name));
+            if (it == byName.constEnd() || it.value() == i)
+                continue;
+
+            AutoStartLauncherEntry &dependency = entries[it.value()];
+            if (dependency.phase != entries.at(i).phase)
+                continue;
+
+            dependency.dependents.append(i);
+            entries[i].pendingDependencies++;
+        }
+    }
+
+    startPhase(0);
+}
+
+void AutoStartLauncherPrivate::startPhase(int first)
+{
+    Q_Q(AutoStartLauncher);
+
+    const QStringList phases = AutoStartLauncher::phases();
+
+    for (phase = first; phase < phases.size(); ++phase) {
+        remaining = static_cast<int>(std::count_if(entries.cbegin(), entries.cend(),
+                                                   [this](const AutoStartLauncherEntry &entry) { return entry.phase == phase; }));
+        if (remaining == 0)
+            continue;
+
+        Q_EMIT q->phaseStarted(phases.at(phase));
+
+        for (int i = 0; i < entries.size(); ++i) {
+            if (entries.at(i).phase == phase && entries.at(i).pendingDependencies == 0)
+                makeReady(i);
+        }
+
+        checkStalled();
+        return;
+    }
+
+    running = false;
+    Q_EMIT q->finished();
+}
+
+void AutoStartLauncherPrivate::makeReady(int index)
+{
+    Q_Q(AutoStartLauncher);
+
+    AutoStartLauncherEntry &entry = entries[index];
+    entry.timing.ready = timer.nsecsElapsed() / 1000;
+    ++active;
+
+    if (entry.delay > 0) {
+        entry.state = AutoStartLauncherEntry::Delayed;
+        QTimer::singleShot(entry.delay, q, [this, index]() {
+            launch(index);
+        });
+    } else {
+        launch(index);
+    }
+}
+
+/*
+ * Processes are started on worker threads, D-Bus activatable entries
+ * on this thread which receives the activation replies. Either way the
+ * outcome is handled in a later iteration of the event loop.
+ */
+void AutoStartLauncherPrivate::launch(int index)
+{
+    Q_Q(AutoStartLauncher);
+
+    AutoStartLauncherEntry &entry = entries[index];
+    entry.state = AutoStartLauncherEntry::Launching;
+    entry.timing.start = timer.nsecsElapsed() / 1000;
+
+    if (!startFunction && entry.file.isDBusActivatable()) {
+        QElapsedTimer elapsed;
+        elapsed.start();
+        const bool success = entry.file.startDetached();
+        const qint64 duration = elapsed.nsecsElapsed() / 1000;
+
+        QMetaObject::invokeMethod(q, [this, index, success, duration]() {
+            launched(index, success, duration);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    pool.start([this, q, index, file = entry.file, start = startFunction]() mutable {
+        QElapsedTimer elapsed;
+        elapsed.start();
+        const bool success = start ? start(file) : file.startDetached();
+        const qint64 duration = elapsed.nsecsElapsed() / 1000;
+
+        QMetaObject::invokeMethod(q, [this, index, success, duration]() {
+            launched(index, success, duration);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void AutoStartLauncherPrivate::launched(int index, bool success, qint64 duration)
+{
+    Q_Q(AutoStartLauncher);
+
+    AutoStartLauncherEntry &entry = entries[index];
+    entry.state = AutoStartLauncherEntry::Launched;
+    entry.timing.duration = duration;
+    entry.timing.success = success;
+    timings.append(entry.timing);
+
+    --active;
+    --remaining;
+
+    if (!success)
+        qCWarning(lcXdg, "Failed to start autostart entry \"%s\"", qPrintable(entry.timing.fileName));
+    Q_EMIT q->entryStarted(entry.timing.fileName, success);
+
+    for (int dependent : const_cast<const QVector<int> &>(entry.dependents)) {
+        AutoStartLauncherEntry &other = entries[dependent];
+        if (--other.pendingDependencies == 0 && other.state == AutoStartLauncherEntry::Waiting)
+            makeReady(dependent);
+    }
+
+    if (remaining == 0) {
+        Q_EMIT q->phaseFinished(AutoStartLauncher::phases().at(phase));
+        startPhase(phase + 1);
+        return;
+    }
+
+    checkStalled();
+}
+
+/*
+ * Entries left waiting while nothing is launching depend on each other,
+ * they are launched regardless.
+ */
+void AutoStartLauncherPrivate::checkStalled()
+{
+    if (active > 0 || remaining == 0)
+        return;
+
+    qCWarning(lcXdg, "Circular autostart ordering in phase \"%s\", ignoring it",
+              qPrintable(AutoStartLauncher::phases().at(phase)));
+
+    for (int i = 0; i < entries.size(); ++i) {
+        AutoStartLauncherEntry &entry = entries[i];
+        if (entry.phase == phase && entry.state == AutoStartLauncherEntry::Waiting) {
+            entry.pendingDependencies = 0;
+            makeReady(i);
+        }
+    }
+}
+
+/*
+ * AutoStartLauncher
+ */
+
+AutoStartLauncher::AutoStartLauncher(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new AutoStartLauncherPrivate(this))
+{
+}
+
+AutoStartLauncher::~AutoStartLauncher()
+{
+    delete d_ptr;
+}
+
+QStringList AutoStartLauncher::directories() const
+{
+    Q_D(const AutoStartLauncher);
+    return d->dirs;
+}
+
+void AutoStartLauncher::setDirectories(const QStringList &dirs)
+{
+    Q_D(AutoStartLauncher);
+    d->dirs = dirs;
+}
+
+bool AutoStartLauncher::excludeHidden() const
+{
+    Q_D(const AutoStartLauncher);
+    return d->excludeHidden;
+}
+
+void AutoStartLauncher::setExcludeHidden(bool exclude)
+{
+    Q_D(AutoStartLauncher);
+    d->excludeHidden = exclude;
+}
+
+QString AutoStartLauncher::desktopEnvironment() const
+{
+    Q_D(const AutoStartLauncher);
+    return d->desktopEnvironment;
+}
+
+void AutoStartLauncher::setDesktopEnvironment(const QString &env)
+{
+    Q_D(AutoStartLauncher);
+    d->desktopEnvironment = env;
+}
+
+int AutoStartLauncher::maxThreadCount() const
+{
+    Q_D(const AutoStartLauncher);
+    return d->pool.maxThreadCount();
+}
+
+void AutoStartLauncher::setMaxThreadCount(int count)
+{
+    Q_D(AutoStartLauncher);
+    d->pool.setMaxThreadCount(count);
+}
+
+void AutoStartLauncher::setStartFunction(const StartFunction &function)
+{
+    Q_D(AutoStartLauncher);
+    d->startFunction = function;
+}
+
+QStringList AutoStartLauncher::phases()
+{
+    QStringList result;
+    for (const char *name : phaseNames)
+        result.append(QLatin1String(name));
+    return result;
+}
+
+bool AutoStartLauncher::isRunning() const
+{
+    Q_D(const AutoStartLauncher);
+    return d->running;
+}
+
+/*
+ * Lists the Autostart directories, where only the file under the most
+ * important directory is considered when the same file name is found
+ * in several of them, and loads the entries in parallel.
+ */
+void AutoStartLauncher::start()
+{
+    Q_D(AutoStartLauncher);
+
+    if (d->running)
+        return;
+
+    d->running = true;
+    d->timer.start();
+    d->timings.clear();
+    d->phase = -1;
+    d->remaining = 0;
+    d->active = 0;
+
+    QStringList dirs = d->dirs;
+    dirs.removeDuplicates();
+
+    QSet<QString> processed;
+    QStringList fileNames;
+    for (const QString &dirName : const_cast<const QStringList &>(dirs)) {
+        QDir dir(dirName);
+        if (!dir.exists())
+            continue;
+
+        const QFileInfoList files = dir.entryInfoList(QStringList(QStringLiteral("*.desktop")), QDir::Files | QDir::Readable);
+        for (const QFileInfo &fi : files) {
+            if (processed.contains(fi.fileName()))
+                continue;
+
+            processed << fi.fileName();
+            fileNames << fi.absoluteFilePath();
+        }
+    }
+
+    d->entries = QVector<AutoStartLauncherEntry>(fileNames.size());
+
+    if (fileNames.isEmpty()) {
+        QMetaObject::invokeMethod(this, [d]() {
+            d->loadFinished();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    d->pendingLoads.storeRelaxed(static_cast<int>(fileNames.size()));
+    for (int i = 0; i < fileNames.size(); ++i) {
+        AutoStartLauncherEntry *entry = &d->entries[i];
+        const QString fileName = fileNames.at(i);
+
+        d->pool.start([this, d, entry, fileName]() {
+            d->load(fileName, entry);
+
+            if (!d->pendingLoads.deref()) {
+                QMetaObject::invokeMethod(this, [d]() {
+                    d->loadFinished();
+                }, Qt::QueuedConnection);
+            }
+        });
+    }
+}
+
+QList<AutoStartTiming> AutoStartLauncher::timings() const
+{
+    Q_D(const AutoStartLauncher);
+    return d->timings;
+}
+
+} // namespace Liri
@@ -0,0 +1,100 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_AUTOSTARTLAUNCHER_H
+#define LIRI_AUTOSTARTLAUNCHER_H
+
+#include <QObject>
+
+#include <functional>
+
+#include <LiriXdg/DesktopFile>
+
+namespace Liri {
+
+class AutoStartLauncherPrivate;
+
+/*!
+ * Measurement of the launch of an autostart entry, see AutoStartLauncher::timings().
+ */
+struct LIRIXDG_EXPORT AutoStartTiming
+{
+    QString fileName;
+    QString phase;
+    //! Time in microseconds since start() when the entry was ready to launch
+    qint64 ready;
+    //! Time in microseconds since start() when the launch began
+    qint64 start;
+    //! Wall time in microseconds spent launching
+    qint64 duration;
+    bool success;
+};
+
+/*!
+ * Launches the entries of the Autostart directories, honouring their
+ * phase and ordering hints.
+ *
+ * Entries are loaded and filtered in parallel, then launched phase by
+ * phase in the order of phases(). The phase of an entry is read from
+ * X-Liri-Autostart-Phase, X-GNOME-Autostart-Phase or X-KDE-autostart-phase
+ * (0 is "Initialization", 1 "Desktop" and 2 "Applications"), entries
+ * without a phase belong to "Applications".
+ *
+ * Within a phase, an entry listing the names of other entries, without
+ * the .desktop suffix, in X-Liri-Autostart-After or X-KDE-autostart-after
+ * is launched after them; X-Liri-Autostart-Delay or X-GNOME-Autostart-Delay
+ * hold it for the given number of seconds. Entries with no pending
+ * dependencies are launched concurrently.
+ *
+ * Entries with X-Liri-Autostart-Enabled or X-GNOME-Autostart-enabled set
+ * to false are skipped.
+ */
+class LIRIXDG_EXPORT AutoStartLauncher : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(AutoStartLauncher)
+public:
+    typedef std::function<bool(DesktopFile &file)> StartFunction;
+
+    explicit AutoStartLauncher(QObject *parent = nullptr);
+    ~AutoStartLauncher();
+
+    QStringList directories() const;
+    void setDirectories(const QStringList &dirs);
+
+    bool excludeHidden() const;
+    void setExcludeHidden(bool exclude);
+
+    QString desktopEnvironment() const;
+    void setDesktopEnvironment(const QString &env);
+
+    int maxThreadCount() const;
+    void setMaxThreadCount(int count);
+
+    /*!
+     * Replaces DesktopFile::startDetached(), for example to start entries
+     * as services. The function is called from worker threads.
+     */
+    void setStartFunction(const StartFunction &function);
+
+    static QStringList phases();
+
+    bool isRunning() const;
+    void start();
+
+    QList<AutoStartTiming> timings() const;
+
+Q_SIGNALS:
+    void phaseStarted(const QString &phase);
+    void entryStarted(const QString &fileName, bool success);
+    void phaseFinished(const QString &phase);
+    void finished();
+
+private:
+    AutoStartLauncherPrivate *const d_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_AUTOSTARTLAUNCHER_H
@@ -0,0 +1,87 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_AUTOSTARTLAUNCHER_P_H
+#define LIRI_AUTOSTARTLAUNCHER_P_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QVector>
+
+#include "autostartlauncher.h"
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+struct AutoStartLauncherEntry {
+    enum State {
+        Waiting,
+        Delayed,
+        Launching,
+        Launched,
+    };
+
+    // Filled by the loader
+    bool valid = false;
+    DesktopFile file;
+    int phase = 0;
+    int delay = 0;
+    QStringList after;
+
+    // Filled by the scheduler
+    State state = Waiting;
+    int pendingDependencies = 0;
+    QVector<int> dependents;
+    AutoStartTiming timing;
+};
+
+class AutoStartLauncherPrivate
+{
+    Q_DECLARE_PUBLIC(AutoStartLauncher)
+public:
+    explicit AutoStartLauncherPrivate(AutoStartLauncher *self);
+
+    void load(const QString &fileName, AutoStartLauncherEntry *entry) const;
+    void loadFinished();
+
+    void startPhase(int phase);
+    void makeReady(int index);
+    void launch(int index);
+    void launched(int index, bool success, qint64 duration);
+    void checkStalled();
+
+    QStringList dirs;
+    bool excludeHidden = true;
+    QString desktopEnvironment;
+    AutoStartLauncher::StartFunction startFunction;
+
+    bool running = false;
+    QElapsedTimer timer;
+    QVector<AutoStartLauncherEntry> entries;
+    QAtomicInt pendingLoads;
+    int phase = -1;
+    int remaining = 0;
+    int active = 0;
+    QList<AutoStartTiming> timings;
+
+    QThreadPool pool;
+
+protected:
+    AutoStartLauncher *q_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_AUTOSTARTLAUNCHER_P_H
@@ -0,0 +1,282 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <QDir>
+#include <QFileInfo>
+#include <QPair>
+#include <QSet>
+
+#include <algorithm>
+
+#include "autostartregistry.h"
+#include "autostartregistry_p.h"
+#include "desktopfile_p.h"
+#include "xdgdirs_p_p.h"
+
+namespace Liri {
+
+/*
+ * AutoStartRegistryPrivate
+ */
+
+AutoStartRegistryPrivate::AutoStartRegistryPrivate(AutoStartRegistry *self)
+    : q_ptr(self)
+{
+    rescanTimer.setSingleShot(true);
+    rescanTimer.setInterval(RESCAN_DELAY);
+
+    QObject::connect(&rescanTimer, &QTimer::timeout, self, [this]() {
+        rescan(false);
+    });
+    QObject::connect(&watcher, &QFileSystemWatcher::fileChanged,
+                     &rescanTimer, QOverload<>::of(&QTimer::start));
+    QObject::connect(&watcher, &QFileSystemWatcher::directoryChanged,
+                     &rescanTimer, QOverload<>::of(&QTimer::start));
+}
+
+/*
+ * Lists the directories and compares the result with the entries in
+ * memory. Entries are parsed again only when the file in effect is
+ * another one or was modified, or when reload is true.
+ */
+void AutoStartRegistryPrivate::rescan(bool reload)
+{
+    Q_Q(AutoStartRegistry);
+
+    QStringList uniqueDirs = dirs;
+    uniqueDirs.removeDuplicates();
+
+    QMap<QString, AutoStartRegistryEntry> found;
+    for (int i = 0; i < uniqueDirs.size(); ++i) {
+        QDir dir(uniqueDirs.at(i));
+        if (!dir.exists())
+            continue;
+
+        const QFileInfoList files = dir.entryInfoList(QStringList(QStringLiteral("*.desktop")), QDir::Files | QDir::Readable);
+        for (int j = 0; j < files.size(); ++j) {
+            const QFileInfo &fi = files.at(j);
+            AutoStartRegistryEntry &entry = found[fi.fileName()];
+            if (entry.fileNames.isEmpty()) {
+                entry.dirIndex = i;
+                entry.position = j;
+                entry.modified = fi.lastModified();
+                entry.size = fi.size();
+            }
+            entry.fileNames.append(fi.absoluteFilePath());
+        }
+    }
+
+    QStringList added, removed, modified;
+    QList<QPair<QString, QString>> overridden;
+    bool shadowed = false;
+
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        if (!found.contains(it.key()))
+            removed.append(it->fileNames.first());
+    }
+
+    for (auto it = found.begin(); it != found.end(); ++it) {
+        AutoStartRegistryEntry &entry = it.value();
+
+        auto old = entries.constFind(it.key());
+        if (old == entries.constEnd()) {
+            load(&entry, true);
+            added.append(entry.fileNames.first());
+            continue;
+        }
+
+        if (old->fileNames.first() != entry.fileNames.first()) {
+            load(&entry, true);
+            overridden.append(qMakePair(old->fileNames.first(), entry.fileNames.first()));
+        } else if (old->modified != entry.modified || old->size != entry.size) {
+            load(&entry, false);
+            modified.append(entry.fileNames.first());
+        } else if (reload) {
+            load(&entry, false);
+        } else {
+            entry.valid = old->valid;
+            entry.visible = old->visible;
+            entry.suitable = old->suitable;
+            entry.file = old->file;
+        }
+
+        if (old->fileNames != entry.fileNames)
+            shadowed = true;
+    }
+
+    entries.swap(found);
+    watch();
+
+    for (const QString &fileName : const_cast<const QStringList &>(removed))
+        Q_EMIT q->entryRemoved(fileName);
+    for (const QString &fileName : const_cast<const QStringList &>(added))
+        Q_EMIT q->entryAdded(fileName);
+    for (const QString &fileName : const_cast<const QStringList &>(modified))
+        Q_EMIT q->entryChanged(fileName);
+    for (const auto &pair : const_cast<const QList<QPair<QString, QString>> &>(overridden))
+        Q_EMIT q->entryOverridden(pair.first, pair.second);
+
+    if (shadowed || !removed.isEmpty() || !added.isEmpty() || !modified.isEmpty() || !overridden.isEmpty())
+        Q_EMIT q->changed();
+}
+
+/*
+ * Entries linking to an application share the contents of the copy in
+ * DesktopFileCache, unless useCache is false because the file has changed
+ * since. They keep the path of the link, like AutoStart does.
+ */
+void AutoStartRegistryPrivate::load(AutoStartRegistryEntry *entry, bool useCache) const
+{
+    const QString fileName = entry->fileNames.first();
+
+    entry->valid = false;
+
+    if (useCache) {
+        const QString target = QFileInfo(fileName).canonicalFilePath();
+        if (!target.isEmpty() && target != fileName && !DesktopFile::id(target).isEmpty()) {
+            const QSharedPointer<DesktopFile> cached = DesktopFileCache::getFileHandle(target);
+            if (cached) {
+                entry->file = *cached;
+                entry->file.d->fileName = fileName;
+                entry->valid = true;
+            }
+        }
+    }
+
+    if (!entry->valid)
+        entry->valid = entry->file.load(fileName);
+
+    entry->visible = entry->valid && entry->file.isVisible();
+    entry->suitable = entry->valid && entry->file.isSuitable();
+}
+
+/*
+ * Watches the directories, or their closest existing parent so that
+ * their creation is noticed, and the files in effect, whose changes
+ * are not reported for the directories.
+ */
+void AutoStartRegistryPrivate::watch()
+{
+    QStringList paths;
+
+    for (const QString &dir : const_cast<const QStringList &>(dirs)) {
+        QString path = QDir::cleanPath(dir);
+        while (!QFileInfo::exists(path) && path != QDir::rootPath())
+            path = QFileInfo(path).absolutePath();
+        paths.append(path);
+    }
+
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+        paths.append(it->fileNames.first());
+
+    const QSet<QString> wanted(paths.cbegin(), paths.cend());
+    const QStringList watched = watcher.files() + watcher.directories();
+    const QSet<QString> current(watched.cbegin(), watched.cend());
+
+    const QSet<QString> obsolete = current - wanted;
+    if (!obsolete.isEmpty())
+        watcher.removePaths(obsolete.values());
+
+    const QSet<QString> missing = wanted - current;
+    if (!missing.isEmpty())
+        watcher.addPaths(missing.values());
+}
+
+/*
+ * AutoStartRegistry
+ */
+
+AutoStartRegistry::AutoStartRegistry(QObject *parent)
+    : AutoStartRegistry(QStringList() << XdgDirs::autostartHome(false) << XdgDirs::autostartDirs(), parent)
+{
+}
+
+AutoStartRegistry::AutoStartRegistry(const QStringList &dirs, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new AutoStartRegistryPrivate(this))
+{
+    Q_D(AutoStartRegistry);
+    d->dirs = dirs;
+    d->rescan(false);
+}
+
+AutoStartRegistry::~AutoStartRegistry()
+{
+    delete d_ptr;
+}
+
+QStringList AutoStartRegistry::directories() const
+{
+    Q_D(const AutoStartRegistry);
+    return d->dirs;
+}
+
+/*
+ * Returns the same list as AutoStart::desktopFileList() for these
+ * directories, without touching the file system.
+ */
+DesktopFileList AutoStartRegistry::desktopFileList(bool excludeHidden) const
+{
+    Q_D(const AutoStartRegistry);
+
+    QVector<const AutoStartRegistryEntry *> sorted;
+    for (auto it = d->entries.cbegin(); it != d->entries.cend(); ++it) {
+        if (it->valid && it->suitable && (!excludeHidden || it->visible))
+            sorted.append(&it.value());
+    }
+
+    // Directory by directory, as they are listed
+    std::sort(sorted.begin(), sorted.end(),
+              [](const AutoStartRegistryEntry *a, const AutoStartRegistryEntry *b) {
+        return a->dirIndex < b->dirIndex || (a->dirIndex == b->dirIndex && a->position < b->position);
+    });
+
+    DesktopFileList list;
+    list.reserve(sorted.size());
+    for (const AutoStartRegistryEntry *entry : const_cast<const QVector<const AutoStartRegistryEntry *> &>(sorted))
+        list.append(entry->file);
+    return list;
+}
+
+QStringList AutoStartRegistry::names() const
+{
+    Q_D(const AutoStartRegistry);
+    return d->entries.keys();
+}
+
+bool AutoStartRegistry::contains(const QString &name) const
+{
+    Q_D(const AutoStartRegistry);
+    return d->entries.contains(name);
+}
+
+DesktopFile AutoStartRegistry::entry(const QString &name) const
+{
+    Q_D(const AutoStartRegistry);
+    auto it = d->entries.constFind(name);
+    if (it == d->entries.constEnd() || !it->valid)
+        return DesktopFile();
+    return it->file;
+}
+
+QString AutoStartRegistry::fileName(const QString &name) const
+{
+    Q_D(const AutoStartRegistry);
+    return d->entries.value(name).fileNames.value(0);
+}
+
+QStringList AutoStartRegistry::overriddenFileNames(const QString &name) const
+{
+    Q_D(const AutoStartRegistry);
+    return d->entries.value(name).fileNames.mid(1);
+}
+
+void AutoStartRegistry::refresh()
+{
+    Q_D(AutoStartRegistry);
+    d->rescanTimer.stop();
+    d->rescan(true);
+}
+
+} // namespace Liri
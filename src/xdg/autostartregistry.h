@@ -0,0 +1,68 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_AUTOSTARTREGISTRY_H
+#define LIRI_AUTOSTARTREGISTRY_H
+
+#include <QObject>
+
+#include <LiriXdg/DesktopFile>
+
+namespace Liri {
+
+class AutoStartRegistryPrivate;
+
+/*!
+ * Resolved entries of the Autostart directories, kept in memory and
+ * updated when the directories change.
+ *
+ * Like AutoStart::desktopFileList(), only the file in the most important
+ * directory is considered when several directories have a file with the
+ * same name. Entries linking to an application of the menu share the
+ * contents parsed by DesktopFileCache, DesktopFile::fileName() is still
+ * the file in the Autostart directory.
+ */
+class LIRIXDG_EXPORT AutoStartRegistry : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(AutoStartRegistry)
+public:
+    //! Registry of XdgDirs::autostartHome() and XdgDirs::autostartDirs()
+    explicit AutoStartRegistry(QObject *parent = nullptr);
+    //! Registry of the given directories, the most important first
+    explicit AutoStartRegistry(const QStringList &dirs, QObject *parent = nullptr);
+    ~AutoStartRegistry();
+
+    QStringList directories() const;
+
+    DesktopFileList desktopFileList(bool excludeHidden = true) const;
+
+    //! Names of the entries, such as "foo.desktop"
+    QStringList names() const;
+    bool contains(const QString &name) const;
+    DesktopFile entry(const QString &name) const;
+
+    //! Path of the file in effect for the entry name
+    QString fileName(const QString &name) const;
+    //! Paths of the files with the same name in less important directories
+    QStringList overriddenFileNames(const QString &name) const;
+
+    //! Lists the directories and reloads every entry now
+    void refresh();
+
+Q_SIGNALS:
+    void entryAdded(const QString &fileName);
+    void entryRemoved(const QString &fileName);
+    void entryChanged(const QString &fileName);
+    //! The file in effect for an entry is now newFileName instead of oldFileName
+    void entryOverridden(const QString &oldFileName, const QString &newFileName);
+    void changed();
+
+private:
+    AutoStartRegistryPrivate *const d_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_AUTOSTARTREGISTRY_H
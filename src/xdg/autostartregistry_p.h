@@ -0,0 +1,69 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_AUTOSTARTREGISTRY_P_H
+#define LIRI_AUTOSTARTREGISTRY_P_H
+
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QMap>
+#include <QTimer>
+
+#include "autostartregistry.h"
+
+// Changes within this time are handled at once
+#define RESCAN_DELAY 250
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+struct AutoStartRegistryEntry {
+    // Files with the same name, the first one is in effect
+    QStringList fileNames;
+    int dirIndex = 0;
+    // In the listing of the directory, sorted like QDir does
+    int position = 0;
+
+    QDateTime modified;
+    qint64 size = -1;
+
+    bool valid = false;
+    bool visible = false;
+    bool suitable = false;
+    DesktopFile file;
+};
+
+class AutoStartRegistryPrivate
+{
+    Q_DECLARE_PUBLIC(AutoStartRegistry)
+public:
+    explicit AutoStartRegistryPrivate(AutoStartRegistry *self);
+
+    void rescan(bool reload);
+    void load(AutoStartRegistryEntry *entry, bool useCache) const;
+    void watch();
+
+    QStringList dirs;
+    QMap<QString, AutoStartRegistryEntry> entries;
+
+    QFileSystemWatcher watcher;
+    QTimer rescanTimer;
+
+protected:
+    AutoStartRegistry *q_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_AUTOSTARTREGISTRY_P_H
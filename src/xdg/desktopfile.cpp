@@ -10,13 +10,19 @@
 #include <QFile>
 #include <QMimeDatabase>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
 #include <QStandardPaths>
 #include <QTextStream>
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 #include "desktopfile.h"
 #include "desktopfile_p.h"
+#include "desktopfileusage.h"
 #include "desktopfileutils_p.h"
+#include "desktopfilevalidator_p.h"
 #include "xdgdirs_p_p.h"
 #include "logging_p.h"
 
@@ -24,6 +30,9 @@ namespace Liri {
 
 Q_GLOBAL_STATIC(DesktopFileCache, s_desktopFileCache)
 
+// Set before the cache is created, see DesktopFileCache::setLoadMode()
+static QBasicAtomicInt s_cacheLoadMode = Q_BASIC_ATOMIC_INITIALIZER(DesktopFile::AllLocalesLoadMode);
+
 // A list of executables that can't be run with QProcess::startDetached(). They
 // will be run with QProcess::start()
 static const QStringList nonDetachExecs = QStringList() << QStringLiteral("pkexec");
@@ -54,6 +63,23 @@ static const QString initialPreferenceKey = QStringLiteral("InitialPreference");
 
 static const QString applicationsStr = QStringLiteral("applications");
 
+// Lists are separated, and usually terminated, by semicolons
+static QVariant decodeValue(const QString &value)
+{
+    if (value.contains(QLatin1Char(';')))
+        return value.split(QLatin1Char(';'), Qt::SkipEmptyParts);
+    return value;
+}
+
+static QString encodeValue(const QVariant &value)
+{
+    if (value.userType() == QMetaType::QStringList) {
+        const QStringList list = value.toStringList();
+        return list.isEmpty() ? QString() : list.join(QLatin1Char(';')) + QLatin1Char(';');
+    }
+    return value.toString();
+}
+
 /*
  * DesktopFilePrivate
  */
@@ -63,20 +89,39 @@ void DesktopFilePrivate::clear()
     fileName.clear();
     prefix.clear();
     items.clear();
+    transactionItems.clear();
+    inTransaction = false;
+    locales.clear();
     type = DesktopFile::UnknownType;
 }
 
-bool DesktopFilePrivate::readFile()
+/*
+ * Parses the file into items. Diagnostics are reported to validator,
+ * when there is one, and parsing goes on after errors to find them all.
+ */
+bool DesktopFilePrivate::readFile(DesktopFileValidator *validator)
 {
     QFile file(fileName);
-    if (!file.open(QFile::ReadOnly | QFile::Text))
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        if (validator)
+            validator->add(0, 0, DesktopFileDiagnostic::ErrorSeverity, "unreadable-file", file.errorString());
         return false;
+    }
 
     QString section;
     QTextStream stream(&file);
+    int lineNumber = 0;
+    bool valid = true;
 
     while (!stream.atEnd()) {
-        QString line = stream.readLine().trimmed();
+        QString line = stream.readLine();
+        ++lineNumber;
+
+        // Only the validator needs the line as it was
+        QString rawLine;
+        if (validator)
+            rawLine = line;
+        line = std::move(line).trimmed();
 
         // Skip empty lines
         if (line.isEmpty())
@@ -89,6 +134,8 @@ bool DesktopFilePrivate::readFile()
         // Detect section
         if (line.startsWith(QLatin1Char('[')) && line.endsWith(QLatin1Char(']'))) {
             section = line.mid(1, line.length() - 2);
+            if (validator)
+                validator->groupRead(lineNumber, rawLine, section);
             continue;
         }
 
@@ -96,27 +143,171 @@ bool DesktopFilePrivate::readFile()
         QString key = line.section(QLatin1Char('='), 0, 0).trimmed();
         QString value = line.section(QLatin1Char('='), 1).trimmed();
 
+        if (validator && (key.isEmpty() || !line.contains(QLatin1Char('='))))
+            validator->invalidLine(lineNumber, rawLine);
+
         if (key.isEmpty())
             continue;
 
         if (section.isEmpty()) {
-            qCWarning(lcXdg, "Stray assignment outside section");
-            file.close();
-            return false;
+            if (!validator) {
+                qCWarning(lcXdg, "Stray assignment outside section");
+                file.close();
+                return false;
+            }
+            validator->strayKey(lineNumber, rawLine);
+            valid = false;
+            continue;
         }
 
+        if (validator)
+            validator->keyRead(lineNumber, rawLine, section, key);
+
+        if (isOtherLocaleKey(key))
+            continue;
+
         // Prepend section and '/' separator before key
         key.prepend(QLatin1Char('/')).prepend(section);
 
-        // Decode lists
-        if (value.contains(QLatin1Char(';')))
-            items.insert(key, value.split(QLatin1Char(';'), Qt::SkipEmptyParts));
-        else
-            items.insert(key, value);
+        items.insert(key, decodeValue(value));
     }
 
     file.close();
 
+    if (validator)
+        validator->finish(items);
+
+    return valid;
+}
+
+/*
+ * Writes the items to fileName, atomically. The layout and comments of
+ * the file being replaced, or else of the file the items were loaded
+ * from, are preserved: only the lines of changed keys are rewritten,
+ * new keys go after the last key of their group and new groups at the
+ * end. Nothing is written when the file is up to date.
+ */
+bool DesktopFilePrivate::writeFile(const QString &fileName) const
+{
+    const QString layoutFileName = QFileInfo::exists(fileName) ? fileName : this->fileName;
+
+    QStringList lines;
+    if (!layoutFileName.isEmpty()) {
+        QFile file(layoutFileName);
+        if (file.open(QFile::ReadOnly | QFile::Text)) {
+            lines = QString::fromUtf8(file.readAll()).split(QLatin1Char('\n'));
+            if (!lines.isEmpty() && lines.last().isEmpty())
+                lines.removeLast();
+        }
+    }
+
+    const QLatin1Char newLine('\n');
+    const QLatin1Char equal('=');
+
+    QString data;
+    bool changed = layoutFileName != fileName;
+    QSet<QString> written;
+    QSet<QString> sections;
+    QString section;
+    qsizetype insertAt = 0;
+
+    // Keys of the group that are not in the file yet, a group found
+    // again later in the file gets none of them a second time
+    const auto addMissing = [&]() {
+        QString missing;
+        const QString prefix = section + QLatin1Char('/');
+        for (auto it = items.lowerBound(prefix); it != items.constEnd() && it.key().startsWith(prefix); ++it) {
+            if (written.contains(it.key()))
+                continue;
+            missing += it.key().mid(prefix.size()) + equal + encodeValue(it.value()) + newLine;
+            written.insert(it.key());
+        }
+        if (!missing.isEmpty()) {
+            data.insert(insertAt, missing);
+            changed = true;
+        }
+    };
+
+    for (const QString &rawLine : const_cast<const QStringList &>(lines)) {
+        const QString line = rawLine.trimmed();
+
+        if (line.startsWith(QLatin1Char('[')) && line.endsWith(QLatin1Char(']'))) {
+            if (!section.isEmpty())
+                addMissing();
+            section = line.mid(1, line.length() - 2);
+            sections.insert(section);
+            data += rawLine + newLine;
+            insertAt = data.size();
+            continue;
+        }
+
+        const QString key = line.section(equal, 0, 0).trimmed();
+        if (section.isEmpty() || line.isEmpty() || line.startsWith(QLatin1Char('#')) || key.isEmpty()) {
+            data += rawLine + newLine;
+            continue;
+        }
+
+        // Keys no longer set, or set twice, are dropped, but translations
+        // that were not loaded are kept
+        const QString path = section + QLatin1Char('/') + key;
+        auto it = items.constFind(path);
+        if (it == items.constEnd() && layoutFileName == this->fileName && isOtherLocaleKey(key)) {
+            data += rawLine + newLine;
+            insertAt = data.size();
+            continue;
+        }
+        if (it == items.constEnd() || written.contains(path)) {
+            changed = true;
+            continue;
+        }
+        written.insert(path);
+
+        if (decodeValue(line.section(equal, 1).trimmed()) == it.value()) {
+            data += rawLine + newLine;
+        } else {
+            data += key + equal + encodeValue(it.value()) + newLine;
+            changed = true;
+        }
+        insertAt = data.size();
+    }
+
+    if (!section.isEmpty())
+        addMissing();
+
+    // Groups that are not in the file yet
+    QString previous;
+    for (auto it = items.constBegin(); it != items.constEnd(); ++it) {
+        const QString sect = it.key().section(QLatin1Char('/'), 0, 0);
+        if (sections.contains(sect))
+            continue;
+
+        if (sect != previous) {
+            if (!data.isEmpty())
+                data += newLine;
+            data += QLatin1Char('[') + sect + QLatin1Char(']') + newLine;
+            previous = sect;
+        }
+        data += it.key().section(QLatin1Char('/'), 1) + equal + encodeValue(it.value()) + newLine;
+        changed = true;
+    }
+
+    if (!changed)
+        return true;
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(lcXdg, "Failed to open \"%s\" for writing: %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    const QByteArray bytes = data.toUtf8();
+    if (file.write(bytes) != bytes.size() || !file.commit()) {
+        qCWarning(lcXdg, "Failed to write \"%s\": %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
     return true;
 }
 
@@ -164,6 +355,22 @@ bool DesktopFilePrivate::contains(const QString &key) const
  lang                   lang, default value
  ************************************************/
 QString DesktopFilePrivate::localizedKey(const QString &key) const
+{
+    const QStringList names = localeNames();
+    for (const QString &name : names) {
+        QString k = QStringLiteral("%1[%2]").arg(key, name);
+        if (contains(k))
+            return k;
+    }
+
+    return key;
+}
+
+/*
+ * Returns the locale names matching LC_MESSAGES, in the order of the
+ * table above.
+ */
+QStringList DesktopFilePrivate::localeNames()
 {
     QString lang = QString::fromLocal8Bit(qgetenv("LC_MESSAGES"));
 
@@ -185,29 +392,61 @@ QString DesktopFilePrivate::localizedKey(const QString &key) const
     if (!country.isEmpty())
         lang.truncate(lang.length() - country.length() - 1);
 
-    if (!modifier.isEmpty() && !country.isEmpty()) {
-        QString k = QStringLiteral("%1[%2_%3@%4]").arg(key, lang, country, modifier);
-        if (contains(k))
-            return k;
-    }
+    QStringList names;
+    if (!modifier.isEmpty() && !country.isEmpty())
+        names.append(QStringLiteral("%1_%2@%3").arg(lang, country, modifier));
+    if (!country.isEmpty())
+        names.append(QStringLiteral("%1_%2").arg(lang, country));
+    if (!modifier.isEmpty())
+        names.append(QStringLiteral("%1@%2").arg(lang, modifier));
+    names.append(lang);
+    return names;
+}
 
-    if (!country.isEmpty()) {
-        QString k = QStringLiteral("%1[%2_%3]").arg(key, lang, country);
-        if (contains(k))
-            return k;
+/*
+ * Returns whether key, such as Name[de], is localized for a locale
+ * that was not loaded.
+ */
+bool DesktopFilePrivate::isOtherLocaleKey(const QString &key) const
+{
+    if (locales.isEmpty() || !key.endsWith(QLatin1Char(']')))
+        return false;
+
+    const qsizetype open = key.lastIndexOf(QLatin1Char('['));
+    if (open <= 0)
+        return false;
+
+    const QStringView locale = QStringView(key).mid(open + 1, key.size() - open - 2);
+    for (const QString &name : const_cast<const QStringList &>(locales)) {
+        if (locale == name)
+            return false;
     }
 
-    if (!modifier.isEmpty()) {
-        QString k = QStringLiteral("%1[%2@%3]").arg(key, lang, modifier);
-        if (contains(k))
-            return k;
+    return true;
+}
+
+/*
+ * Estimated heap usage of the entry, the part taken by localized keys
+ * is added to localizedBytes.
+ */
+qint64 DesktopFilePrivate::memoryUsage(qint64 *localizedBytes) const
+{
+    qint64 bytes = qint64(sizeof(DesktopFilePrivate))
+            + stringMemoryUsage(fileName) + stringMemoryUsage(prefix)
+            + mapMemoryUsage(transactionItems);
+
+    const qint64 nodeBytes = items.isEmpty() ? 0 : mapMemoryUsage(items) / items.size();
+    for (auto it = items.cbegin(); it != items.cend(); ++it) {
+        const qint64 itemBytes = nodeBytes + stringMemoryUsage(it.key()) + variantMemoryUsage(it.value());
+        bytes += itemBytes;
+        if (it.key().endsWith(QLatin1Char(']')))
+            *localizedBytes += itemBytes;
     }
 
-    QString k = QStringLiteral("%1[%2]").arg(key, lang);
-    if (contains(k))
-        return k;
+    for (auto it = transactionItems.cbegin(); it != transactionItems.cend(); ++it)
+        bytes += stringMemoryUsage(it.key()) + variantMemoryUsage(it.value());
 
-    return key;
+    return bytes;
 }
 
 bool DesktopFilePrivate::startApplicationDetached(DesktopFile *q, const QString &actionName, const QStringList &urls)
@@ -587,11 +826,19 @@ void DesktopFile::setLocalizedValue(const QString &key, const QVariant &value)
     setValue(d->localizedKey(key), value);
 }
 
-bool DesktopFile::load(const QString &fileName)
+/*
+ * Loads the desktop entry from fileName. With CurrentLocaleLoadMode the
+ * localized keys are loaded only for the locale of LC_MESSAGES and its
+ * fallbacks, see localizedValue(); the other translations are kept in
+ * the file when it's saved.
+ */
+bool DesktopFile::load(const QString &fileName, LoadMode mode)
 {
     d->clear();
 
     d->fileName = fileName;
+    if (mode == CurrentLocaleLoadMode)
+        d->locales = DesktopFilePrivate::localeNames();
     if (!d->readFile())
         return false;
 
@@ -604,27 +851,46 @@ bool DesktopFile::load(const QString &fileName)
 
 bool DesktopFile::save(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Text))
+    return d->writeFile(fileName);
+}
+
+/*
+ * Groups the following setValue() and setLocalizedValue() calls, until
+ * commit() saves them at once or rollback() discards them.
+ */
+void DesktopFile::beginTransaction()
+{
+    if (d->inTransaction)
+        return;
+
+    d->inTransaction = true;
+    d->transactionItems = d->items;
+}
+
+bool DesktopFile::isInTransaction() const
+{
+    return d->inTransaction;
+}
+
+bool DesktopFile::commit()
+{
+    if (!d->inTransaction)
         return false;
 
-    QTextStream stream(&file);
-    QMap<QString, QVariant>::const_iterator it = d->items.constBegin();
+    d->inTransaction = false;
+    d->transactionItems.clear();
+    return d->writeFile(d->fileName);
+}
 
-    QString section;
-    while (it != d->items.constEnd()) {
-        QString path = it.key();
-        QString sect = path.section(QLatin1Char('/'), 0, 0);
-        if (sect != section) {
-            section = sect;
-            stream << QLatin1Char('[') << section << QLatin1Char(']') << Qt::endl;
-        }
-        QString key = path.section(QLatin1Char('/'), 1);
-        stream << key << QLatin1Char('=') << it.value().toString() << Qt::endl;
-        ++it;
-    }
+void DesktopFile::rollback()
+{
+    if (!d->inTransaction)
+        return;
 
-    return true;
+    d->inTransaction = false;
+    d->items = d->transactionItems;
+    d->transactionItems.clear();
+    d->type = d->detectType(this);
 }
 
 void DesktopFile::beginGroup(const QString &group)
@@ -790,16 +1056,24 @@ void DesktopFile::setProcessEnvironment(const QProcessEnvironment &env)
 
 bool DesktopFile::startDetached(const QStringList &urls)
 {
+    bool started = false;
+
     switch (d->type) {
     case ApplicationType:
-        return d->startApplicationDetached(this, QString(), urls);
+        started = d->startApplicationDetached(this, QString(), urls);
+        break;
     case LinkType:
-        return d->startLinkDetached(this);
+        started = d->startLinkDetached(this);
+        break;
     default:
         break;
     }
 
-    return false;
+    // Entries outside of the applications directories have no id
+    if (started)
+        DesktopFileUsage::instance()->recordLaunch(id(d->fileName));
+
+    return started;
 }
 
 bool DesktopFile::startDetached(const QString &url)
@@ -834,6 +1108,26 @@ QString DesktopFile::id(const QString &fileName)
     return id;
 }
 
+/*
+ * Checks fileName against the "Desktop Entry Specification" and returns
+ * the problems found, sorted by line, with the same categories as
+ * desktop-file-validate.
+ */
+QList<DesktopFileDiagnostic> DesktopFile::validate(const QString &fileName)
+{
+    DesktopFilePrivate d;
+    d.fileName = fileName;
+
+    DesktopFileValidator validator;
+    d.readFile(&validator);
+
+    std::stable_sort(validator.diagnostics.begin(), validator.diagnostics.end(),
+                     [](const DesktopFileDiagnostic &a, const DesktopFileDiagnostic &b) {
+        return a.line < b.line;
+    });
+    return validator.diagnostics;
+}
+
 /*
  * DesktopAction
  */
@@ -853,50 +1147,89 @@ DesktopFileCachePrivate::DesktopFileCachePrivate()
     initialize();
 }
 
+/*
+ * Entries are read from the shared store when another process already
+ * parsed the same files, otherwise they are parsed and stored for the
+ * next processes.
+ */
 void DesktopFileCachePrivate::initialize()
 {
     const QStringList locations =
             QStandardPaths::locateAll(QStandardPaths::GenericDataLocation,
                                       applicationsStr,
                                       QStandardPaths::LocateDirectory);
+
+    QFileInfoList files;
     for (const auto &path : locations)
-        initialize(path);
-}
+        listFiles(path, &files);
 
-void DesktopFileCachePrivate::initialize(const QString &path)
-{
-    QDir dir(path);
+    const QString storeFileName = DesktopFileStore::defaultFileName(locations);
+    const quint64 stamp = DesktopFileStore::sourceStamp(files);
 
-    const QFileInfoList infos =
-            dir.entryInfoList(QStringList(), QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
-    for (const auto &info : infos) {
+    if (store.open(storeFileName, stamp)) {
+        for (int i = 0; i < store.count(); ++i) {
+            const QString fileName = store.fileName(i);
+            if (!cache.contains(fileName))
+                index(fileName, loadFromStore(i));
+        }
+        return;
+    }
+
+    QVector<DesktopFileStore::Source> sources;
+    for (const auto &info : const_cast<const QFileInfoList &>(files)) {
         const QString absoluteFilePath = info.absoluteFilePath();
 
-        // Recursively initialize directories
-        if (info.isDir()) {
-            initialize(absoluteFilePath);
+        // Already there when the data directories are listed twice
+        if (cache.contains(absoluteFilePath))
             continue;
-        }
 
         DesktopFile *file = load(absoluteFilePath);
         if (!file)
             continue;
 
-        if (!cache.contains(absoluteFilePath))
-            cache.insert(absoluteFilePath, file);
+        index(absoluteFilePath, file);
+        sources.append(qMakePair(absoluteFilePath, file->d->items));
+    }
 
-        const QStringList mimeTypes = file->mimeTypes();
-        for (const auto &mime : mimeTypes) {
-            int preference = file->value(initialPreferenceKey, 0).toInt();
+    // Entries loaded for one locale would be incomplete for the others
+    if (s_cacheLoadMode.loadRelaxed() == DesktopFile::AllLocalesLoadMode)
+        DesktopFileStore::write(storeFileName, stamp, sources);
+}
 
-            // We move the desktopFile forward in the list for this mime, so that
-            // no desktopfile in front of it have a lower initialPreference
-            int position = defaultAppsCache[mime].length();
-            while (position > 0
-                   && defaultAppsCache[mime][position - 1]->value(initialPreferenceKey, 0).toInt() < preference)
-                position--;
-            defaultAppsCache[mime].insert(position, file);
-        }
+void DesktopFileCachePrivate::listFiles(const QString &path, QFileInfoList *files) const
+{
+    QDir dir(path);
+
+    const QFileInfoList infos =
+            dir.entryInfoList(QStringList(), QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    for (const auto &info : infos) {
+        // Recursively list directories
+        if (info.isDir())
+            listFiles(info.absoluteFilePath(), files);
+        else
+            files->append(info);
+    }
+}
+
+/*
+ * Adds a file of the applications directories to the cache and to the
+ * default applications of its MIME types.
+ */
+void DesktopFileCachePrivate::index(const QString &fileName, DesktopFile *file)
+{
+    insert(fileName, file, true);
+
+    const QStringList mimeTypes = file->mimeTypes();
+    for (const auto &mime : mimeTypes) {
+        int preference = file->value(initialPreferenceKey, 0).toInt();
+
+        // We move the desktopFile forward in the list for this mime, so that
+        // no desktopfile in front of it have a lower initialPreference
+        int position = defaultAppsCache[mime].length();
+        while (position > 0
+               && defaultAppsCache[mime][position - 1]->value(initialPreferenceKey, 0).toInt() < preference)
+            position--;
+        defaultAppsCache[mime].insert(position, file);
     }
 }
 
@@ -905,13 +1238,224 @@ DesktopFile *DesktopFileCachePrivate::load(const QString &fileName)
     DesktopFile *desktopFile = new (std::nothrow) DesktopFile();
     Q_CHECK_PTR(desktopFile);
 
-    if (desktopFile && desktopFile->load(fileName))
+    const auto mode = static_cast<DesktopFile::LoadMode>(s_cacheLoadMode.loadRelaxed());
+    if (desktopFile && desktopFile->load(fileName, mode))
         return desktopFile;
 
     delete desktopFile;
     return nullptr;
 }
 
+static bool fileNameLessThan(DesktopFile *a, DesktopFile *b)
+{
+    return a->fileName() < b->fileName();
+}
+
+/*
+ * Builds the entry from the store like DesktopFile::load() does from the
+ * file, its strings stay in the shared mapping.
+ */
+DesktopFile *DesktopFileCachePrivate::loadFromStore(int entry)
+{
+    DesktopFile *desktopFile = new DesktopFile();
+    DesktopFilePrivate *d = desktopFile->d.data();
+
+    d->fileName = store.fileName(entry);
+    d->items = store.items(entry);
+
+    if (s_cacheLoadMode.loadRelaxed() == DesktopFile::CurrentLocaleLoadMode) {
+        d->locales = DesktopFilePrivate::localeNames();
+        for (auto it = d->items.begin(); it != d->items.end();) {
+            if (d->isOtherLocaleKey(it.key()))
+                it = d->items.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    desktopFile->beginGroup(QStringLiteral("Desktop Entry"));
+    d->type = d->detectType(desktopFile);
+
+    return desktopFile;
+}
+
+/*
+ * Adds the file to the cache, which takes ownership of it, and to the
+ * category index, where the entries of each category are kept sorted
+ * by file name. Files of the applications directories are indexed.
+ */
+DesktopFileCacheEntry &DesktopFileCachePrivate::insert(const QString &fileName, DesktopFile *file, bool indexed)
+{
+    DesktopFileCacheEntry &entry = cache[fileName];
+    entry.file.reset(file);
+    entry.indexed = indexed;
+
+    if (searchIndexReady)
+        searchIndex.insert(file);
+
+    const QStringList categories = file->categories();
+    for (const auto &category : categories) {
+        QList<DesktopFile *> &files = categoryIndex[category];
+        auto it = std::lower_bound(files.begin(), files.end(), file, fileNameLessThan);
+        if (it == files.end() || *it != file)
+            files.insert(it, file);
+    }
+
+    return entry;
+}
+
+/*
+ * Drops the entry from the cache and from the indexes, handles keep
+ * the file alive.
+ */
+void DesktopFileCachePrivate::remove(const QString &fileName)
+{
+    const DesktopFileCacheEntry entry = cache.take(fileName);
+    DesktopFile *file = entry.file.data();
+    if (!file)
+        return;
+
+    if (entry.lastUsed)
+        lru.remove(entry.lastUsed);
+
+    if (searchIndexReady)
+        searchIndex.remove(file);
+
+    const QStringList categories = file->categories();
+    for (const auto &category : categories) {
+        auto index = categoryIndex.find(category);
+        if (index == categoryIndex.end())
+            continue;
+
+        QList<DesktopFile *> &files = index.value();
+        auto it = std::lower_bound(files.begin(), files.end(), file, fileNameLessThan);
+        if (it != files.end() && *it == file)
+            files.erase(it);
+        if (files.isEmpty())
+            categoryIndex.erase(index);
+    }
+}
+
+/*
+ * Returns the file, loading it unless it's cached; relative file names
+ * are desktop file ids. Pinned entries are never evicted, which is the
+ * case of all the entries handed out as raw pointers.
+ */
+QSharedPointer<DesktopFile> DesktopFileCachePrivate::lookup(const QString &fileName, bool pin)
+{
+    if (fileName.isEmpty())
+        return QSharedPointer<DesktopFile>();
+
+    QString file = fileName;
+    auto it = cache.find(file);
+    if (it == cache.end() && !file.startsWith(QDir::separator())) {
+        // It's a relative path, search desktop file
+        file = findDesktopFile(fileName);
+        it = file.isEmpty() ? cache.end() : cache.find(file);
+    }
+
+    DesktopFileCacheEntry *entry = nullptr;
+    if (it != cache.end()) {
+        ++statistics.hits;
+        entry = &it.value();
+    } else {
+        ++statistics.misses;
+        DesktopFile *desktopFile = file.isEmpty() ? nullptr : load(file);
+        if (!desktopFile)
+            return QSharedPointer<DesktopFile>();
+        entry = &insert(file, desktopFile, false);
+    }
+
+    if (pin)
+        this->pin(*entry);
+    else
+        touch(*entry);
+
+    const QSharedPointer<DesktopFile> result = entry->file;
+    evict();
+    return result;
+}
+
+/*
+ * Moves the entry to the end of the LRU map, unless it's never evicted.
+ */
+void DesktopFileCachePrivate::touch(DesktopFileCacheEntry &entry)
+{
+    if (entry.indexed || entry.pinned)
+        return;
+
+    if (entry.lastUsed)
+        lru.remove(entry.lastUsed);
+    entry.lastUsed = ++useCounter;
+    lru.insert(entry.lastUsed, entry.file->fileName());
+}
+
+void DesktopFileCachePrivate::pin(DesktopFileCacheEntry &entry)
+{
+    entry.pinned = true;
+
+    if (entry.lastUsed) {
+        lru.remove(entry.lastUsed);
+        entry.lastUsed = 0;
+    }
+}
+
+/*
+ * Pins the entries returned by the indexes.
+ */
+void DesktopFileCachePrivate::pin(const QList<DesktopFile *> &files)
+{
+    if (lru.isEmpty())
+        return;
+
+    for (DesktopFile *file : files) {
+        auto it = cache.find(file->fileName());
+        if (it != cache.end())
+            pin(it.value());
+    }
+}
+
+/*
+ * Evicts the least recently used entries beyond maximumSize.
+ */
+void DesktopFileCachePrivate::evict()
+{
+    while (maximumSize > 0 && lru.size() > maximumSize) {
+        const QString fileName = lru.first();
+        remove(fileName);
+        ++statistics.evictions;
+    }
+}
+
+/*
+ * The file names are shared with the entries and counted with them.
+ */
+DesktopFileCacheMemoryUsage DesktopFileCachePrivate::memoryUsage() const
+{
+    DesktopFileCacheMemoryUsage usage;
+
+    usage.fileNameBytes = hashMemoryUsage(cache) + mapMemoryUsage(lru);
+    for (const DesktopFileCacheEntry &entry : cache) {
+        const DesktopFile *file = entry.file.data();
+        usage.entries++;
+        usage.keys += file->d->items.size();
+        usage.entryBytes += qint64(sizeof(DesktopFile)) + file->d->memoryUsage(&usage.localizedBytes);
+    }
+
+    usage.mimeTypeBytes = hashMemoryUsage(defaultAppsCache);
+    for (auto it = defaultAppsCache.cbegin(); it != defaultAppsCache.cend(); ++it)
+        usage.mimeTypeBytes += stringMemoryUsage(it.key()) + listMemoryUsage(it.value());
+
+    usage.categoryBytes = hashMemoryUsage(categoryIndex);
+    for (auto it = categoryIndex.cbegin(); it != categoryIndex.cend(); ++it)
+        usage.categoryBytes += stringMemoryUsage(it.key()) + listMemoryUsage(it.value());
+
+    usage.searchIndexBytes = searchIndex.memoryUsage();
+    usage.sharedBytes = store.size();
+
+    return usage;
+}
+
 DesktopFileCache::DesktopFileCache()
     : d_ptr(new DesktopFileCachePrivate())
 {
@@ -927,46 +1471,196 @@ DesktopFileCache *DesktopFileCache::instance()
     return s_desktopFileCache();
 }
 
+/*
+ * Returns the cached entry for fileName, or for the desktop file id,
+ * loading it if needed. The entry is never evicted, see getFileHandle().
+ */
 DesktopFile *DesktopFileCache::getFile(const QString &fileName)
 {
-    if (fileName.isEmpty())
-        return nullptr;
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->lookup(fileName, true).data();
+}
 
+/*
+ * Same as getFile(), but entries outside the applications directories
+ * may be evicted when the cache is bounded, see setMaximumSize(). The
+ * handle keeps the entry alive regardless.
+ */
+QSharedPointer<DesktopFile> DesktopFileCache::getFileHandle(const QString &fileName)
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->lookup(fileName, false);
+}
+
+/*
+ * Returns all the categories found in the Categories key of the
+ * cached desktop entries.
+ */
+QStringList DesktopFileCache::categories()
+{
     DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->categoryIndex.keys();
+}
 
-    if (d->cache.contains(fileName))
-        return d->cache.value(fileName);
+/*
+ * Returns the cached desktop entries listing category in their
+ * Categories key, sorted by file name.
+ */
+QList<DesktopFile *> DesktopFileCache::getAppsByCategory(const QString &category)
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    const QList<DesktopFile *> files = d->categoryIndex.value(category);
+    d->pin(files);
+    return files;
+}
 
-    QString file;
-    if (!fileName.startsWith(QDir::separator())) {
-        // It's a relative path, search desktop file
-        file = findDesktopFile(fileName);
-        if (file.isEmpty())
-            return nullptr;
-    } else {
-        file = fileName;
+/*
+ * Search boost of an entry given its usage: up to the score of a prefix
+ * match of the name, logarithmic in the number of weighted launches.
+ */
+static int usageBoost(const QString &desktopFileId)
+{
+    if (desktopFileId.isEmpty())
+        return 0;
+
+    const qreal frecency = DesktopFileUsage::instance()->frecency(desktopFileId);
+    return qMin<int>(2 * DesktopFileIndex::NameField, qRound(4 * std::log2(1 + frecency)));
+}
+
+/*
+ * Returns the cached desktop entries whose localized name, generic name,
+ * keywords, comment or executable match every word of query, by prefix
+ * or with a typo, best matches first; the applications used most often
+ * are ranked higher. Returns at most limit entries unless limit is 0.
+ */
+QList<DesktopFile *> DesktopFileCache::search(const QString &query, int limit)
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+
+    if (!d->searchIndexReady) {
+        for (const DesktopFileCacheEntry &entry : const_cast<const QHash<QString, DesktopFileCacheEntry> &>(d->cache))
+            d->searchIndex.insert(entry.file.data());
+        d->searchIndex.setBoostFunction(usageBoost);
+        d->searchIndexReady = true;
     }
 
-    DesktopFile *desktopFile = nullptr;
-    if (!d->cache.contains(file)) {
-        // Cache it
-        desktopFile = d->load(file);
-        if (desktopFile) {
-            d->cache.insert(file, desktopFile);
-            return desktopFile;
-        } else {
-            return nullptr;
+    const QList<DesktopFile *> files = d->searchIndex.search(query, limit);
+    d->pin(files);
+    return files;
+}
+
+/*
+ * Returns at most count entries, resolved from the desktop file ids
+ * returned by ids(n); entries that are no longer installed are skipped.
+ */
+static QList<DesktopFile *> resolveUsage(const std::function<QStringList(int)> &ids, int count)
+{
+    QList<DesktopFile *> files;
+
+    for (int wanted = count; count > 0; wanted *= 2) {
+        const QStringList candidates = ids(wanted);
+
+        files.clear();
+        for (const QString &id : candidates) {
+            DesktopFile *file = DesktopFileCache::getFile(id);
+            if (file && files.size() < count)
+                files.append(file);
         }
-    } else {
-        // Already in the cache
-        desktopFile = d->cache.value(file);
-        return desktopFile;
+
+        if (files.size() == count || candidates.size() < wanted)
+            break;
     }
+
+    return files;
+}
+
+/*
+ * Returns the count applications with the highest frecency, see
+ * DesktopFileUsage.
+ */
+QList<DesktopFile *> DesktopFileCache::mostUsed(int count)
+{
+    return resolveUsage([](int n) {
+        return DesktopFileUsage::instance()->mostUsed(n);
+    }, count);
+}
+
+/*
+ * Returns the count applications launched most recently.
+ */
+QList<DesktopFile *> DesktopFileCache::recentlyUsed(int count)
+{
+    return resolveUsage([](int n) {
+        return DesktopFileUsage::instance()->recentlyUsed(n);
+    }, count);
+}
+
+DesktopFile::LoadMode DesktopFileCache::loadMode()
+{
+    return static_cast<DesktopFile::LoadMode>(s_cacheLoadMode.loadRelaxed());
+}
+
+/*
+ * Sets how the entries are loaded, CurrentLocaleLoadMode saves most of
+ * their memory on systems with many translations. Entries are never
+ * reloaded because they may be in use, so it should be called before
+ * the cache is first used.
+ */
+void DesktopFileCache::setLoadMode(DesktopFile::LoadMode mode)
+{
+    if (s_desktopFileCache.exists())
+        qCWarning(lcXdg, "Desktop file cache load mode changed after it was populated");
+    s_cacheLoadMode.storeRelaxed(mode);
+}
+
+/*
+ * Returns the estimated memory held by the cached entries and by the
+ * tables used to look them up.
+ */
+DesktopFileCacheMemoryUsage DesktopFileCache::memoryUsage()
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->memoryUsage();
+}
+
+int DesktopFileCache::maximumSize()
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->maximumSize;
+}
+
+/*
+ * Bounds the number of entries that can be evicted, least recently used
+ * first: those loaded with getFileHandle() from outside the applications
+ * directories. The default, 0, means no bound.
+ */
+void DesktopFileCache::setMaximumSize(int size)
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    d->maximumSize = qMax(0, size);
+    d->evict();
+}
+
+DesktopFileCacheStatistics DesktopFileCache::statistics()
+{
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->statistics;
 }
 
 QList<DesktopFile *> DesktopFileCache::getApps(const QString &mimeType)
 {
-    return instance()->d_ptr->defaultAppsCache.value(mimeType);
+    DesktopFileCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->defaultAppsCache.value(mimeType);
 }
 
 DesktopFile *DesktopFileCache::getDefaultApp(const QString &mimeType)
@@ -7,6 +7,7 @@
 
 #include <QProcess>
 #include <QSharedDataPointer>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 #include <QVariant>
@@ -20,6 +21,23 @@ class DesktopFilePrivate;
 class DesktopFileCachePrivate;
 class DesktopFileAction;
 
+struct LIRIXDG_EXPORT DesktopFileDiagnostic
+{
+    enum Severity {
+        ErrorSeverity,
+        WarningSeverity,
+        HintSeverity,
+    };
+
+    //! Position starting from 1, 0 when about the whole file or line
+    int line = 0;
+    int column = 0;
+    Severity severity = ErrorSeverity;
+    //! Stable identifier, such as "duplicate-key"
+    QString code;
+    QString message;
+};
+
 class LIRIXDG_EXPORT DesktopFile
 {
 public:
@@ -30,6 +48,11 @@ public:
         DirectoryType,
     };
 
+    enum LoadMode {
+        AllLocalesLoadMode,
+        CurrentLocaleLoadMode,
+    };
+
     explicit DesktopFile(const QString &fileName = QString());
     DesktopFile(const DesktopFile &other);
     virtual ~DesktopFile();
@@ -81,9 +104,14 @@ public:
     QVariant localizedValue(const QString &key, const QVariant &defaultValue = QVariant()) const;
     void setLocalizedValue(const QString &key, const QVariant &value);
 
-    bool load(const QString &fileName);
+    bool load(const QString &fileName, LoadMode mode = AllLocalesLoadMode);
     bool save(const QString &fileName);
 
+    void beginTransaction();
+    bool isInTransaction() const;
+    bool commit();
+    void rollback();
+
     void beginGroup(const QString &group);
     void endGroup();
     QString group() const;
@@ -102,8 +130,14 @@ public:
 
     static QString id(const QString &fileName);
 
+    static QList<DesktopFileDiagnostic> validate(const QString &fileName);
+
 protected:
     QSharedDataPointer<DesktopFilePrivate> d;
+
+private:
+    friend class AutoStartRegistryPrivate;
+    friend class DesktopFileCachePrivate;
 };
 
 typedef QList<DesktopFile> DesktopFileList;
@@ -116,6 +150,40 @@ private:
     explicit DesktopFileAction(const DesktopFile &parent, const QString &action);
 };
 
+struct LIRIXDG_EXPORT DesktopFileCacheMemoryUsage
+{
+    //! Cached desktop entries and the keys they hold
+    int entries = 0;
+    int keys = 0;
+    //! Estimated bytes held by the entries, with their keys and values
+    qint64 entryBytes = 0;
+    //! Part of entryBytes held by localized keys such as Name[de]
+    qint64 localizedBytes = 0;
+    //! Estimated bytes held by the lookup tables
+    qint64 fileNameBytes = 0;
+    qint64 mimeTypeBytes = 0;
+    qint64 categoryBytes = 0;
+    qint64 searchIndexBytes = 0;
+    //! Size of the store mapped from disk, shared with other processes
+    //! and not part of totalBytes()
+    qint64 sharedBytes = 0;
+
+    qint64 totalBytes() const
+    {
+        return entryBytes + fileNameBytes + mimeTypeBytes + categoryBytes + searchIndexBytes;
+    }
+};
+
+struct LIRIXDG_EXPORT DesktopFileCacheStatistics
+{
+    //! Lookups answered from memory
+    quint64 hits = 0;
+    //! Lookups that had to load the file, or didn't find it
+    quint64 misses = 0;
+    //! Entries dropped to stay within maximumSize()
+    quint64 evictions = 0;
+};
+
 class LIRIXDG_EXPORT DesktopFileCache
 {
 public:
@@ -125,9 +193,28 @@ public:
     static DesktopFileCache *instance();
 
     static DesktopFile *getFile(const QString &fileName);
+    static QSharedPointer<DesktopFile> getFileHandle(const QString &fileName);
     static QList<DesktopFile *> getApps(const QString &mimeType);
     static DesktopFile *getDefaultApp(const QString &mimeType);
 
+    static QStringList categories();
+    static QList<DesktopFile *> getAppsByCategory(const QString &category);
+
+    static QList<DesktopFile *> search(const QString &query, int limit = 0);
+
+    static QList<DesktopFile *> mostUsed(int count);
+    static QList<DesktopFile *> recentlyUsed(int count);
+
+    static DesktopFile::LoadMode loadMode();
+    static void setLoadMode(DesktopFile::LoadMode mode);
+
+    static DesktopFileCacheMemoryUsage memoryUsage();
+
+    static int maximumSize();
+    static void setMaximumSize(int size);
+
+    static DesktopFileCacheStatistics statistics();
+
 private:
     DesktopFileCachePrivate *const d_ptr;
 };
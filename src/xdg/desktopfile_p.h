@@ -5,7 +5,12 @@
 #ifndef LIRI_DESKTOPFILE_P_H
 #define LIRI_DESKTOPFILE_P_H
 
+#include <QMap>
+#include <QMutex>
+
 #include "desktopfile.h"
+#include "desktopfileindex_p.h"
+#include "desktopfilestore_p.h"
 
 //
 //  W A R N I N G
@@ -20,6 +25,8 @@
 
 namespace Liri {
 
+class DesktopFileValidator;
+
 class DesktopFilePrivate : public QSharedData
 {
 public:
@@ -27,7 +34,8 @@ public:
 
     void clear();
 
-    bool readFile();
+    bool readFile(DesktopFileValidator *validator = nullptr);
+    bool writeFile(const QString &fileName) const;
 
     DesktopFile::Type detectType(DesktopFile *q) const;
 
@@ -37,6 +45,11 @@ public:
 
     QString localizedKey(const QString &key) const;
 
+    static QStringList localeNames();
+    bool isOtherLocaleKey(const QString &key) const;
+
+    qint64 memoryUsage(qint64 *localizedBytes) const;
+
     bool startApplicationDetached(DesktopFile *q, const QString &actionName,
                                   const QStringList &urls);
     bool startLinkDetached(DesktopFile *q);
@@ -46,22 +59,67 @@ public:
     QString fileName;
     QString prefix;
     QMap<QString, QVariant> items;
+    QMap<QString, QVariant> transactionItems;
+    bool inTransaction = false;
+    // Locales of the localized keys that were loaded, all when empty
+    QStringList locales;
     DesktopFile::Type type = DesktopFile::UnknownType;
     QProcessEnvironment env;
 };
 
+struct DesktopFileCacheEntry {
+    QSharedPointer<DesktopFile> file;
+    // Found in the applications directories
+    bool indexed = false;
+    // Handed out as a raw pointer
+    bool pinned = false;
+    // Key in the LRU map, 0 unless the entry can be evicted
+    quint64 lastUsed = 0;
+};
+
 class DesktopFileCachePrivate
 {
 public:
     explicit DesktopFileCachePrivate();
 
     void initialize();
-    void initialize(const QString &path);
+    void listFiles(const QString &path, QFileInfoList *files) const;
 
     DesktopFile *load(const QString &fileName);
-
-    QHash<QString, DesktopFile *> cache;
+    DesktopFile *loadFromStore(int entry);
+    void index(const QString &fileName, DesktopFile *file);
+    DesktopFileCacheEntry &insert(const QString &fileName, DesktopFile *file, bool indexed);
+    void remove(const QString &fileName);
+
+    QSharedPointer<DesktopFile> lookup(const QString &fileName, bool pin);
+    void touch(DesktopFileCacheEntry &entry);
+    void pin(DesktopFileCacheEntry &entry);
+    void pin(const QList<DesktopFile *> &files);
+    void evict();
+
+    DesktopFileCacheMemoryUsage memoryUsage() const;
+
+    // Held by the static accessors of DesktopFileCache, menus are
+    // built on worker threads too
+    QMutex mutex;
+    QHash<QString, DesktopFileCacheEntry> cache;
     QHash<QString, QList<DesktopFile *>> defaultAppsCache;
+    QHash<QString, QList<DesktopFile *>> categoryIndex;
+
+    // Built by the first search, then kept up to date by insert()
+    DesktopFileIndex searchIndex;
+    bool searchIndexReady = false;
+
+    // Shared by the processes with the same applications directories
+    DesktopFileStore store;
+
+    // Entries that can be evicted, least recently used first: only
+    // those outside the applications directories that were never handed
+    // out as raw pointers
+    QMap<quint64, QString> lru;
+    quint64 useCounter = 0;
+    int maximumSize = 0;
+    DesktopFileCacheStatistics statistics;
 };
 
 } // namespace Liri
@@ -0,0 +1,309 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <QFileInfo>
+
+#include <algorithm>
+
+#include "desktopfile.h"
+#include "desktopfileindex_p.h"
+#include "desktopfileutils_p.h"
+
+namespace Liri {
+
+static QStringList trigrams(const QString &term)
+{
+    // Padded so that the first letters weigh more
+    const QString padded = QLatin1String("  ") + term + QLatin1Char(' ');
+
+    QStringList result;
+    for (int i = 0; i + 3 <= padded.size(); ++i)
+        result.append(padded.mid(i, 3));
+    return result;
+}
+
+static int maxEdits(const QString &token)
+{
+    if (token.size() < 4)
+        return 0;
+    return token.size() < 8 ? 1 : 2;
+}
+
+/*
+ * Splits text into lower case words stripped of diacritics.
+ */
+QStringList DesktopFileIndex::tokenize(const QString &text)
+{
+    QStringList tokens;
+    QString token;
+
+    const QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    for (const QChar c : decomposed) {
+        if (c.isMark())
+            continue;
+
+        if (c.isLetterOrNumber()) {
+            token.append(c.toLower());
+        } else if (!token.isEmpty()) {
+            tokens.append(token);
+            token.clear();
+        }
+    }
+
+    if (!token.isEmpty())
+        tokens.append(token);
+
+    return tokens;
+}
+
+/*
+ * Optimal string alignment distance, gives up as soon as it
+ * exceeds maxDistance and returns maxDistance + 1.
+ */
+int DesktopFileIndex::editDistance(QStringView a, QStringView b, int maxDistance)
+{
+    if (qAbs(a.size() - b.size()) > maxDistance)
+        return maxDistance + 1;
+
+    const int n = int(a.size());
+    const int m = int(b.size());
+    QVector<int> previous2(m + 1), previous(m + 1), current(m + 1);
+    for (int j = 0; j <= m; ++j)
+        previous[j] = j;
+
+    for (int i = 1; i <= n; ++i) {
+        current[0] = i;
+        int rowMin = current[0];
+
+        for (int j = 1; j <= m; ++j) {
+            const int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            current[j] = qMin(qMin(previous[j] + 1, current[j - 1] + 1), previous[j - 1] + cost);
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                current[j] = qMin(current[j], previous2[j - 2] + 1);
+            rowMin = qMin(rowMin, current[j]);
+        }
+
+        if (rowMin > maxDistance)
+            return maxDistance + 1;
+
+        previous2.swap(previous);
+        previous.swap(current);
+    }
+
+    return qMin(previous[m], maxDistance + 1);
+}
+
+void DesktopFileIndex::addTerm(DesktopFile *file, const QString &term, int weight)
+{
+    int &current = mDocuments[file].terms[term];
+    if (current >= weight)
+        return;
+    current = weight;
+
+    QSet<DesktopFile *> &files = mTerms[term];
+    if (files.isEmpty()) {
+        const QStringList grams = trigrams(term);
+        for (const QString &gram : grams)
+            mTrigrams[gram].insert(term);
+    }
+    files.insert(file);
+}
+
+void DesktopFileIndex::insert(DesktopFile *file)
+{
+    if (!file || mDocuments.contains(file))
+        return;
+
+    Document document;
+    document.desktopFileId = DesktopFile::id(file->fileName());
+    mDocuments.insert(file, document);
+
+    const auto addText = [this, file](const QString &text, int weight) {
+        const QStringList tokens = tokenize(text);
+        for (const QString &token : tokens)
+            addTerm(file, token, weight);
+    };
+
+    addText(file->name(), NameField);
+    addText(file->genericName(), GenericNameField);
+    addText(file->keywords().join(QLatin1Char(' ')), KeywordsField);
+    addText(file->comment(), CommentField);
+
+    const QStringList args = parseCombinedArgString(file->exec());
+    if (!args.isEmpty())
+        addText(QFileInfo(args.first()).fileName(), ExecField);
+}
+
+void DesktopFileIndex::remove(DesktopFile *file)
+{
+    auto it = mDocuments.find(file);
+    if (it == mDocuments.end())
+        return;
+
+    for (auto term = it->terms.cbegin(); term != it->terms.cend(); ++term) {
+        auto files = mTerms.find(term.key());
+        if (files == mTerms.end())
+            continue;
+
+        files->remove(file);
+        if (!files->isEmpty())
+            continue;
+
+        mTerms.erase(files);
+        const QStringList grams = trigrams(term.key());
+        for (const QString &gram : grams) {
+            auto terms = mTrigrams.find(gram);
+            if (terms == mTrigrams.end())
+                continue;
+            terms->remove(term.key());
+            if (terms->isEmpty())
+                mTrigrams.erase(terms);
+        }
+    }
+
+    mDocuments.erase(it);
+}
+
+void DesktopFileIndex::clear()
+{
+    mDocuments.clear();
+    mTerms.clear();
+    mTrigrams.clear();
+}
+
+/*
+ * Terms are shared by the documents, the term map and the trigram
+ * sets, their characters are counted once.
+ */
+qint64 DesktopFileIndex::memoryUsage() const
+{
+    qint64 bytes = hashMemoryUsage(mDocuments);
+    for (auto it = mDocuments.cbegin(); it != mDocuments.cend(); ++it)
+        bytes += hashMemoryUsage(it->terms) + stringMemoryUsage(it->desktopFileId);
+
+    bytes += mapMemoryUsage(mTerms);
+    for (auto it = mTerms.cbegin(); it != mTerms.cend(); ++it)
+        bytes += stringMemoryUsage(it.key()) + setMemoryUsage(it.value());
+
+    bytes += hashMemoryUsage(mTrigrams);
+    for (auto it = mTrigrams.cbegin(); it != mTrigrams.cend(); ++it)
+        bytes += stringMemoryUsage(it.key()) + setMemoryUsage(it.value());
+
+    return bytes;
+}
+
+void DesktopFileIndex::setBoostFunction(const BoostFunction &function)
+{
+    mBoost = function;
+}
+
+/*
+ * Scores the entries matching one query token: an exact term scores
+ * three times its field weight, a prefix twice and a typo once.
+ */
+void DesktopFileIndex::matchToken(const QString &token, QHash<DesktopFile *, int> *scores) const
+{
+    const auto score = [this, scores](const QString &term, int factor) {
+        const QSet<DesktopFile *> files = mTerms.value(term);
+        for (DesktopFile *file : files) {
+            const int value = mDocuments.value(file).terms.value(term) * factor;
+            int &best = (*scores)[file];
+            best = qMax(best, value);
+        }
+    };
+
+    // Exact and prefix
+    for (auto it = mTerms.lowerBound(token); it != mTerms.cend() && it.key().startsWith(token); ++it)
+        score(it.key(), it.key().size() == token.size() ? 3 : 2);
+
+    // Typos, compared with whole terms and with prefixes as long as the token
+    const int edits = maxEdits(token);
+    if (edits == 0)
+        return;
+
+    const QStringList grams = trigrams(token);
+    QHash<QString, int> shared;
+    for (const QString &gram : grams) {
+        const QSet<QString> terms = mTrigrams.value(gram);
+        for (const QString &term : terms)
+            ++shared[term];
+    }
+
+    const int minShared = qMax(1, int(grams.size()) - 3 * edits);
+    for (auto it = shared.cbegin(); it != shared.cend(); ++it) {
+        const QString &term = it.key();
+        if (it.value() < minShared || term.startsWith(token))
+            continue;
+
+        const int distance = qMin(editDistance(token, term, edits),
+                                  editDistance(token, QStringView(term).left(token.size()), edits));
+        if (distance <= edits)
+            score(term, 1);
+    }
+}
+
+QList<DesktopFile *> DesktopFileIndex::search(const QString &query, int limit) const
+{
+    const QStringList tokens = tokenize(query);
+    if (tokens.isEmpty())
+        return QList<DesktopFile *>();
+
+    // Every token has to match
+    QHash<DesktopFile *, int> total;
+    for (int i = 0; i < tokens.size(); ++i) {
+        QHash<DesktopFile *, int> scores;
+        matchToken(tokens.at(i), &scores);
+
+        if (i == 0) {
+            total = scores;
+            continue;
+        }
+
+        for (auto it = total.begin(); it != total.end();) {
+            const int value = scores.value(it.key());
+            if (value == 0) {
+                it = total.erase(it);
+            } else {
+                it.value() += value;
+                ++it;
+            }
+        }
+    }
+
+    struct Result {
+        DesktopFile *file;
+        int score;
+        QString name;
+    };
+
+    QVector<Result> results;
+    results.reserve(total.size());
+    for (auto it = total.cbegin(); it != total.cend(); ++it) {
+        int score = it.value();
+        if (mBoost)
+            score += mBoost(mDocuments.value(it.key()).desktopFileId);
+        results.append(Result{ it.key(), score, it.key()->name() });
+    }
+
+    const auto better = [](const Result &a, const Result &b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.name.localeAwareCompare(b.name) < 0;
+    };
+
+    if (limit > 0 && limit < results.size()) {
+        std::partial_sort(results.begin(), results.begin() + limit, results.end(), better);
+        results.resize(limit);
+    } else {
+        std::sort(results.begin(), results.end(), better);
+    }
+
+    QList<DesktopFile *> files;
+    files.reserve(results.size());
+    for (const Result &result : const_cast<const QVector<Result> &>(results))
+        files.append(result.file);
+    return files;
+}
+
+} // namespace Liri
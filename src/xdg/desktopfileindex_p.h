@@ -0,0 +1,89 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPFILEINDEX_P_H
+#define LIRI_DESKTOPFILEINDEX_P_H
+
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+class DesktopFile;
+
+/*
+ * Full-text index over the localized name, generic name, keywords,
+ * comment and executable of desktop entries.
+ *
+ * Terms are lower case words without diacritics, kept in a sorted map
+ * so that prefix queries are a range scan. Typos are tolerated through
+ * a trigram index of the terms, candidates are verified with a bounded
+ * edit distance.
+ */
+class DesktopFileIndex
+{
+public:
+    enum Field {
+        NameField = 8,
+        ExecField = 6,
+        GenericNameField = 4,
+        KeywordsField = 4,
+        CommentField = 1,
+    };
+
+    void insert(DesktopFile *file);
+    void remove(DesktopFile *file);
+    void clear();
+
+    bool contains(DesktopFile *file) const { return mDocuments.contains(file); }
+    int count() const { return mDocuments.count(); }
+
+    // Estimated heap usage in bytes
+    qint64 memoryUsage() const;
+
+    // Entries matching every word of query, best first, at most limit if > 0
+    QList<DesktopFile *> search(const QString &query, int limit = 0) const;
+
+    // Extra score by desktop file id, such as usage frequency, added to
+    // the text score of the matching entries
+    typedef std::function<int(const QString &desktopFileId)> BoostFunction;
+    void setBoostFunction(const BoostFunction &function);
+
+    static QStringList tokenize(const QString &text);
+    static int editDistance(QStringView a, QStringView b, int maxDistance);
+
+private:
+    struct Document {
+        QHash<QString, int> terms; // term -> field weight
+        QString desktopFileId;
+    };
+
+    void addTerm(DesktopFile *file, const QString &term, int weight);
+    void matchToken(const QString &token, QHash<DesktopFile *, int> *scores) const;
+
+    QHash<DesktopFile *, Document> mDocuments;
+    QMap<QString, QSet<DesktopFile *>> mTerms;
+    QHash<QString, QSet<QString>> mTrigrams;
+    BoostFunction mBoost;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPFILEINDEX_P_H
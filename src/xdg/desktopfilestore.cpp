@@ -0,0 +1,355 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <QDateTime>
+#include <QDir>
+#include <QHash>
+#include <QSaveFile>
+
+#include <climits>
+#include <cstring>
+
+#include "desktopfilestore_p.h"
+#include "xdgdirs_p_p.h"
+#include "logging_p.h"
+
+namespace Liri {
+
+static const char storeMagic[8] = { 'L', 'I', 'R', 'I', 'D', 'F', 'S', '\0' };
+static const quint32 storeByteOrder = 0x01020304;
+
+static const quint64 fnvOffsetBasis = Q_UINT64_C(0xcbf29ce484222325);
+
+// 64-bit FNV-1a, stable across processes unlike qHash()
+static quint64 fnv1a(quint64 hash, const void *data, size_t size)
+{
+    const uchar *bytes = static_cast<const uchar *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= Q_UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+template <typename T>
+static void appendRaw(QByteArray *data, const T &value)
+{
+    data->append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/*
+ * There is one store for each set of applications directories, so that
+ * processes with another XDG_DATA_DIRS don't replace it all the time.
+ */
+QString DesktopFileStore::defaultFileName(const QStringList &locations)
+{
+    const QString joined = locations.join(QLatin1Char(':'));
+    const quint64 hash = fnv1a(fnvOffsetBasis, joined.constData(), size_t(joined.size()) * sizeof(QChar));
+    return XdgDirs::cacheHome(false)
+            + QStringLiteral("/liri/desktop-entries-%1.cache").arg(hash, 16, 16, QLatin1Char('0'));
+}
+
+/*
+ * Changes whenever a desktop file is added, removed or modified.
+ */
+quint64 DesktopFileStore::sourceStamp(const QFileInfoList &files)
+{
+    quint64 hash = fnvOffsetBasis;
+
+    for (const QFileInfo &info : files) {
+        const QString path = info.absoluteFilePath();
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        const qint64 size = info.size();
+
+        hash = fnv1a(hash, path.constData(), size_t(path.size()) * sizeof(QChar));
+        hash = fnv1a(hash, &modified, sizeof(modified));
+        hash = fnv1a(hash, &size, sizeof(size));
+    }
+
+    return hash;
+}
+
+/*
+ * Maps the store, provided that it's valid and was built from the files
+ * with the given stamp.
+ */
+bool DesktopFileStore::open(const QString &fileName, quint64 sourceStamp)
+{
+    close();
+
+    mFile.setFileName(fileName);
+    if (!mFile.open(QFile::ReadOnly))
+        return false;
+
+    const qint64 size = mFile.size();
+    if (size < qint64(sizeof(DesktopFileStoreHeader) + sizeof(quint64)) || size > qint64(UINT_MAX)) {
+        close();
+        return false;
+    }
+
+    mData = mFile.map(0, size);
+    if (!mData) {
+        close();
+        return false;
+    }
+    mSize = quint32(size);
+    mHeader = reinterpret_cast<const DesktopFileStoreHeader *>(mData);
+
+    if (!isValid() || mHeader->sourceStamp != sourceStamp) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void DesktopFileStore::close()
+{
+    mHeader = nullptr;
+    if (mData)
+        mFile.unmap(const_cast<uchar *>(mData));
+    mData = nullptr;
+    mSize = 0;
+    mFile.close();
+}
+
+quint64 DesktopFileStore::generation() const
+{
+    return mHeader ? mHeader->generation : 0;
+}
+
+int DesktopFileStore::count() const
+{
+    return mHeader ? int(mHeader->entryCount) : 0;
+}
+
+QString DesktopFileStore::fileName(int entry) const
+{
+    const auto *entries = reinterpret_cast<const DesktopFileStoreEntry *>(mData + mHeader->entries);
+    return string(entries[entry].fileName);
+}
+
+/*
+ * The keys and values point into the mapping.
+ */
+QMap<QString, QVariant> DesktopFileStore::items(int entry) const
+{
+    const auto *entries = reinterpret_cast<const DesktopFileStoreEntry *>(mData + mHeader->entries);
+    const auto *items = reinterpret_cast<const DesktopFileStoreItem *>(mData + entries[entry].items);
+
+    QMap<QString, QVariant> result;
+    for (quint32 i = 0; i < entries[entry].itemCount; ++i) {
+        const DesktopFileStoreItem &item = items[i];
+
+        if (item.type == DesktopFileStoreItem::List) {
+            const auto *offsets = reinterpret_cast<const quint32 *>(mData + item.value);
+            QStringList list;
+            list.reserve(item.count);
+            for (quint32 j = 0; j < item.count; ++j)
+                list.append(string(offsets[j]));
+            result.insert(string(item.key), list);
+        } else {
+            result.insert(string(item.key), string(item.value));
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Lays the entries out and replaces the store atomically, with the
+ * generation following the one of the store being replaced.
+ */
+bool DesktopFileStore::write(const QString &fileName, quint64 sourceStamp, const QVector<Source> &sources)
+{
+    quint64 generation = 1;
+    QFile previous(fileName);
+    if (previous.open(QFile::ReadOnly)) {
+        DesktopFileStoreHeader header;
+        if (previous.read(reinterpret_cast<char *>(&header), sizeof(header)) == qint64(sizeof(header))
+                && std::memcmp(header.magic, storeMagic, sizeof(storeMagic)) == 0)
+            generation = header.generation + 1;
+        previous.close();
+    }
+
+    // The strings go after the items, whose size is known beforehand
+    quint64 itemsSize = 0;
+    for (const Source &source : sources) {
+        itemsSize += quint64(source.second.size()) * sizeof(DesktopFileStoreItem);
+        for (const QVariant &value : source.second) {
+            if (value.userType() == QMetaType::QStringList)
+                itemsSize += quint64(value.toStringList().size()) * sizeof(quint32);
+        }
+    }
+
+    const quint64 entriesOffset = sizeof(DesktopFileStoreHeader);
+    const quint64 itemsOffset = entriesOffset + quint64(sources.size()) * sizeof(DesktopFileStoreEntry);
+    const quint64 stringsOffset = itemsOffset + itemsSize;
+
+    QByteArray entries;
+    QByteArray items;
+    QByteArray strings;
+    QHash<QString, quint32> stringOffsets;
+
+    // Strings are stored once, aligned to 4 bytes
+    const auto addString = [&](const QString &str) {
+        auto it = stringOffsets.constFind(str);
+        if (it != stringOffsets.constEnd())
+            return it.value();
+
+        const quint32 offset = quint32(stringsOffset + quint64(strings.size()));
+        appendRaw(&strings, quint32(str.size()));
+        strings.append(reinterpret_cast<const char *>(str.utf16()), str.size() * qsizetype(sizeof(QChar)));
+        while (strings.size() % 4)
+            strings.append('\0');
+        stringOffsets.insert(str, offset);
+        return offset;
+    };
+
+    for (const Source &source : sources) {
+        DesktopFileStoreEntry entry = {};
+        entry.fileName = addString(source.first);
+        entry.itemCount = quint32(source.second.size());
+        entry.items = quint32(itemsOffset + quint64(items.size()));
+        appendRaw(&entries, entry);
+
+        // Lists follow the items of the entry
+        QByteArray lists;
+        const quint64 listsOffset = itemsOffset + quint64(items.size())
+                + quint64(source.second.size()) * sizeof(DesktopFileStoreItem);
+
+        for (auto it = source.second.cbegin(); it != source.second.cend(); ++it) {
+            DesktopFileStoreItem item = {};
+            item.key = addString(it.key());
+
+            if (it.value().userType() == QMetaType::QStringList) {
+                const QStringList list = it.value().toStringList();
+                item.type = DesktopFileStoreItem::List;
+                item.value = quint32(listsOffset + quint64(lists.size()));
+                item.count = quint32(list.size());
+                for (const QString &str : list)
+                    appendRaw(&lists, addString(str));
+            } else {
+                item.type = DesktopFileStoreItem::String;
+                item.value = addString(it.value().toString());
+            }
+
+            appendRaw(&items, item);
+        }
+
+        items += lists;
+    }
+
+    const quint64 size = stringsOffset + quint64(strings.size()) + sizeof(quint64);
+    if (size > UINT_MAX) {
+        qCWarning(lcXdg, "Too many desktop entries to store in \"%s\"", qPrintable(fileName));
+        return false;
+    }
+
+    DesktopFileStoreHeader header = {};
+    std::memcpy(header.magic, storeMagic, sizeof(storeMagic));
+    header.version = DESKTOP_FILE_STORE_VERSION;
+    header.byteOrder = storeByteOrder;
+    header.generation = generation;
+    header.sourceStamp = sourceStamp;
+    header.entryCount = quint32(sources.size());
+    header.entries = quint32(entriesOffset);
+    header.size = quint32(size);
+
+    QByteArray data;
+    data.reserve(qsizetype(size));
+    appendRaw(&data, header);
+    data += entries;
+    data += items;
+    data += strings;
+    appendRaw(&data, generation);
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qCWarning(lcXdg, "Failed to write \"%s\": %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Checks the header and that every offset is within bounds, so that a
+ * corrupted or truncated store is never read past its end.
+ */
+bool DesktopFileStore::isValid() const
+{
+    if (std::memcmp(mHeader->magic, storeMagic, sizeof(storeMagic)) != 0
+            || mHeader->version != DESKTOP_FILE_STORE_VERSION
+            || mHeader->byteOrder != storeByteOrder
+            || mHeader->size != mSize)
+        return false;
+
+    // Torn writes leave a trailer that doesn't match the header
+    quint64 trailer;
+    std::memcpy(&trailer, mData + mSize - sizeof(quint64), sizeof(trailer));
+    if (trailer != mHeader->generation)
+        return false;
+
+    const quint64 end = mSize - sizeof(quint64);
+    const auto fits = [end](quint64 offset, quint64 size) {
+        return offset % 4 == 0 && offset <= end && size <= end - offset;
+    };
+
+    if (!fits(mHeader->entries, quint64(mHeader->entryCount) * sizeof(DesktopFileStoreEntry)))
+        return false;
+
+    const auto *entries = reinterpret_cast<const DesktopFileStoreEntry *>(mData + mHeader->entries);
+    for (quint32 e = 0; e < mHeader->entryCount; ++e) {
+        const DesktopFileStoreEntry &entry = entries[e];
+        if (!isValidString(entry.fileName)
+                || !fits(entry.items, quint64(entry.itemCount) * sizeof(DesktopFileStoreItem)))
+            return false;
+
+        const auto *items = reinterpret_cast<const DesktopFileStoreItem *>(mData + entry.items);
+        for (quint32 i = 0; i < entry.itemCount; ++i) {
+            const DesktopFileStoreItem &item = items[i];
+            if (!isValidString(item.key))
+                return false;
+
+            if (item.type == DesktopFileStoreItem::String) {
+                if (!isValidString(item.value))
+                    return false;
+            } else if (item.type == DesktopFileStoreItem::List) {
+                if (!fits(item.value, quint64(item.count) * sizeof(quint32)))
+                    return false;
+                const auto *offsets = reinterpret_cast<const quint32 *>(mData + item.value);
+                for (quint32 j = 0; j < item.count; ++j) {
+                    if (!isValidString(offsets[j]))
+                        return false;
+                }
+            } else {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool DesktopFileStore::isValidString(quint32 offset) const
+{
+    const quint64 end = mSize - sizeof(quint64);
+    if (offset % 4 != 0 || quint64(offset) + sizeof(quint32) > end)
+        return false;
+
+    const quint32 length = *reinterpret_cast<const quint32 *>(mData + offset);
+    return quint64(length) * sizeof(QChar) <= end - offset - sizeof(quint32);
+}
+
+QString DesktopFileStore::string(quint32 offset) const
+{
+    const quint32 length = *reinterpret_cast<const quint32 *>(mData + offset);
+    return QString::fromRawData(reinterpret_cast<const QChar *>(mData + offset + sizeof(quint32)), length);
+}
+
+} // namespace Liri
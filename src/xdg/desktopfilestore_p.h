@@ -0,0 +1,119 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPFILESTORE_P_H
+#define LIRI_DESKTOPFILESTORE_P_H
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QPair>
+#include <QVariant>
+#include <QVector>
+
+// Bumped whenever the layout changes
+#define DESKTOP_FILE_STORE_VERSION 1
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+/*
+ * Layout of the store, in native byte order. Positions are offsets from
+ * the beginning of the file, aligned to 4 bytes; there are no pointers
+ * so that every process can map it anywhere.
+ *
+ *   header
+ *   entries[entryCount]
+ *   items and lists
+ *   strings: quint32 length, then UTF-16 characters
+ *   quint64 generation, the same as in the header
+ */
+struct DesktopFileStoreHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint64 generation;
+    quint64 sourceStamp;
+    quint32 entryCount;
+    quint32 entries;
+    quint32 size;
+    quint32 reserved;
+};
+
+struct DesktopFileStoreEntry {
+    quint32 fileName;
+    quint32 itemCount;
+    quint32 items;
+    quint32 reserved;
+};
+
+struct DesktopFileStoreItem {
+    enum Type : quint32 {
+        String,
+        List,
+    };
+
+    quint32 key;
+    Type type;
+    // A string, or an array of count strings
+    quint32 value;
+    quint32 count;
+};
+
+/*
+ * Read-only database of the desktop entries of the applications
+ * directories, written by the first process that parses them and
+ * mapped by the others. Strings point right into the mapping, so
+ * they take no private memory until they are modified.
+ *
+ * The store is replaced atomically with a new generation, processes
+ * that mapped the previous one keep reading it. A store whose header
+ * and trailer generations differ, or whose offsets are out of bounds,
+ * is ignored.
+ */
+class DesktopFileStore
+{
+public:
+    static QString defaultFileName(const QStringList &locations);
+    static quint64 sourceStamp(const QFileInfoList &files);
+
+    bool open(const QString &fileName, quint64 sourceStamp);
+
+    bool isOpen() const { return mHeader != nullptr; }
+    quint64 generation() const;
+    quint32 size() const { return mSize; }
+
+    int count() const;
+    QString fileName(int entry) const;
+    QMap<QString, QVariant> items(int entry) const;
+
+    // File name and items of a desktop entry
+    typedef QPair<QString, QMap<QString, QVariant>> Source;
+    static bool write(const QString &fileName, quint64 sourceStamp, const QVector<Source> &sources);
+
+private:
+    void close();
+    bool isValid() const;
+    bool isValidString(quint32 offset) const;
+    QString string(quint32 offset) const;
+
+    QFile mFile;
+    const uchar *mData = nullptr;
+    const DesktopFileStoreHeader *mHeader = nullptr;
+    quint32 mSize = 0;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPFILESTORE_P_H
@@ -0,0 +1,494 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+
+#include <cmath>
+#include <utility>
+
+#include "desktopfileusage.h"
+#include "desktopfileusage_p.h"
+#include "xdgdirs_p_p.h"
+#include "logging_p.h"
+
+namespace Liri {
+
+/*
+ * The default store follows the application thread, as launches can
+ * be recorded from any thread.
+ */
+class DefaultDesktopFileUsage : public DesktopFileUsage
+{
+public:
+    DefaultDesktopFileUsage()
+        : DesktopFileUsage(XdgDirs::dataHome(false) + QStringLiteral("/liri/desktop-usage.log"))
+    {
+        if (QCoreApplication::instance())
+            moveToThread(QCoreApplication::instance()->thread());
+    }
+};
+
+Q_GLOBAL_STATIC(DefaultDesktopFileUsage, s_desktopFileUsage)
+
+/*
+ * DesktopFileUsageRecord
+ */
+
+QByteArray DesktopFileUsageRecord::toLine() const
+{
+    QByteArray line(1, char(type));
+
+    switch (type) {
+    case Launch:
+        line += QByteArray::number(entry.lastLaunched) + ' ';
+        break;
+    case Forget:
+        break;
+    case Entry:
+        line += QByteArray::number(entry.count) + ' '
+                + QByteArray::number(entry.lastLaunched) + ' '
+                + QByteArray::number(entry.score, 'g', 17) + ' ';
+        break;
+    }
+
+    return line + desktopFileId.toUtf8() + '\n';
+}
+
+bool DesktopFileUsageRecord::fromLine(const QByteArray &line, DesktopFileUsageRecord *record)
+{
+    if (line.isEmpty())
+        return false;
+
+    int fields = 0;
+    switch (line.at(0)) {
+    case Launch:
+        fields = 1;
+        break;
+    case Forget:
+        fields = 0;
+        break;
+    case Entry:
+        fields = 3;
+        break;
+    default:
+        return false;
+    }
+
+    // The id comes last, after the numbers
+    QList<QByteArray> values;
+    qsizetype from = 1;
+    for (int i = 0; i < fields; ++i) {
+        const qsizetype space = line.indexOf(' ', from);
+        if (space < 0)
+            return false;
+        values.append(line.mid(from, space - from));
+        from = space + 1;
+    }
+
+    record->type = static_cast<Type>(line.at(0));
+    record->desktopFileId = QString::fromUtf8(line.mid(from));
+    record->entry = DesktopFileUsageEntry();
+    if (record->desktopFileId.isEmpty())
+        return false;
+
+    bool ok = true;
+    if (record->type == Launch) {
+        record->entry.lastLaunched = values.at(0).toLongLong(&ok);
+    } else if (record->type == Entry) {
+        bool countOk = false, timeOk = false, scoreOk = false;
+        record->entry.count = values.at(0).toInt(&countOk);
+        record->entry.lastLaunched = values.at(1).toLongLong(&timeOk);
+        record->entry.score = values.at(2).toDouble(&scoreOk);
+        ok = countOk && timeOk && scoreOk && record->entry.count > 0;
+    }
+
+    return ok;
+}
+
+/*
+ * DesktopFileUsageTable
+ */
+
+void DesktopFileUsageTable::apply(const DesktopFileUsageRecord &record)
+{
+    switch (record.type) {
+    case DesktopFileUsageRecord::Launch: {
+        const double score = record.entry.lastLaunched / USAGE_HALF_LIFE;
+
+        DesktopFileUsageEntry entry;
+        auto it = mNodes.constFind(record.desktopFileId);
+        if (it != mNodes.constEnd()) {
+            // log2(2^a + 2^b) without overflowing
+            entry = it->entry;
+            const double high = qMax(entry.score, score);
+            const double low = qMin(entry.score, score);
+            entry.score = high + std::log2(1.0 + std::exp2(low - high));
+        } else {
+            entry.score = score;
+        }
+        entry.count++;
+        entry.lastLaunched = qMax(entry.lastLaunched, record.entry.lastLaunched);
+
+        set(record.desktopFileId, entry);
+        break;
+    }
+    case DesktopFileUsageRecord::Forget:
+        remove(record.desktopFileId);
+        break;
+    case DesktopFileUsageRecord::Entry:
+        set(record.desktopFileId, record.entry);
+        break;
+    }
+}
+
+void DesktopFileUsageTable::load(const QByteArray &data, int *lines)
+{
+    int count = 0;
+
+    const QList<QByteArray> records = data.split('\n');
+    for (const QByteArray &line : records) {
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        // Lines cut short by a crash are skipped
+        DesktopFileUsageRecord record;
+        if (!DesktopFileUsageRecord::fromLine(line, &record))
+            continue;
+
+        apply(record);
+        ++count;
+    }
+
+    if (lines)
+        *lines = count;
+}
+
+/*
+ * Returns the compacted log, the entries weighing less than 1/64 of a
+ * launch, that is not used for six half lives, are left out.
+ */
+QByteArray DesktopFileUsageTable::save(qint64 now) const
+{
+    QByteArray data("# Liri desktop usage log\n");
+
+    for (auto it = mByScore.cbegin(); it != mByScore.cend(); ++it) {
+        const DesktopFileUsageEntry &entry = mNodes.value(it->second).entry;
+        if (frecency(entry, now) < 1.0 / 64)
+            break;
+
+        DesktopFileUsageRecord record;
+        record.type = DesktopFileUsageRecord::Entry;
+        record.desktopFileId = it->second;
+        record.entry = entry;
+        data += record.toLine();
+    }
+
+    return data;
+}
+
+const DesktopFileUsageEntry *DesktopFileUsageTable::find(const QString &desktopFileId) const
+{
+    auto it = mNodes.constFind(desktopFileId);
+    if (it == mNodes.constEnd())
+        return nullptr;
+    return &it->entry;
+}
+
+QStringList DesktopFileUsageTable::mostUsed(int count) const
+{
+    QStringList result;
+    for (auto it = mByScore.cbegin(); it != mByScore.cend() && result.size() < count; ++it)
+        result.append(it->second);
+    return result;
+}
+
+QStringList DesktopFileUsageTable::recentlyUsed(int count) const
+{
+    QStringList result;
+    for (auto it = mByTime.cbegin(); it != mByTime.cend() && result.size() < count; ++it)
+        result.append(it->second);
+    return result;
+}
+
+qreal DesktopFileUsageTable::frecency(const DesktopFileUsageEntry &entry, qint64 now)
+{
+    if (entry.count == 0)
+        return 0;
+    return std::exp2(entry.score - now / USAGE_HALF_LIFE);
+}
+
+void DesktopFileUsageTable::set(const QString &desktopFileId, const DesktopFileUsageEntry &entry)
+{
+    remove(desktopFileId);
+
+    Node node;
+    node.entry = entry;
+    node.byScore = mByScore.emplace(entry.score, desktopFileId);
+    node.byTime = mByTime.emplace(entry.lastLaunched, desktopFileId);
+    mNodes.insert(desktopFileId, node);
+}
+
+void DesktopFileUsageTable::remove(const QString &desktopFileId)
+{
+    auto it = mNodes.find(desktopFileId);
+    if (it == mNodes.end())
+        return;
+
+    mByScore.erase(it->byScore);
+    mByTime.erase(it->byTime);
+    mNodes.erase(it);
+}
+
+/*
+ * DesktopFileUsagePrivate
+ */
+
+DesktopFileUsagePrivate::DesktopFileUsagePrivate(DesktopFileUsage *self)
+    : flushTimer(new QTimer(self))
+    , q_ptr(self)
+{
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(USAGE_FLUSH_DELAY);
+    QObject::connect(flushTimer, &QTimer::timeout, self, [this]() {
+        scheduleWrite();
+    });
+
+    // Records are written in order
+    writePool.setMaxThreadCount(1);
+}
+
+void DesktopFileUsagePrivate::record(const DesktopFileUsageRecord &record)
+{
+    Q_Q(DesktopFileUsage);
+
+    {
+        QMutexLocker locker(&mutex);
+        table.apply(record);
+        pending.append(record);
+    }
+
+    // Whatever is recorded until the timeout goes in the same write
+    startFlushTimer();
+
+    Q_EMIT q->usageChanged(record.desktopFileId);
+}
+
+void DesktopFileUsagePrivate::startFlushTimer()
+{
+    QMetaObject::invokeMethod(flushTimer, [this]() {
+        if (!flushTimer->isActive())
+            flushTimer->start();
+    });
+}
+
+void DesktopFileUsagePrivate::scheduleWrite()
+{
+    writePool.start([this]() {
+        write();
+    });
+}
+
+/*
+ * Runs on the writer thread. Pending records are appended to the log
+ * without syncing it, other processes may be appending to it as well.
+ * Once the log has grown long enough, it's read back and replaced with
+ * one line per entry.
+ */
+void DesktopFileUsagePrivate::write()
+{
+    QMutexLocker locker(&mutex);
+    const QVector<DesktopFileUsageRecord> records = std::exchange(pending, {});
+    if (records.isEmpty())
+        return;
+    const bool compact = logLines + records.count() > 2 * table.count() + USAGE_COMPACT_SLACK;
+    locker.unlock();
+
+    // The records go back ahead of those recorded meanwhile, for the next write
+    const auto retry = [this, &locker, &records]() {
+        locker.relock();
+        pending = records + pending;
+        locker.unlock();
+        startFlushTimer();
+    };
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QLockFile lock(fileName + QStringLiteral(".lock"));
+    if (!lock.lock()) {
+        qCWarning(lcXdg, "Failed to lock \"%s\"", qPrintable(fileName));
+        retry();
+        return;
+    }
+
+    if (!compact) {
+        QByteArray data;
+        for (const DesktopFileUsageRecord &record : records)
+            data += record.toLine();
+
+        QFile file(fileName);
+        if (!file.open(QFile::WriteOnly | QFile::Append)) {
+            qCWarning(lcXdg, "Failed to write \"%s\": %s",
+                      qPrintable(fileName), qPrintable(file.errorString()));
+            retry();
+            return;
+        }
+
+        // Lines written in part are dropped, they are written again
+        const qint64 size = file.size();
+        if (file.write(data) != data.size() || !file.flush()) {
+            qCWarning(lcXdg, "Failed to write \"%s\": %s",
+                      qPrintable(fileName), qPrintable(file.errorString()));
+            file.resize(size);
+            retry();
+            return;
+        }
+
+        locker.relock();
+        logLines += static_cast<int>(records.count());
+        return;
+    }
+
+    // Start over from the log, which has the launches of other processes too
+    DesktopFileUsageTable merged;
+    QFile file(fileName);
+    if (file.open(QFile::ReadOnly))
+        merged.load(file.readAll());
+    file.close();
+    for (const DesktopFileUsageRecord &record : records)
+        merged.apply(record);
+
+    const QByteArray data = merged.save(QDateTime::currentMSecsSinceEpoch());
+
+    QSaveFile saveFile(fileName);
+    if (!saveFile.open(QFile::WriteOnly) || saveFile.write(data) != data.size() || !saveFile.commit()) {
+        qCWarning(lcXdg, "Failed to compact \"%s\": %s",
+                  qPrintable(fileName), qPrintable(saveFile.errorString()));
+        retry();
+        return;
+    }
+    lock.unlock();
+
+    // The compacted log is the new reference, replay what was recorded meanwhile
+    DesktopFileUsageTable compacted;
+    int lines = 0;
+    compacted.load(data, &lines);
+
+    locker.relock();
+    for (const DesktopFileUsageRecord &record : const_cast<const QVector<DesktopFileUsageRecord> &>(pending))
+        compacted.apply(record);
+    table = std::move(compacted);
+    logLines = lines;
+}
+
+/*
+ * DesktopFileUsage
+ */
+
+DesktopFileUsage::DesktopFileUsage(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new DesktopFileUsagePrivate(this))
+{
+    Q_D(DesktopFileUsage);
+    d->fileName = fileName;
+
+    QFile file(fileName);
+    if (file.open(QFile::ReadOnly))
+        d->table.load(file.readAll(), &d->logLines);
+}
+
+DesktopFileUsage::~DesktopFileUsage()
+{
+    flush();
+    delete d_ptr;
+}
+
+DesktopFileUsage *DesktopFileUsage::instance()
+{
+    return s_desktopFileUsage();
+}
+
+QString DesktopFileUsage::fileName() const
+{
+    Q_D(const DesktopFileUsage);
+    return d->fileName;
+}
+
+void DesktopFileUsage::recordLaunch(const QString &desktopFileId, const QDateTime &time)
+{
+    Q_D(DesktopFileUsage);
+
+    if (desktopFileId.isEmpty() || desktopFileId.contains(QLatin1Char('\n')))
+        return;
+
+    DesktopFileUsageRecord record;
+    record.type = DesktopFileUsageRecord::Launch;
+    record.desktopFileId = desktopFileId;
+    record.entry.lastLaunched = time.toMSecsSinceEpoch();
+    d->record(record);
+}
+
+void DesktopFileUsage::forget(const QString &desktopFileId)
+{
+    Q_D(DesktopFileUsage);
+
+    if (desktopFileId.isEmpty() || desktopFileId.contains(QLatin1Char('\n')))
+        return;
+
+    DesktopFileUsageRecord record;
+    record.type = DesktopFileUsageRecord::Forget;
+    record.desktopFileId = desktopFileId;
+    d->record(record);
+}
+
+int DesktopFileUsage::launchCount(const QString &desktopFileId) const
+{
+    Q_D(const DesktopFileUsage);
+    QMutexLocker locker(&d->mutex);
+    const DesktopFileUsageEntry *entry = d->table.find(desktopFileId);
+    return entry ? entry->count : 0;
+}
+
+QDateTime DesktopFileUsage::lastLaunched(const QString &desktopFileId) const
+{
+    Q_D(const DesktopFileUsage);
+    QMutexLocker locker(&d->mutex);
+    const DesktopFileUsageEntry *entry = d->table.find(desktopFileId);
+    return entry ? QDateTime::fromMSecsSinceEpoch(entry->lastLaunched) : QDateTime();
+}
+
+qreal DesktopFileUsage::frecency(const QString &desktopFileId) const
+{
+    Q_D(const DesktopFileUsage);
+    QMutexLocker locker(&d->mutex);
+    const DesktopFileUsageEntry *entry = d->table.find(desktopFileId);
+    return entry ? DesktopFileUsageTable::frecency(*entry, QDateTime::currentMSecsSinceEpoch()) : 0;
+}
+
+QStringList DesktopFileUsage::mostUsed(int count) const
+{
+    Q_D(const DesktopFileUsage);
+    QMutexLocker locker(&d->mutex);
+    return d->table.mostUsed(count);
+}
+
+QStringList DesktopFileUsage::recentlyUsed(int count) const
+{
+    Q_D(const DesktopFileUsage);
+    QMutexLocker locker(&d->mutex);
+    return d->table.recentlyUsed(count);
+}
+
+void DesktopFileUsage::flush()
+{
+    Q_D(DesktopFileUsage);
+    d->scheduleWrite();
+    d->writePool.waitForDone();
+}
+
+} // namespace Liri
@@ -0,0 +1,67 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPFILEUSAGE_H
+#define LIRI_DESKTOPFILEUSAGE_H
+
+#include <QDateTime>
+#include <QObject>
+#include <QStringList>
+
+#include <LiriXdg/lirixdgglobal.h>
+
+namespace Liri {
+
+class DesktopFileUsagePrivate;
+
+/*!
+ * Persistent record of the applications launched by the user, ranked by
+ * frecency: every launch counts as one and loses half of its weight each
+ * week, so that both frequent and recent applications come first.
+ *
+ * Launches are appended to a log in the background, in batches, and the log
+ * is compacted once it grows well beyond the number of applications.
+ * DesktopFile::startDetached() records launches in the default store.
+ */
+class LIRIXDG_EXPORT DesktopFileUsage : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(DesktopFileUsage)
+public:
+    explicit DesktopFileUsage(const QString &fileName, QObject *parent = nullptr);
+    ~DesktopFileUsage();
+
+    //! Store saved in $XDG_DATA_HOME/liri/desktop-usage.log
+    static DesktopFileUsage *instance();
+
+    QString fileName() const;
+
+    void recordLaunch(const QString &desktopFileId,
+                      const QDateTime &time = QDateTime::currentDateTimeUtc());
+    void forget(const QString &desktopFileId);
+
+    int launchCount(const QString &desktopFileId) const;
+    QDateTime lastLaunched(const QString &desktopFileId) const;
+
+    //! Number of launches, each weighted by how long ago it happened
+    qreal frecency(const QString &desktopFileId) const;
+
+    //! Desktop file ids with the highest frecency first, at most count of them
+    QStringList mostUsed(int count) const;
+    //! Desktop file ids launched most recently first, at most count of them
+    QStringList recentlyUsed(int count) const;
+
+    //! Writes the pending launches and waits for the log to be written
+    void flush();
+
+Q_SIGNALS:
+    void usageChanged(const QString &desktopFileId);
+
+private:
+    DesktopFileUsagePrivate *const d_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPFILEUSAGE_H
@@ -0,0 +1,141 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPFILEUSAGE_P_H
+#define LIRI_DESKTOPFILEUSAGE_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+#include <map>
+
+#include "desktopfileusage.h"
+
+// Launches recorded within this time are written in one go
+#define USAGE_FLUSH_DELAY 2000
+// A launch counts half after this many milliseconds
+#define USAGE_HALF_LIFE (7 * 24 * 3600 * 1000.0)
+// The log is compacted once it has this many lines more than entries
+#define USAGE_COMPACT_SLACK 256
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+struct DesktopFileUsageEntry {
+    int count = 0;
+    qint64 lastLaunched = 0;
+    // log2 of the sum of 2^(t / half life) over the launch times t, the
+    // entries keep the same order as time goes by so it's never updated
+    double score = 0;
+};
+
+/*
+ * One line of the log:
+ *   "+<time> <id>" is a launch,
+ *   "-<id>" forgets the entry,
+ *   "=<count> <last launched> <score> <id>" is a compacted entry.
+ */
+struct DesktopFileUsageRecord {
+    enum Type {
+        Launch = '+',
+        Forget = '-',
+        Entry = '=',
+    };
+
+    Type type;
+    QString desktopFileId;
+    DesktopFileUsageEntry entry;
+
+    QByteArray toLine() const;
+    static bool fromLine(const QByteArray &line, DesktopFileUsageRecord *record);
+};
+
+/*
+ * Entries by desktop file id, also kept sorted by score and by time of
+ * the last launch so that the top k of either ranking costs O(k).
+ */
+class DesktopFileUsageTable
+{
+public:
+    DesktopFileUsageTable() = default;
+    DesktopFileUsageTable(DesktopFileUsageTable &&other) = default;
+    DesktopFileUsageTable &operator=(DesktopFileUsageTable &&other) = default;
+
+    void apply(const DesktopFileUsageRecord &record);
+    void load(const QByteArray &data, int *lines = nullptr);
+    QByteArray save(qint64 now) const;
+
+    int count() const { return mNodes.count(); }
+    const DesktopFileUsageEntry *find(const QString &desktopFileId) const;
+
+    QStringList mostUsed(int count) const;
+    QStringList recentlyUsed(int count) const;
+
+    static qreal frecency(const DesktopFileUsageEntry &entry, qint64 now);
+
+private:
+    Q_DISABLE_COPY(DesktopFileUsageTable)
+
+    typedef std::multimap<double, QString, std::greater<double>> ScoreMap;
+    typedef std::multimap<qint64, QString, std::greater<qint64>> TimeMap;
+
+    struct Node {
+        DesktopFileUsageEntry entry;
+        ScoreMap::iterator byScore;
+        TimeMap::iterator byTime;
+    };
+
+    void set(const QString &desktopFileId, const DesktopFileUsageEntry &entry);
+    void remove(const QString &desktopFileId);
+
+    QHash<QString, Node> mNodes;
+    ScoreMap mByScore;
+    TimeMap mByTime;
+};
+
+class DesktopFileUsagePrivate
+{
+    Q_DECLARE_PUBLIC(DesktopFileUsage)
+public:
+    explicit DesktopFileUsagePrivate(DesktopFileUsage *self);
+
+    void record(const DesktopFileUsageRecord &record);
+    void startFlushTimer();
+    void scheduleWrite();
+    void write();
+
+    QString fileName;
+
+    // Held for the table and the pending records, which are accessed
+    // from any thread and by the writer
+    mutable QMutex mutex;
+    DesktopFileUsageTable table;
+    QVector<DesktopFileUsageRecord> pending;
+    int logLines = 0;
+
+    // Child of the store so that it follows it to its thread
+    QTimer *flushTimer = nullptr;
+    QThreadPool writePool;
+
+protected:
+    DesktopFileUsage *q_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPFILEUSAGE_P_H
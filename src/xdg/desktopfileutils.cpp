@@ -9,25 +9,76 @@
 #include <QRegularExpression>
 #include <QUrl>
 
+#include <initializer_list>
+#include <utility>
+
 #include "desktopfileutils_p.h"
 #include "xdgdirs_p_p.h"
 
-QString &doEscape(QString &str, const QHash<QChar, QChar> &repl)
+namespace {
+
+/*
+ * Maps the ASCII characters to escape, or following a backslash in an
+ * escape sequence, to their replacement; 0 when there is none.
+ */
+struct EscapeTable
 {
-    // First we replace slash.
-    str.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    constexpr EscapeTable(std::initializer_list<std::pair<char16_t, char16_t>> entries)
+    {
+        for (const auto &entry : entries)
+            map[entry.first] = entry.second;
+    }
+
+    char16_t lookup(QChar c) const
+    {
+        return c.unicode() < 128 ? map[c.unicode()] : 0;
+    }
+
+    char16_t map[128] = {};
+};
 
-    QHash<QChar, QChar>::const_iterator i = repl.constBegin();
-    while (i != repl.constEnd()) {
-        if (i.key() != QLatin1Char('\\'))
-            str.replace(i.key(), QStringLiteral("\\\\%1").arg(i.value()));
+} // anonymous namespace
 
-        ++i;
+/************************************************
+ The characters of the table are replaced by a backslash and their
+ replacement. The string is copied only once and only if there is
+ something to escape.
+ ************************************************/
+static QString &doEscape(QString &str, const EscapeTable &table)
+{
+    const QChar *data = str.constData();
+    const qsizetype size = str.size();
+
+    QString result;
+    qsizetype copied = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        const char16_t replacement = table.lookup(data[i]);
+        if (!replacement)
+            continue;
+
+        if (copied == 0)
+            result.reserve(size + 16);
+        result.append(data + copied, i - copied);
+        result.append(QLatin1Char('\\'));
+        result.append(QChar(replacement));
+        copied = i + 1;
     }
 
+    if (copied == 0)
+        return str;
+
+    result.append(data + copied, size - copied);
+    str = std::move(result);
     return str;
 }
 
+static constexpr EscapeTable escapeTable = {
+    { u'\\', u'\\' },
+    { u'\n', u'n' },
+    { u'\t', u't' },
+    { u'\r', u'r' },
+};
+
 /************************************************
  The escape sequences \s, \n, \t, \r, and \\ are supported for values
  of type string and localestring, meaning ASCII space, newline, tab,
@@ -35,14 +86,17 @@ QString &doEscape(QString &str, const QHash<QChar, QChar> &repl)
  ************************************************/
 QString &escape(QString &str)
 {
-    QHash<QChar, QChar> repl;
-    repl.insert(QLatin1Char('\n'), QLatin1Char('n'));
-    repl.insert(QLatin1Char('\t'), QLatin1Char('t'));
-    repl.insert(QLatin1Char('\r'), QLatin1Char('r'));
-
-    return doEscape(str, repl);
+    return doEscape(str, escapeTable);
 }
 
+static constexpr EscapeTable escapeExecTable = {
+    { u'"', u'"' }, // double quote,
+    { u'\'', u'\'' }, // single quote ("'"),
+    { u'\\', u'\\' }, // backslash character ("\"),
+    { u'$', u'$' }, // dollar sign ("$"),
+    { u'`', u'`' }, // backtick character ("`").
+};
+
 /************************************************
  Quoting must be done by enclosing the argument between double quotes and
  escaping the
@@ -64,36 +118,60 @@ is unambiguously represented with ("\\$").
  ************************************************/
 QString &escapeExec(QString &str)
 {
-    QHash<QChar, QChar> repl;
-    // The parseCombinedArgString() splits the string by the space symbols,
-    // we temporarily replace them on the special characters.
-    // Replacement will reverse after the splitting.
-    repl.insert(QLatin1Char('"'), QLatin1Char('"')); // double quote,
-    repl.insert(QLatin1Char('\''), QLatin1Char('\'')); // single quote ("'"),
-    repl.insert(QLatin1Char('\\'), QLatin1Char('\\')); // backslash character ("\"),
-    repl.insert(QLatin1Char('$'), QLatin1Char('$')); // dollar sign ("$"),
-
-    return doEscape(str, repl);
+    // Quoting is undone after the string escapes, so it comes first
+    doEscape(str, escapeExecTable);
+    return escape(str);
 }
 
-QString &doUnEscape(QString &str, const QHash<QChar, QChar> &repl)
+/************************************************
+ Replaces the escape sequences of the table in a single pass. Most
+ values have no backslash at all: QString::indexOf() finds that out
+ with a vectorized search, and the string is returned untouched.
+ ************************************************/
+static QString &doUnEscape(QString &str, const EscapeTable &table)
 {
-    int n = 0;
-    while (1) {
-        n = str.indexOf(QLatin1String("\\"), n);
-        if (n < 0 || n > str.length() - 2)
-            break;
-
-        if (repl.contains(str.at(n + 1))) {
-            str.replace(n, 2, repl.value(str.at(n + 1)));
+    const QLatin1Char backslash('\\');
+
+    qsizetype n = str.indexOf(backslash);
+    if (n < 0)
+        return str;
+
+    const QChar *data = str.constData();
+    const qsizetype size = str.size();
+
+    QString result;
+    qsizetype copied = 0;
+    while (n >= 0 && n < size - 1) {
+        const char16_t replacement = table.lookup(data[n + 1]);
+        if (!replacement) {
+            n = str.indexOf(backslash, n + 1);
+            continue;
         }
 
-        n++;
+        if (copied == 0)
+            result.reserve(size);
+        result.append(data + copied, n - copied);
+        result.append(QChar(replacement));
+        copied = n + 2;
+        n = str.indexOf(backslash, copied);
     }
 
+    if (copied == 0)
+        return str;
+
+    result.append(data + copied, size - copied);
+    str = std::move(result);
     return str;
 }
 
+static constexpr EscapeTable unEscapeTable = {
+    { u'\\', u'\\' },
+    { u's', u' ' },
+    { u'n', u'\n' },
+    { u't', u'\t' },
+    { u'r', u'\r' },
+};
+
 /************************************************
  The escape sequences \s, \n, \t, \r, and \\ are supported for values
  of type string and localestring, meaning ASCII space, newline, tab,
@@ -101,16 +179,35 @@ QString &doUnEscape(QString &str, const QHash<QChar, QChar> &repl)
  ************************************************/
 QString &unEscape(QString &str)
 {
-    QHash<QChar, QChar> repl;
-    repl.insert(QLatin1Char('\\'), QLatin1Char('\\'));
-    repl.insert(QLatin1Char('s'), QLatin1Char(' '));
-    repl.insert(QLatin1Char('n'), QLatin1Char('\n'));
-    repl.insert(QLatin1Char('t'), QLatin1Char('\t'));
-    repl.insert(QLatin1Char('r'), QLatin1Char('\r'));
-
-    return doUnEscape(str, repl);
+    return doUnEscape(str, unEscapeTable);
 }
 
+static constexpr EscapeTable unEscapeExecTable = {
+    // The parseCombinedArgString() splits the string by the space symbols,
+    // we temporarily replace them on the special characters.
+    // Replacement will reverse after the splitting.
+    { u' ', 01 }, // space
+    { u'\t', 02 }, // tab
+    { u'\n', 03 }, // newline,
+
+    { u'"', u'"' }, // double quote,
+    { u'\'', u'\'' }, // single quote ("'"),
+    { u'\\', u'\\' }, // backslash character ("\"),
+    { u'>', u'>' }, // greater-than sign (">"),
+    { u'<', u'<' }, // less-than sign ("<"),
+    { u'~', u'~' }, // tilde ("~"),
+    { u'|', u'|' }, // vertical bar ("|"),
+    { u'&', u'&' }, // ampersand ("&"),
+    { u';', u';' }, // semicolon (";"),
+    { u'$', u'$' }, // dollar sign ("$"),
+    { u'*', u'*' }, // asterisk ("*"),
+    { u'?', u'?' }, // question mark ("?"),
+    { u'#', u'#' }, // hash mark ("#"),
+    { u'(', u'(' }, // parenthesis ("(")
+    { u')', u')' }, // parenthesis (")")
+    { u'`', u'`' }, // backtick character ("`").
+};
+
 /************************************************
  Quoting must be done by enclosing the argument between double quotes and
  escaping the
@@ -153,32 +250,7 @@ is unambiguously represented with ("\\$").
 QString &unEscapeExec(QString &str)
 {
     unEscape(str);
-    QHash<QChar, QChar> repl;
-    // The parseCombinedArgString() splits the string by the space symbols,
-    // we temporarily replace them on the special characters.
-    // Replacement will reverse after the splitting.
-    repl.insert(QLatin1Char(' '), QChar(01)); // space
-    repl.insert(QLatin1Char('\t'), QChar(02)); // tab
-    repl.insert(QLatin1Char('\n'), QChar(03)); // newline,
-
-    repl.insert(QLatin1Char('"'), QLatin1Char('"')); // double quote,
-    repl.insert(QLatin1Char('\''), QLatin1Char('\'')); // single quote ("'"),
-    repl.insert(QLatin1Char('\\'), QLatin1Char('\\')); // backslash character ("\"),
-    repl.insert(QLatin1Char('>'), QLatin1Char('>')); // greater-than sign (">"),
-    repl.insert(QLatin1Char('<'), QLatin1Char('<')); // less-than sign ("<"),
-    repl.insert(QLatin1Char('~'), QLatin1Char('~')); // tilde ("~"),
-    repl.insert(QLatin1Char('|'), QLatin1Char('|')); // vertical bar ("|"),
-    repl.insert(QLatin1Char('&'), QLatin1Char('&')); // ampersand ("&"),
-    repl.insert(QLatin1Char(';'), QLatin1Char(';')); // semicolon (";"),
-    repl.insert(QLatin1Char('$'), QLatin1Char('$')); // dollar sign ("$"),
-    repl.insert(QLatin1Char('*'), QLatin1Char('*')); // asterisk ("*"),
-    repl.insert(QLatin1Char('?'), QLatin1Char('?')); // question mark ("?"),
-    repl.insert(QLatin1Char('#'), QLatin1Char('#')); // hash mark ("#"),
-    repl.insert(QLatin1Char('('), QLatin1Char('(')); // parenthesis ("(")
-    repl.insert(QLatin1Char(')'), QLatin1Char(')')); // parenthesis (")")
-    repl.insert(QLatin1Char('`'), QLatin1Char('`')); // backtick character ("`").
-
-    return doUnEscape(str, repl);
+    return doUnEscape(str, unEscapeExecTable);
 }
 
 QString findDesktopFile(const QString &dirName, const QString &desktopName)
@@ -316,3 +388,35 @@ QStringList expandEnvVariables(const QStringList &strs)
 
     return res;
 }
+
+/*
+ * Size of the heap block of a string, the QString itself is accounted
+ * for by its owner. Implicitly shared copies are counted each time.
+ */
+qint64 stringMemoryUsage(const QString &str)
+{
+    if (str.capacity() == 0)
+        return 0;
+    return qint64(sizeof(QArrayData)) + qint64(str.capacity() + 1) * qint64(sizeof(QChar));
+}
+
+/*
+ * Heap usage of the values of desktop entries, strings and string lists,
+ * which fit in the QVariant itself.
+ */
+qint64 variantMemoryUsage(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::QString:
+        return stringMemoryUsage(*static_cast<const QString *>(value.constData()));
+    case QMetaType::QStringList: {
+        const QStringList &list = *static_cast<const QStringList *>(value.constData());
+        qint64 bytes = listMemoryUsage(list);
+        for (const QString &str : list)
+            bytes += stringMemoryUsage(str);
+        return bytes;
+    }
+    default:
+        return 0;
+    }
+}
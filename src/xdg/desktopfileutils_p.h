@@ -6,12 +6,15 @@
 #ifndef DESKTOPFILEUTILS_P_H
 #define DESKTOPFILEUTILS_P_H
 
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QSet>
 #include <QString>
+#include <QVariant>
 
-QString &doEscape(QString &str, const QHash<QChar, QChar> &repl);
 QString &escape(QString &str);
 QString &escapeExec(QString &str);
-QString &doUnEscape(QString &str, const QHash<QChar, QChar> &repl);
 QString &unEscape(QString &str);
 QString &unEscapeExec(QString &str);
 QString findDesktopFile(const QString &dirName, const QString &desktopName);
@@ -25,4 +28,40 @@ void replaceVar(QString &str, const QString &varName, const QString &after);
 QString expandEnvVariables(const QString &str);
 QStringList expandEnvVariables(const QStringList &strs);
 
+qint64 stringMemoryUsage(const QString &str);
+qint64 variantMemoryUsage(const QVariant &value);
+
+/*
+ * Estimated heap usage of the Qt 6 containers themselves: what their
+ * keys and values point to is not included.
+ */
+
+template <typename Key, typename T>
+inline qint64 mapMemoryUsage(const QMap<Key, T> &map)
+{
+    // Red-black tree nodes: color, parent and children
+    return qint64(map.size()) * qint64(4 * sizeof(void *) + sizeof(Key) + sizeof(T));
+}
+
+template <typename Key, typename T>
+inline qint64 hashMemoryUsage(const QHash<Key, T> &hash)
+{
+    // One offset byte per bucket, the nodes are stored in the spans
+    return qint64(hash.capacity()) + qint64(hash.size()) * qint64(sizeof(Key) + sizeof(T));
+}
+
+template <typename T>
+inline qint64 setMemoryUsage(const QSet<T> &set)
+{
+    return qint64(set.capacity()) + qint64(set.size()) * qint64(sizeof(T));
+}
+
+template <typename T>
+inline qint64 listMemoryUsage(const QList<T> &list)
+{
+    if (list.capacity() == 0)
+        return 0;
+    return qint64(sizeof(QArrayData)) + qint64(list.capacity()) * qint64(sizeof(T));
+}
+
 #endif // DESKTOPFILEUTILS_P_H
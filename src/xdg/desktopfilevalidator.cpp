@@ -0,0 +1,255 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "desktopfilevalidator_p.h"
+
+namespace Liri {
+
+static const QString desktopEntryGroup = QStringLiteral("Desktop Entry");
+static const QString actionGroupPrefix = QStringLiteral("Desktop Action ");
+
+// Keys of the "Desktop Entry Specification" 1.5
+static const char *const registeredKeys[] = {
+    "Type", "Version", "Name", "GenericName", "NoDisplay", "Comment", "Icon",
+    "Hidden", "OnlyShowIn", "NotShowIn", "DBusActivatable", "TryExec", "Exec",
+    "Path", "Terminal", "Actions", "MimeType", "Categories", "Implements",
+    "Keywords", "StartupNotify", "StartupWMClass", "URL", "PrefersNonDefaultGPU",
+    "SingleMainWindow",
+};
+
+static const char *const deprecatedKeys[] = {
+    "Encoding", "MiniIcon", "TerminalOptions", "Protocols", "Extensions",
+    "BinaryPattern", "MapNotify", "SwallowTitle", "SwallowExec", "SortOrder",
+    "FilePattern",
+};
+
+static const char *const actionKeys[] = { "Name", "Icon", "Exec" };
+
+static const char *const booleanKeys[] = {
+    "NoDisplay", "Hidden", "DBusActivatable", "Terminal", "StartupNotify",
+    "PrefersNonDefaultGPU", "SingleMainWindow",
+};
+
+template <size_t N>
+static bool contains(const char *const (&keys)[N], QStringView key)
+{
+    for (const char *k : keys) {
+        if (key == QLatin1String(k))
+            return true;
+    }
+    return false;
+}
+
+// Column of the first character that is not a space
+static int firstColumn(const QString &rawLine)
+{
+    int column = 0;
+    while (column < rawLine.size() && rawLine.at(column).isSpace())
+        ++column;
+    return column + 1;
+}
+
+// Only A-Za-z0-9- are allowed in key names
+static bool isValidKeyName(QStringView key)
+{
+    if (key.isEmpty())
+        return false;
+
+    for (const QChar c : key) {
+        const char16_t u = c.unicode();
+        if (!((u >= 'A' && u <= 'Z') || (u >= 'a' && u <= 'z') || (u >= '0' && u <= '9') || u == '-'))
+            return false;
+    }
+    return true;
+}
+
+// Printable ASCII characters except brackets are allowed in group names
+static bool isValidGroupName(QStringView group)
+{
+    if (group.isEmpty())
+        return false;
+
+    for (const QChar c : group) {
+        const char16_t u = c.unicode();
+        if (u < 0x20 || u > 0x7e || u == '[' || u == ']')
+            return false;
+    }
+    return true;
+}
+
+void DesktopFileValidator::groupRead(int line, const QString &rawLine, const QString &group)
+{
+    const int column = firstColumn(rawLine);
+
+    if (mFirstGroup.isNull()) {
+        mFirstGroup = group;
+        if (group != desktopEntryGroup)
+            add(line, column, DesktopFileDiagnostic::ErrorSeverity, "first-group",
+                QStringLiteral("First group must be \"%1\", not \"%2\"").arg(desktopEntryGroup, group));
+    }
+
+    if (!isValidGroupName(group))
+        add(line, column, DesktopFileDiagnostic::ErrorSeverity, "invalid-group-name",
+            QStringLiteral("Group name \"%1\" contains invalid characters").arg(group));
+
+    auto it = mGroupLines.constFind(group);
+    if (it != mGroupLines.constEnd()) {
+        add(line, column, DesktopFileDiagnostic::ErrorSeverity, "duplicate-group",
+            QStringLiteral("Group \"%1\" is already defined on line %2").arg(group).arg(it.value()));
+        return;
+    }
+    mGroupLines.insert(group, line);
+
+    if (group != desktopEntryGroup && !group.startsWith(actionGroupPrefix) && !group.startsWith(QLatin1String("X-")))
+        add(line, column, DesktopFileDiagnostic::ErrorSeverity, "unknown-group",
+            QStringLiteral("Group \"%1\" is not registered, custom groups start with \"X-\"").arg(group));
+}
+
+void DesktopFileValidator::keyRead(int line, const QString &rawLine, const QString &group, const QString &key)
+{
+    const int column = firstColumn(rawLine);
+
+    // Split Name[de] into its key and locale
+    QStringView name = key;
+    if (key.endsWith(QLatin1Char(']'))) {
+        const qsizetype open = key.indexOf(QLatin1Char('['));
+        if (open > 0) {
+            name = QStringView(key).left(open);
+            if (open + 2 == key.size())
+                add(line, column, DesktopFileDiagnostic::ErrorSeverity, "invalid-locale",
+                    QStringLiteral("Key \"%1\" has an empty locale").arg(key));
+        }
+    }
+
+    if (!isValidKeyName(name)) {
+        add(line, column, DesktopFileDiagnostic::ErrorSeverity, "invalid-key-name",
+            QStringLiteral("Key \"%1\" contains invalid characters").arg(key));
+        return;
+    }
+
+    const QString path = group + QLatin1Char('/') + key;
+    auto it = mKeyLines.constFind(path);
+    if (it != mKeyLines.constEnd()) {
+        add(line, column, DesktopFileDiagnostic::ErrorSeverity, "duplicate-key",
+            QStringLiteral("Key \"%1\" of group \"%2\" is already defined on line %3").arg(key, group).arg(it.value()));
+        return;
+    }
+    mKeyLines.insert(path, line);
+
+    if (name.startsWith(QLatin1String("X-")))
+        return;
+
+    if (group == desktopEntryGroup) {
+        if (contains(deprecatedKeys, name))
+            add(line, column, DesktopFileDiagnostic::WarningSeverity, "deprecated-key",
+                QStringLiteral("Key \"%1\" is deprecated").arg(name));
+        else if (!contains(registeredKeys, name))
+            add(line, column, DesktopFileDiagnostic::ErrorSeverity, "unknown-key",
+                QStringLiteral("Key \"%1\" is not registered, custom keys start with \"X-\"").arg(name));
+    } else if (group.startsWith(actionGroupPrefix)) {
+        if (!contains(actionKeys, name))
+            add(line, column, DesktopFileDiagnostic::ErrorSeverity, "unknown-key",
+                QStringLiteral("Key \"%1\" is not allowed in action groups").arg(name));
+    }
+}
+
+void DesktopFileValidator::invalidLine(int line, const QString &rawLine)
+{
+    add(line, firstColumn(rawLine), DesktopFileDiagnostic::ErrorSeverity, "invalid-line",
+        QStringLiteral("Line is not a group header, a key-value pair or a comment"));
+}
+
+void DesktopFileValidator::strayKey(int line, const QString &rawLine)
+{
+    add(line, firstColumn(rawLine), DesktopFileDiagnostic::ErrorSeverity, "key-outside-group",
+        QStringLiteral("Key-value pair before the first group"));
+}
+
+/*
+ * Checks the keys that are required, or whose values are restricted.
+ */
+void DesktopFileValidator::finish(const QMap<QString, QVariant> &items)
+{
+    const int groupLine = mGroupLines.value(desktopEntryGroup);
+    if (groupLine == 0) {
+        add(0, 0, DesktopFileDiagnostic::ErrorSeverity, "missing-group",
+            QStringLiteral("Required group \"%1\" is missing").arg(desktopEntryGroup));
+        return;
+    }
+
+    const QString prefix = desktopEntryGroup + QLatin1Char('/');
+    const auto requireKey = [&](const QString &group, int line, const char *key) {
+        if (!items.contains(group + QLatin1Char('/') + QLatin1String(key)))
+            add(line, 0, DesktopFileDiagnostic::ErrorSeverity, "missing-key",
+                QStringLiteral("Required key \"%1\" is missing from group \"%2\"").arg(QLatin1String(key), group));
+    };
+
+    requireKey(desktopEntryGroup, groupLine, "Type");
+    requireKey(desktopEntryGroup, groupLine, "Name");
+
+    const QString typePath = prefix + QStringLiteral("Type");
+    const QString type = items.value(typePath).toString();
+    if (type == QLatin1String("Application")) {
+        if (items.value(prefix + QStringLiteral("DBusActivatable")).toString() != QLatin1String("true"))
+            requireKey(desktopEntryGroup, groupLine, "Exec");
+    } else if (type == QLatin1String("Link")) {
+        requireKey(desktopEntryGroup, groupLine, "URL");
+    } else if (items.contains(typePath) && type != QLatin1String("Directory")) {
+        add(keyLine(typePath), 0, DesktopFileDiagnostic::ErrorSeverity, "invalid-value",
+            QStringLiteral("Value \"%1\" of key \"Type\" is not Application, Link or Directory").arg(type));
+    }
+
+    for (const char *key : booleanKeys)
+        checkBoolean(items, prefix + QLatin1String(key));
+
+    const QStringList actions = items.value(prefix + QStringLiteral("Actions")).toStringList();
+    for (const QString &action : actions) {
+        const QString group = actionGroupPrefix + action;
+        const int line = mGroupLines.value(group);
+        if (line == 0) {
+            add(keyLine(prefix + QStringLiteral("Actions")), 0, DesktopFileDiagnostic::ErrorSeverity, "missing-group",
+                QStringLiteral("Group \"%1\" of action \"%2\" is missing").arg(group, action));
+            continue;
+        }
+        requireKey(group, line, "Name");
+    }
+}
+
+void DesktopFileValidator::add(int line, int column, DesktopFileDiagnostic::Severity severity,
+                               const char *code, const QString &message)
+{
+    DesktopFileDiagnostic diagnostic;
+    diagnostic.line = line;
+    diagnostic.column = column;
+    diagnostic.severity = severity;
+    diagnostic.code = QLatin1String(code);
+    diagnostic.message = message;
+    diagnostics.append(diagnostic);
+}
+
+int DesktopFileValidator::keyLine(const QString &path) const
+{
+    return mKeyLines.value(path);
+}
+
+void DesktopFileValidator::checkBoolean(const QMap<QString, QVariant> &items, const QString &path)
+{
+    auto it = items.constFind(path);
+    if (it == items.constEnd())
+        return;
+
+    const QString key = path.section(QLatin1Char('/'), 1);
+    const QString value = it.value().toString();
+    if (value == QLatin1String("true") || value == QLatin1String("false"))
+        return;
+
+    if (value == QLatin1String("0") || value == QLatin1String("1"))
+        add(keyLine(path), 0, DesktopFileDiagnostic::WarningSeverity, "deprecated-value",
+            QStringLiteral("Value \"%1\" of boolean key \"%2\" is deprecated, use \"true\" or \"false\"").arg(value, key));
+    else
+        add(keyLine(path), 0, DesktopFileDiagnostic::ErrorSeverity, "invalid-value",
+            QStringLiteral("Value \"%1\" of boolean key \"%2\" is not \"true\" or \"false\"").arg(value, key));
+}
+
+} // namespace Liri
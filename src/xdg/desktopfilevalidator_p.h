@@ -0,0 +1,62 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPFILEVALIDATOR_P_H
+#define LIRI_DESKTOPFILEVALIDATOR_P_H
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QVariant>
+
+#include "desktopfile.h"
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+/*
+ * Collects the diagnostics of a desktop entry while it's parsed, then
+ * checks the keys against the "Desktop Entry Specification" like
+ * desktop-file-validate does.
+ *
+ * The parser reports to it only when it's given one, which is what
+ * DesktopFile::validate() does, so loading files doesn't pay for it.
+ */
+class DesktopFileValidator
+{
+public:
+    void groupRead(int line, const QString &rawLine, const QString &group);
+    void keyRead(int line, const QString &rawLine, const QString &group, const QString &key);
+    void invalidLine(int line, const QString &rawLine);
+    void strayKey(int line, const QString &rawLine);
+
+    void finish(const QMap<QString, QVariant> &items);
+
+    void add(int line, int column, DesktopFileDiagnostic::Severity severity,
+             const char *code, const QString &message);
+
+    QList<DesktopFileDiagnostic> diagnostics;
+
+private:
+    int keyLine(const QString &path) const;
+    void checkBoolean(const QMap<QString, QVariant> &items, const QString &path);
+
+    QString mFirstGroup;
+    QHash<QString, int> mGroupLines;
+    QHash<QString, int> mKeyLines;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPFILEVALIDATOR_P_H
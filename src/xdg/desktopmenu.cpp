@@ -13,7 +13,15 @@
 #include <QLocale>
 #include <QTranslator>
 #include <QCoreApplication>
-#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 #include "desktopmenu_p.h"
 #include "xdgdirs_p_p.h"
@@ -28,7 +36,6 @@ namespace Liri {
 
 // Helper functions prototypes
 void installTranslation(const QString &name);
-bool isParent(const QDomElement &parent, const QDomElement &child);
 
 DesktopMenu::DesktopMenu(QObject *parent)
     : QObject(parent)
@@ -54,6 +61,14 @@ DesktopMenuPrivate::DesktopMenuPrivate(DesktopMenu *parent)
     connect(&mWatcher, SIGNAL(directoryChanged(QString)), &mRebuildDelayTimer, SLOT(start()));
 
     connect(this, SIGNAL(changed()), q_ptr, SIGNAL(changed()));
+
+    mBuildPool.setMaxThreadCount(1);
+}
+
+DesktopMenuPrivate::~DesktopMenuPrivate()
+{
+    mGeneration->ref();
+    clearLazyState();
 }
 
 const QString DesktopMenu::logDir() const
@@ -97,65 +112,96 @@ void DesktopMenu::setEnvironments(const QString &env)
     setEnvironments(QStringList() << env);
 }
 
-const QString DesktopMenu::errorString() const
+QStringList DesktopMenu::previewEnvironments() const
 {
     Q_D(const DesktopMenu);
-    return d->mErrorString;
+    return d->mPreviewEnvironments;
 }
 
-bool DesktopMenu::read(const QString &menuFileName)
+void DesktopMenu::setPreviewEnvironments(const QStringList &envs)
 {
     Q_D(DesktopMenu);
+    d->mPreviewEnvironments = envs;
+}
 
-    d->mMenuFileName = menuFileName;
-
-    d->clearWatcher();
+bool DesktopMenu::isVisibleIn(const QDomElement &element, int environment)
+{
+    if (!element.hasAttribute(QStringLiteral("visibleIn")))
+        return true;
 
-    XdgMenuReader reader(this);
-    if (!reader.load(d->mMenuFileName)) {
-        qCWarning(lcXdg) << reader.errorString();
-        d->mErrorString = reader.errorString();
+    if (environment < 0 || environment >= 64)
         return false;
-    }
 
-    d->mXml = reader.xml();
-    QDomElement root = d->mXml.documentElement();
-    d->saveLog(QStringLiteral("00-reader.xml"));
+    const quint64 mask = element.attribute(QStringLiteral("visibleIn")).toULongLong();
+    return mask & (quint64(1) << environment);
+}
 
-    d->simplify(root);
-    d->saveLog(QStringLiteral("01-simplify.xml"));
+bool DesktopMenu::isLazy() const
+{
+    Q_D(const DesktopMenu);
+    return d->mLazy;
+}
 
-    d->mergeMenus(root);
-    d->saveLog(QStringLiteral("02-mergeMenus.xml"));
+void DesktopMenu::setLazy(bool lazy)
+{
+    Q_D(DesktopMenu);
+    d->mLazy = lazy;
+}
 
-    d->moveMenus(root);
-    d->saveLog(QStringLiteral("03-moveMenus.xml"));
+QDomElement DesktopMenu::menu(const QString &path)
+{
+    Q_D(DesktopMenu);
 
-    d->mergeMenus(root);
-    d->saveLog(QStringLiteral("04-mergeMenus.xml"));
+    QDomElement element = d->mXml.documentElement();
+    d->materialize(element);
+    const QStringList names = (path.startsWith(QLatin1Char('/')) ? path.section(QLatin1Char('/'), 2) : path)
+            .split(QLatin1Char('/'), Qt::SkipEmptyParts);
 
-    d->deleteDeletedMenus(root);
-    d->saveLog(QStringLiteral("05-deleteDeletedMenus.xml"));
+    for (const QString &name : names) {
+        QDomElement found;
+        DomElementIterator it(element, QStringLiteral("Menu"));
+        while (it.hasNext() && found.isNull()) {
+            QDomElement n = it.next();
+            if (n.attribute(QStringLiteral("name")) == name)
+                found = n;
+        }
+        if (found.isNull())
+            return QDomElement();
+        element = d->materialize(found);
+        if (element.isNull())
+            return QDomElement();
+    }
 
-    d->processDirectoryEntries(root, QStringList());
-    d->saveLog(QStringLiteral("06-processDirectoryEntries.xml"));
+    return element;
+}
 
-    d->processApps(root);
-    d->saveLog(QStringLiteral("07-processApps.xml"));
+const QString DesktopMenu::errorString() const
+{
+    Q_D(const DesktopMenu);
+    return d->mErrorString;
+}
 
-    d->processLayouts(root);
-    d->saveLog(QStringLiteral("08-processLayouts.xml"));
+bool DesktopMenu::read(const QString &menuFileName)
+{
+    Q_D(DesktopMenu);
 
-    d->deleteEmpty(root);
-    d->saveLog(QStringLiteral("09-deleteEmpty.xml"));
+    const bool success = d->read(menuFileName);
+    Q_EMIT readFinished(success);
+    return success;
+}
 
-    d->fixSeparators(root);
-    d->saveLog(QStringLiteral("10-fixSeparators.xml"));
+void DesktopMenu::readAsync(const QString &menuFileName)
+{
+    Q_D(DesktopMenu);
 
-    d->mOutDated = false;
-    d->mHash = QCryptographicHash::hash(d->mXml.toByteArray(), QCryptographicHash::Md5);
+    d->mMenuFileName = menuFileName;
+    d->startBuild(true);
+}
 
-    return true;
+bool DesktopMenu::isReading() const
+{
+    Q_D(const DesktopMenu);
+    return d->mReading;
 }
 
 void DesktopMenu::save(const QString &fileName)
@@ -175,6 +221,432 @@ void DesktopMenu::save(const QString &fileName)
     file.close();
 }
 
+bool DesktopMenuPrivate::read(const QString &menuFileName)
+{
+    mMenuFileName = menuFileName;
+
+    // Supersede any build still running
+    mGeneration->ref();
+    mReading = false;
+
+    const bool success = build();
+    watch();
+    if (!success)
+        return false;
+
+    mOutDated = false;
+    return true;
+}
+
+/************************************************
+ Runs the whole pipeline for mMenuFileName, the directories and
+ files it depends on are collected in mWatchPaths.
+ ************************************************/
+bool DesktopMenuPrivate::build()
+{
+    Q_Q(DesktopMenu);
+
+    mWatchPaths.clear();
+    mProfile.clear();
+    mProfileTimer.start();
+
+    DesktopMenuProfileMark mark = profileMark();
+    XdgMenuReader reader(q);
+    if (!reader.load(mMenuFileName)) {
+        qCWarning(lcXdg) << reader.errorString();
+        mErrorString = reader.errorString();
+        return false;
+    }
+
+    if (isCancelled())
+        return false;
+
+    mXml = reader.xml();
+    QDomElement root = mXml.documentElement();
+    endPass(QStringLiteral("reader"), QStringLiteral("00-reader.xml"), mark);
+
+    mark = profileMark();
+    simplify(root);
+    endPass(QStringLiteral("simplify"), QStringLiteral("01-simplify.xml"), mark);
+
+    mark = profileMark();
+    mergeMenus(root);
+    endPass(QStringLiteral("mergeMenus"), QStringLiteral("02-mergeMenus.xml"), mark);
+
+    mark = profileMark();
+    moveMenus(root);
+    endPass(QStringLiteral("moveMenus"), QStringLiteral("03-moveMenus.xml"), mark);
+
+    mark = profileMark();
+    mergeMenus(root);
+    endPass(QStringLiteral("mergeMenus"), QStringLiteral("04-mergeMenus.xml"), mark);
+
+    mark = profileMark();
+    deleteDeletedMenus(root);
+    endPass(QStringLiteral("deleteDeletedMenus"), QStringLiteral("05-deleteDeletedMenus.xml"), mark);
+
+    if (isCancelled())
+        return false;
+
+    mark = profileMark();
+    processDirectoryEntries(root, QStringList());
+    endPass(QStringLiteral("processDirectoryEntries"), QStringLiteral("06-processDirectoryEntries.xml"), mark);
+
+    if (isCancelled())
+        return false;
+
+    if (mLazy) {
+        mark = profileMark();
+        processAppsLazily(root);
+        materialize(root);
+        endPass(QStringLiteral("materializeRoot"), QStringLiteral("07-materializeRoot.xml"), mark);
+    } else {
+        clearLazyState();
+
+        mark = profileMark();
+        processApps(root);
+        endPass(QStringLiteral("processApps"), QStringLiteral("07-processApps.xml"), mark);
+
+        if (isCancelled())
+            return false;
+
+        mark = profileMark();
+        processLayouts(root);
+        endPass(QStringLiteral("processLayouts"), QStringLiteral("08-processLayouts.xml"), mark);
+
+        mark = profileMark();
+        deleteEmpty(root);
+        endPass(QStringLiteral("deleteEmpty"), QStringLiteral("09-deleteEmpty.xml"), mark);
+
+        mark = profileMark();
+        fixSeparators(root);
+        endPass(QStringLiteral("fixSeparators"), QStringLiteral("10-fixSeparators.xml"), mark);
+
+        if (!mPreviewEnvironments.isEmpty()) {
+            mark = profileMark();
+            combineMasks(root);
+            endPass(QStringLiteral("combineMasks"), QStringLiteral("11-combineMasks.xml"), mark);
+        }
+    }
+
+    // Sub-menus of lazy menus are skeletons, their entries count too
+    mHash = structuralHash(root);
+    if (mLazy)
+        mHash = mLazyApps->selectionHash(mHash);
+
+    return true;
+}
+
+static int countElements(const QDomElement &element)
+{
+    int count = 1;
+    DomElementIterator it(element);
+    while (it.hasNext())
+        count += countElements(it.next());
+    return count;
+}
+
+void DesktopMenuPrivate::endPass(const QString &name, const QString &logFileName,
+                                 const DesktopMenuProfileMark &mark)
+{
+    if (mProfiling)
+        addProfileEntry(name, QStringLiteral("pass"), mark, countElements(mXml.documentElement()));
+
+    saveLog(logFileName);
+}
+
+static qint64 heapInUse()
+{
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+    return static_cast<qint64>(mallinfo2().uordblks);
+#else
+    return static_cast<qint64>(static_cast<unsigned int>(mallinfo().uordblks));
+#endif
+#else
+    return -1;
+#endif
+}
+
+DesktopMenuProfileMark DesktopMenuPrivate::profileMark() const
+{
+    DesktopMenuProfileMark mark;
+    if (mProfiling) {
+        mark.time = mProfileTimer.nsecsElapsed() / 1000;
+        mark.heap = heapInUse();
+    }
+    return mark;
+}
+
+void DesktopMenuPrivate::addProfileEntry(const QString &name, const QString &category,
+                                         const DesktopMenuProfileMark &mark, int nodes)
+{
+    if (!mProfiling)
+        return;
+
+    const DesktopMenuProfileMark end = profileMark();
+
+    DesktopMenuProfileEntry entry;
+    entry.name = name;
+    entry.category = category;
+    entry.start = mark.time;
+    entry.duration = end.time - mark.time;
+    entry.nodes = nodes;
+    entry.allocatedBytes = mark.heap >= 0 && end.heap >= 0 ? end.heap - mark.heap : -1;
+    mProfile.append(entry);
+}
+
+/************************************************
+ Builds the menu on a worker with its own DesktopMenu, the result
+ is delivered to finishBuild() on the thread of this object unless
+ another build started in the meantime.
+ ************************************************/
+void DesktopMenuPrivate::startBuild(bool explicitRead)
+{
+    const int generation = mGeneration->fetchAndAddOrdered(1) + 1;
+    const std::shared_ptr<QAtomicInt> current = mGeneration;
+    const QString menuFileName = mMenuFileName;
+    const QStringList environments = mEnvironments;
+    const QStringList previewEnvironments = mPreviewEnvironments;
+    const QString logDir = mLogDir;
+    const bool profiling = mProfiling;
+
+    mReading = true;
+
+    mBuildPool.start([this, current, generation, menuFileName, environments, previewEnvironments, logDir, profiling, explicitRead]() {
+        const auto cancelled = [current, generation]() {
+            return current->loadAcquire() != generation;
+        };
+        if (cancelled())
+            return;
+
+        DesktopMenuSnapshot snapshot;
+        {
+            DesktopMenu builder;
+            DesktopMenuPrivate *d = builder.d_func();
+            d->mMenuFileName = menuFileName;
+            d->mEnvironments = environments;
+            d->mPreviewEnvironments = previewEnvironments;
+            d->mLogDir = logDir;
+            d->mProfiling = profiling;
+            d->mCancelled = cancelled;
+
+            snapshot.success = d->build();
+            if (d->isCancelled())
+                return;
+
+            snapshot.xml = d->mXml;
+            snapshot.hash = d->mHash;
+            snapshot.watchPaths = d->mWatchPaths;
+            snapshot.errorString = d->mErrorString;
+            snapshot.profile = d->mProfile;
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, snapshot, explicitRead]() {
+            finishBuild(generation, snapshot, explicitRead);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DesktopMenuPrivate::finishBuild(int generation, const DesktopMenuSnapshot &snapshot, bool explicitRead)
+{
+    Q_Q(DesktopMenu);
+
+    if (generation != mGeneration->loadAcquire())
+        return;
+
+    mReading = false;
+    mWatchPaths = snapshot.watchPaths;
+    mProfile = snapshot.profile;
+    watch();
+
+    if (!snapshot.success) {
+        mErrorString = snapshot.errorString;
+        if (explicitRead)
+            Q_EMIT q->readFinished(false);
+        return;
+    }
+
+    const size_t prevHash = mHash;
+    const QDomDocument prevXml = mXml;
+
+    clearLazyState();
+    mXml = snapshot.xml;
+    mHash = snapshot.hash;
+
+    if (explicitRead) {
+        mOutDated = false;
+        Q_EMIT q->readFinished(true);
+    } else if (prevHash != mHash) {
+        mOutDated = true;
+        mChanges = DesktopMenu::diff(prevXml.documentElement(), mXml.documentElement());
+        Q_EMIT changed();
+    }
+}
+
+/************************************************
+ Hashes the tags and attributes of element and its descendants, and
+ the number of children of each element so that the shape of the tree
+ counts too. Attributes are combined regardless of their order,
+ QDomNamedNodeMap doesn't keep one.
+ ************************************************/
+size_t DesktopMenuPrivate::structuralHash(const QDomElement &element, size_t seed)
+{
+    size_t attributes = 0;
+    const QDomNamedNodeMap attrs = element.attributes();
+    for (int i = 0; i < attrs.count(); ++i) {
+        const QDomAttr attr = attrs.item(i).toAttr();
+        attributes += qHashMulti(0, attr.name(), attr.value());
+    }
+
+    seed = qHashMulti(seed, element.tagName(), attributes);
+
+    int children = 0;
+    DomElementIterator it(element);
+    while (it.hasNext()) {
+        seed = structuralHash(it.next(), seed);
+        ++children;
+    }
+
+    // Closes the element, otherwise moving an element to the parent
+    // of its previous sibling would keep the hash
+    return qHashMulti(seed, children);
+}
+
+static bool isMenuItem(const QDomElement &element)
+{
+    const QString tagName = element.tagName();
+    return tagName == QLatin1String("Menu") || tagName == QLatin1String("AppLink")
+            || tagName == QLatin1String("Separator") || tagName == QLatin1String("Header");
+}
+
+/************************************************
+ Identifies an item among its siblings: menus and headers by name,
+ AppLinks by desktop file id, separators by their position among
+ separators.
+ ************************************************/
+static QString menuItemKey(const QDomElement &element, QHash<QString, int> &occurrences)
+{
+    QString key = element.tagName();
+    if (key == QLatin1String("AppLink"))
+        key += QLatin1Char('/') + element.attribute(QStringLiteral("id"));
+    else if (key != QLatin1String("Separator"))
+        key += QLatin1Char('/') + element.attribute(QStringLiteral("name"));
+
+    const int occurrence = occurrences[key]++;
+    if (occurrence > 0)
+        key += QLatin1Char('#') + QString::number(occurrence);
+    return key;
+}
+
+static bool sameAttributes(const QDomElement &a, const QDomElement &b)
+{
+    const QDomNamedNodeMap attrs = a.attributes();
+    if (attrs.count() != b.attributes().count())
+        return false;
+
+    for (int i = 0; i < attrs.count(); ++i) {
+        const QDomAttr attr = attrs.item(i).toAttr();
+        if (!b.hasAttribute(attr.name()) || b.attribute(attr.name()) != attr.value())
+            return false;
+    }
+
+    return true;
+}
+
+static void diffMenu(const QDomElement &oldMenu, const QDomElement &newMenu, const QString &path,
+                     QList<DesktopMenuChange> &changes)
+{
+    QList<QDomElement> oldItems;
+    QList<QDomElement> newItems;
+    QHash<QString, int> newRows;
+
+    {
+        QHash<QString, int> occurrences;
+        DomElementIterator it(newMenu);
+        while (it.hasNext()) {
+            const QDomElement e = it.next();
+            if (isMenuItem(e)) {
+                newRows.insert(menuItemKey(e, occurrences), newItems.count());
+                newItems.append(e);
+            }
+        }
+    }
+
+    // Row in the newer menu of each old item, -1 if it's gone
+    QVector<int> rows;
+    {
+        QHash<QString, int> occurrences;
+        DomElementIterator it(oldMenu);
+        while (it.hasNext()) {
+            const QDomElement e = it.next();
+            if (isMenuItem(e)) {
+                rows.append(newRows.value(menuItemKey(e, occurrences), -1));
+                oldItems.append(e);
+            }
+        }
+    }
+
+    // Items that stay are the longest sequence of matching items in the
+    // same order in both menus, the others are removed and inserted again
+    QVector<int> tails;
+    QVector<int> previous(oldItems.count(), -1);
+    for (int i = 0; i < oldItems.count(); ++i) {
+        if (rows.at(i) < 0)
+            continue;
+
+        auto it = std::lower_bound(tails.begin(), tails.end(), rows.at(i), [&rows](int index, int row) {
+            return rows.at(index) < row;
+        });
+        if (it != tails.begin())
+            previous[i] = *(it - 1);
+        if (it == tails.end())
+            tails.append(i);
+        else
+            *it = i;
+    }
+
+    QVector<bool> keptOld(oldItems.count(), false);
+    QVector<int> matches(newItems.count(), -1);
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = previous.at(i)) {
+        keptOld[i] = true;
+        matches[rows.at(i)] = i;
+    }
+
+    for (int i = oldItems.count() - 1; i >= 0; --i) {
+        if (!keptOld.at(i))
+            changes.append(DesktopMenuChange{ DesktopMenuChange::Removed, path, i, oldItems.at(i) });
+    }
+
+    for (int i = 0; i < newItems.count(); ++i) {
+        if (matches.at(i) < 0)
+            changes.append(DesktopMenuChange{ DesktopMenuChange::Inserted, path, i, newItems.at(i) });
+    }
+
+    for (int i = 0; i < newItems.count(); ++i) {
+        if (matches.at(i) < 0)
+            continue;
+
+        const QDomElement &oldItem = oldItems.at(matches.at(i));
+        const QDomElement &newItem = newItems.at(i);
+
+        if (!sameAttributes(oldItem, newItem))
+            changes.append(DesktopMenuChange{ DesktopMenuChange::Changed, path, i, newItem });
+
+        if (newItem.tagName() == QLatin1String("Menu")) {
+            const QString name = newItem.attribute(QStringLiteral("name"));
+            diffMenu(oldItem, newItem, path.isEmpty() ? name : path + QLatin1Char('/') + name, changes);
+        }
+    }
+}
+
+QList<DesktopMenuChange> DesktopMenu::diff(const QDomElement &oldMenu, const QDomElement &newMenu)
+{
+    QList<DesktopMenuChange> changes;
+    diffMenu(oldMenu, newMenu, QString(), changes);
+    return changes;
+}
+
 /************************************************
  For debug only
  ************************************************/
@@ -218,12 +690,6 @@ void DesktopMenuPrivate::mergeMenus(QDomElement &element)
         }
     }
 
-    QDomElement n = element.firstChildElement(QStringLiteral("Menu"));
-    while (!n.isNull()) {
-        mergeMenus(n);
-        n = n.nextSiblingElement(QStringLiteral("Menu"));
-    }
-
     it.toFront();
     while (it.hasNext())
         mergeMenus(it.next());
@@ -326,39 +792,135 @@ QDomElement DesktopMenu::findMenu(QDomElement &baseElement, const QString &path,
     }
 
     // Relative path ..................
-    if (path.isEmpty())
-        return baseElement;
-
-    QString name = path.section(QLatin1Char('/'), 0, 0);
-    MutableDomElementIterator it(baseElement);
-    while (it.hasNext()) {
-        QDomElement n = it.next();
-        if (n.attribute(QStringLiteral("name")) == name)
-            return findMenu(n, path.section(QLatin1Char('/'), 1), createNonExisting);
+    const QStringList names = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    QDomElement el = baseElement;
+    int i = 0;
+    for (; i < names.count(); ++i) {
+        QDomElement found;
+        MutableDomElementIterator it(el);
+        while (it.hasNext() && found.isNull()) {
+            QDomElement n = it.next();
+            if (n.attribute(QStringLiteral("name")) == names.at(i))
+                found = n;
+        }
+        if (found.isNull())
+            break;
+        el = found;
     }
 
+    if (i == names.count())
+        return el;
+
     // Not found ......................
     if (!createNonExisting)
         return QDomElement();
 
-    const QStringList names = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
-    QDomElement el = baseElement;
-    for (const QString &name : names) {
+    for (; i < names.count(); ++i) {
         QDomElement p = el;
         el = d->mXml.createElement(QStringLiteral("Menu"));
         p.appendChild(el);
-        el.setAttribute(QStringLiteral("name"), name);
+        el.setAttribute(QStringLiteral("name"), names.at(i));
     }
     return el;
 }
 
-bool isParent(const QDomElement &parent, const QDomElement &child)
+DesktopMenuIndex::DesktopMenuIndex(const QDomElement &root)
+{
+    mRoot = add(root, nullptr);
+}
+
+DesktopMenuIndex::~DesktopMenuIndex()
+{
+    qDeleteAll(mNodes);
+}
+
+DesktopMenuIndex::Node *DesktopMenuIndex::add(const QDomElement &element, Node *parent)
 {
-    QDomNode n = child;
-    while (!n.isNull()) {
+    Node *node = new Node;
+    node->element = element;
+    node->parent = parent;
+    mNodes.append(node);
+
+    if (parent)
+        parent->children[element.attribute(QStringLiteral("name"))].append(node);
+
+    DomElementIterator it(element, QStringLiteral("Menu"));
+    while (it.hasNext())
+        add(it.next(), node);
+
+    return node;
+}
+
+DesktopMenuIndex::Node *DesktopMenuIndex::child(Node *node, const QDomElement &element) const
+{
+    const QList<Node *> candidates = node->children.value(element.attribute(QStringLiteral("name")));
+    for (Node *candidate : candidates) {
+        if (candidate->element == element)
+            return candidate;
+    }
+    return nullptr;
+}
+
+/************************************************
+ Same as DesktopMenu::findMenu() but resolved with the index,
+ the first menu in document order wins when names are duplicated.
+ ************************************************/
+DesktopMenuIndex::Node *DesktopMenuIndex::find(Node *base, const QString &path, bool createNonExisting)
+{
+    if (path.startsWith(QLatin1Char('/')))
+        return find(mRoot, path.section(QLatin1Char('/'), 2), createNonExisting);
+
+    const QStringList names = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    Node *node = base;
+    int i = 0;
+    for (; i < names.count(); ++i) {
+        const QList<Node *> found = node->children.value(names.at(i));
+        if (found.isEmpty())
+            break;
+        node = found.first();
+    }
+
+    if (i == names.count())
+        return node;
+
+    if (!createNonExisting)
+        return nullptr;
+
+    QDomDocument doc = base->element.ownerDocument();
+    for (; i < names.count(); ++i) {
+        QDomElement el = doc.createElement(QStringLiteral("Menu"));
+        el.setAttribute(QStringLiteral("name"), names.at(i));
+        node->element.appendChild(el);
+        node = add(el, node);
+    }
+    return node;
+}
+
+/************************************************
+ Reflects DesktopMenuPrivate::appendChilds() followed by the removal
+ of src: its child menus now follow the ones of dest.
+ ************************************************/
+void DesktopMenuIndex::merge(Node *src, Node *dest)
+{
+    for (auto it = src->children.cbegin(); it != src->children.cend(); ++it) {
+        for (Node *node : it.value()) {
+            node->parent = dest;
+            dest->children[it.key()].append(node);
+        }
+    }
+    src->children.clear();
+
+    if (src->parent) {
+        src->parent->children[src->element.attribute(QStringLiteral("name"))].removeOne(src);
+        src->parent = nullptr;
+    }
+}
+
+bool DesktopMenuIndex::isParent(const Node *parent, const Node *child)
+{
+    for (const Node *n = child; n; n = n->parent) {
         if (n == parent)
             return true;
-        n = n.parentNode();
     }
     return false;
 }
@@ -376,12 +938,21 @@ bool isParent(const QDomElement &parent, const QDomElement &child)
  ************************************************/
 void DesktopMenuPrivate::moveMenus(QDomElement &element)
 {
-    Q_Q(DesktopMenu);
+    DesktopMenuIndex index(element);
+    moveMenus(index, index.root());
+}
+
+void DesktopMenuPrivate::moveMenus(DesktopMenuIndex &index, DesktopMenuIndex::Node *node)
+{
+    QDomElement element = node->element;
 
     {
         MutableDomElementIterator i(element, QStringLiteral("Menu"));
-        while (i.hasNext())
-            moveMenus(i.next());
+        while (i.hasNext()) {
+            DesktopMenuIndex::Node *child = index.child(node, i.next());
+            if (child)
+                moveMenus(index, child);
+        }
     }
 
     MutableDomElementIterator i(element, QStringLiteral("Move"));
@@ -395,17 +966,18 @@ void DesktopMenuPrivate::moveMenus(QDomElement &element)
         if (oldPath.isEmpty() || newPath.isEmpty())
             continue;
 
-        QDomElement oldMenu = q->findMenu(element, oldPath, false);
-        if (oldMenu.isNull())
+        DesktopMenuIndex::Node *oldMenu = index.find(node, oldPath, false);
+        if (!oldMenu)
             continue;
 
-        QDomElement newMenu = q->findMenu(element, newPath, true);
+        DesktopMenuIndex::Node *newMenu = index.find(node, newPath, true);
 
-        if (isParent(oldMenu, newMenu))
+        if (DesktopMenuIndex::isParent(oldMenu, newMenu))
             continue;
 
-        appendChilds(oldMenu, newMenu);
-        oldMenu.parentNode().removeChild(oldMenu);
+        appendChilds(oldMenu->element, newMenu->element);
+        oldMenu->element.parentNode().removeChild(oldMenu->element);
+        index.merge(oldMenu, newMenu);
     }
 }
 
@@ -523,7 +1095,7 @@ void DesktopMenuPrivate::processLayouts(QDomElement &element)
     proc.run();
 }
 
-void DesktopMenuPrivate::fixSeparators(QDomElement &element)
+void DesktopMenuPrivate::fixSeparators(QDomElement &element, bool recursive)
 {
     MutableDomElementIterator it(element, QStringLiteral("Separator"));
     while (it.hasNext()) {
@@ -540,11 +1112,218 @@ void DesktopMenuPrivate::fixSeparators(QDomElement &element)
     if (last.tagName() == QLatin1String("Separator"))
         element.removeChild(last);
 
+    if (!recursive)
+        return;
+
     MutableDomElementIterator mi(element, QStringLiteral("Menu"));
     while (mi.hasNext())
         fixSeparators(mi.next());
 }
 
+/************************************************
+ A menu is visible in the environments any of its entries is
+ visible in. Skeleton sub-menus of lazy menus have no mask yet
+ and count as visible everywhere.
+ ************************************************/
+quint64 DesktopMenuPrivate::combineMasks(QDomElement &element, bool recursive)
+{
+    quint64 mask = 0;
+
+    MutableDomElementIterator it(element);
+    while (it.hasNext()) {
+        QDomElement &e = it.next();
+
+        if (e.tagName() == QLatin1String("Menu")) {
+            if (recursive)
+                mask |= combineMasks(e, recursive);
+            else if (e.hasAttribute(QStringLiteral("visibleIn")))
+                mask |= e.attribute(QStringLiteral("visibleIn")).toULongLong();
+            else
+                mask = ~quint64(0);
+        } else if (e.tagName() == QLatin1String("AppLink")) {
+            mask |= e.attribute(QStringLiteral("visibleIn")).toULongLong();
+        }
+    }
+
+    element.setAttribute(QStringLiteral("visibleIn"), QString::number(mask));
+    return mask;
+}
+
+/************************************************
+ Lazy mode: allocates the desktop entries of the whole tree, which
+ is needed for <OnlyUnallocated> menus, but leaves AppLinks creation
+ and layout to materialize().
+ ************************************************/
+void DesktopMenuPrivate::processAppsLazily(QDomElement &element)
+{
+    Q_Q(DesktopMenu);
+
+    clearLazyState();
+
+    mLazyApps = new XdgMenuApplinkProcessor(element, q);
+    mLazyApps->step1();
+
+    QList<XdgMenuApplinkProcessor *> processors;
+    processors << mLazyApps;
+    while (!processors.isEmpty()) {
+        XdgMenuApplinkProcessor *processor = processors.takeLast();
+        mLazyMenus.insert(menuPath(processor->element()), processor);
+        for (XdgMenuApplinkProcessor *child : processor->childs())
+            processors << child;
+    }
+
+    mLazyLayouts.insert(QString(), new XdgMenuLayoutProcessor(element));
+}
+
+/************************************************
+ Builds the contents of a menu registered by processAppsLazily(), this
+ is what processApps(), processLayouts(), deleteEmpty() and fixSeparators()
+ do for one menu. Sub-menus stay skeletons: they are kept as long as any
+ entry was allocated to them, unless the layout inlines them, in which
+ case they are built first. Parents must be built before their children.
+ Returns a null element if the menu has been removed because it's empty.
+ ************************************************/
+QDomElement DesktopMenuPrivate::materialize(QDomElement &element, bool recursive)
+{
+    const QString path = menuPath(element);
+    XdgMenuLayoutProcessor *layout = mLazyLayouts.value(path);
+
+    if (layout && !mMaterialized.contains(path)) {
+        mMaterialized.insert(path);
+
+        if (XdgMenuApplinkProcessor *apps = mLazyMenus.value(path))
+            apps->createAppLinks();
+
+        // Sub-menus inherit the default layout, which layout() removes
+        DomElementIterator it(element, QStringLiteral("Menu"));
+        while (it.hasNext()) {
+            QDomElement child = it.next();
+            const QString childPath = menuPath(child);
+            if (!mLazyLayouts.contains(childPath))
+                mLazyLayouts.insert(childPath, new XdgMenuLayoutProcessor(child, layout));
+        }
+
+        // Inlining moves the sub-menus of the inlined menu here, which
+        // changes their path
+        QMap<QString, QDomElement> moved;
+        layout->setCountFunction([this, &moved](QDomElement &menu, bool inlined) {
+            if (inlined) {
+                materialize(menu, true);
+                collectMenus(menu, moved);
+            } else if (!mMaterialized.contains(menuPath(menu))) {
+                return hasCandidates(menu) ? 1 : 0;
+            }
+            return XdgMenuLayoutProcessor::childsCount(menu);
+        });
+        layout->layout();
+        layout->setCountFunction(XdgMenuLayoutProcessor::CountFunction());
+        moveLazyState(moved);
+
+        MutableDomElementIterator mi(element, QStringLiteral("Menu"));
+        while (mi.hasNext()) {
+            QDomElement child = mi.next();
+            if (child.attribute(QStringLiteral("keep")) == QLatin1String("true"))
+                continue;
+
+            bool empty = false;
+            if (mMaterialized.contains(menuPath(child)))
+                empty = child.firstChildElement(QStringLiteral("Menu")).isNull()
+                        && child.firstChildElement(QStringLiteral("AppLink")).isNull();
+            else
+                empty = !hasCandidates(child);
+
+            if (empty)
+                element.removeChild(child);
+        }
+
+        fixSeparators(element, false);
+
+        if (!mPreviewEnvironments.isEmpty())
+            combineMasks(element, false);
+
+        // The entries of a kept sub-menu might all be hidden
+        if (!path.isEmpty() && element.attribute(QStringLiteral("keep")) != QLatin1String("true")
+            && element.firstChildElement(QStringLiteral("Menu")).isNull()
+            && element.firstChildElement(QStringLiteral("AppLink")).isNull()) {
+            element.parentNode().removeChild(element);
+            return QDomElement();
+        }
+    }
+
+    if (recursive) {
+        MutableDomElementIterator mi(element, QStringLiteral("Menu"));
+        while (mi.hasNext())
+            materialize(mi.next(), true);
+    }
+
+    return element;
+}
+
+/************************************************
+ Collects the sub-menus of element at any depth, by path.
+ ************************************************/
+void DesktopMenuPrivate::collectMenus(const QDomElement &element, QMap<QString, QDomElement> &menus)
+{
+    DomElementIterator it(element, QStringLiteral("Menu"));
+    while (it.hasNext()) {
+        const QDomElement menu = it.next();
+        menus.insert(menuPath(menu), menu);
+        collectMenus(menu, menus);
+    }
+}
+
+/************************************************
+ Registers the lazy state of menus under their current path,
+ menus are the menus collected before they were moved.
+ ************************************************/
+void DesktopMenuPrivate::moveLazyState(const QMap<QString, QDomElement> &menus)
+{
+    QHash<QString, XdgMenuApplinkProcessor *> apps;
+    QHash<QString, XdgMenuLayoutProcessor *> layouts;
+    QSet<QString> materialized;
+
+    for (auto it = menus.cbegin(); it != menus.cend(); ++it) {
+        const QString path = menuPath(it.value());
+        if (path == it.key())
+            continue;
+
+        if (XdgMenuApplinkProcessor *processor = mLazyMenus.take(it.key()))
+            apps.insert(path, processor);
+        if (XdgMenuLayoutProcessor *layout = mLazyLayouts.take(it.key()))
+            layouts.insert(path, layout);
+        if (mMaterialized.remove(it.key()))
+            materialized.insert(path);
+    }
+
+    mLazyMenus.insert(apps);
+    mLazyLayouts.insert(layouts);
+    mMaterialized.unite(materialized);
+}
+
+bool DesktopMenuPrivate::hasCandidates(const QDomElement &element) const
+{
+    XdgMenuApplinkProcessor *apps = mLazyMenus.value(menuPath(element));
+    return apps && apps->hasCandidates();
+}
+
+void DesktopMenuPrivate::clearLazyState()
+{
+    qDeleteAll(mLazyLayouts);
+    mLazyLayouts.clear();
+    mLazyMenus.clear();
+    mMaterialized.clear();
+    delete mLazyApps;
+    mLazyApps = nullptr;
+}
+
+QString DesktopMenuPrivate::menuPath(const QDomElement &element)
+{
+    QStringList names;
+    for (QDomElement e = element; e.parentNode().isElement(); e = e.parentNode().toElement())
+        names.prepend(e.attribute(QStringLiteral("name")));
+    return names.join(QLatin1Char('/'));
+}
+
 /************************************************
  $XDG_CONFIG_DIRS/menus/${XDG_MENU_PREFIX}applications.menu
  The first file found in the search path should be used; other files are ignored.
@@ -586,41 +1365,150 @@ QString DesktopMenu::getMenuFileName(const QString &baseName)
 void DesktopMenu::addWatchPath(const QString &path)
 {
     Q_D(DesktopMenu);
+    d->mWatchPaths.insert(path);
+}
 
-    if (d->mWatcher.files().contains(path))
-        return;
+bool DesktopMenu::isOutDated() const
+{
+    Q_D(const DesktopMenu);
+    return d->mOutDated;
+}
 
-    if (d->mWatcher.directories().contains(path))
-        return;
+bool DesktopMenu::isProfiling() const
+{
+    Q_D(const DesktopMenu);
+    return d->mProfiling;
+}
 
-    d->mWatcher.addPath(path);
+void DesktopMenu::setProfiling(bool enabled)
+{
+    Q_D(DesktopMenu);
+    d->mProfiling = enabled;
 }
 
-bool DesktopMenu::isOutDated() const
+QList<DesktopMenuProfileEntry> DesktopMenu::profile() const
 {
     Q_D(const DesktopMenu);
-    return d->mOutDated;
+    return d->mProfile;
 }
 
+bool DesktopMenu::saveProfile(const QString &fileName) const
+{
+    Q_D(const DesktopMenu);
+
+    QJsonArray events;
+    for (const DesktopMenuProfileEntry &entry : d->mProfile) {
+        QJsonObject args;
+        args.insert(QStringLiteral("nodes"), entry.nodes);
+        if (entry.allocatedBytes >= 0)
+            args.insert(QStringLiteral("allocatedBytes"), entry.allocatedBytes);
+
+        QJsonObject event;
+        event.insert(QStringLiteral("name"), entry.name);
+        event.insert(QStringLiteral("cat"), entry.category);
+        event.insert(QStringLiteral("ph"), QStringLiteral("X"));
+        event.insert(QStringLiteral("ts"), entry.start);
+        event.insert(QStringLiteral("dur"), entry.duration);
+        event.insert(QStringLiteral("pid"), QCoreApplication::applicationPid());
+        event.insert(QStringLiteral("tid"), 0);
+        event.insert(QStringLiteral("args"), args);
+        events.append(event);
+    }
+
+    QJsonObject trace;
+    trace.insert(QStringLiteral("traceEvents"), events);
+    trace.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(lcXdg, "Cannot write file \"%s\": %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    return file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) >= 0;
+}
+
+QList<DesktopMenuChange> DesktopMenu::changes() const
+{
+    Q_D(const DesktopMenu);
+    return d->mChanges;
+}
+
+int DesktopMenu::rebuildDelay() const
+{
+    Q_D(const DesktopMenu);
+    return d->mRebuildDelayTimer.interval();
+}
+
+void DesktopMenu::setRebuildDelay(int msec)
+{
+    Q_D(DesktopMenu);
+    d->mRebuildDelayTimer.setInterval(qMax(0, msec));
+}
+
+/************************************************
+ Lazy menus are rebuilt on this thread, the skeleton is cheap
+ and the state of the sub-menus can't move between threads. The
+ menus that were built before are built again, so that the diff
+ compares them and not their skeletons.
+ ************************************************/
 void DesktopMenuPrivate::rebuild()
 {
     Q_Q(DesktopMenu);
-    QByteArray prevHash = mHash;
-    q->read(mMenuFileName);
+
+    if (!mLazy) {
+        startBuild(false);
+        return;
+    }
+
+    const size_t prevHash = mHash;
+    const QDomDocument prevXml = mXml;
+    const QSet<QString> materialized = mMaterialized;
+    read(mMenuFileName);
 
     if (prevHash != mHash) {
+        for (const QString &path : materialized)
+            q->menu(path);
+
         mOutDated = true;
+        mChanges = DesktopMenu::diff(prevXml.documentElement(), mXml.documentElement());
         Q_EMIT changed();
     }
 }
 
-void DesktopMenuPrivate::clearWatcher()
+/************************************************
+ Watches the paths collected by the last build. Only the difference
+ with what is watched already is applied, this also brings back files
+ the watcher dropped because they were replaced.
+ ************************************************/
+void DesktopMenuPrivate::watch()
 {
-    QStringList sl;
-    sl << mWatcher.files();
-    sl << mWatcher.directories();
-    if (sl.length())
-        mWatcher.removePaths(sl);
+    QSet<QString> watched;
+    const QStringList files = mWatcher.files();
+    const QStringList directories = mWatcher.directories();
+    watched.reserve(files.count() + directories.count());
+    for (const QString &path : files)
+        watched.insert(path);
+    for (const QString &path : directories)
+        watched.insert(path);
+
+    QStringList removed;
+    for (const QString &path : const_cast<const QSet<QString> &>(watched)) {
+        if (!mWatchPaths.contains(path))
+            removed.append(path);
+    }
+
+    QStringList added;
+    for (const QString &path : const_cast<const QSet<QString> &>(mWatchPaths)) {
+        if (!watched.contains(path))
+            added.append(path);
+    }
+
+    if (!removed.isEmpty())
+        mWatcher.removePaths(removed);
+    if (!added.isEmpty())
+        mWatcher.addPaths(added);
 }
 
 } // namespace Liri
@@ -18,6 +18,46 @@ namespace Liri {
 
 class DesktopMenuPrivate;
 
+/*!
+ * Measurement of a pass of DesktopMenu::read() or of the loading of a menu file,
+ * see DesktopMenu::setProfiling().
+ */
+struct LIRIXDG_EXPORT DesktopMenuProfileEntry
+{
+    //! Pass name, such as "simplify", or menu file name
+    QString name;
+    //! "pass" or "file"
+    QString category;
+    //! Start time in microseconds since read() started
+    qint64 start;
+    //! Wall time in microseconds
+    qint64 duration;
+    //! Elements in the menu after the pass, or XML nodes of the file
+    int nodes;
+    //! Growth of the heap in use, in bytes, -1 if the C library can't tell
+    qint64 allocatedBytes;
+};
+
+/*!
+ * One step to turn a menu into a newer version of it, see DesktopMenu::diff().
+ */
+struct LIRIXDG_EXPORT DesktopMenuChange
+{
+    enum Type {
+        Removed,
+        Inserted,
+        Changed,
+    };
+
+    Type type;
+    //! Path of the parent menu relative to the root menu, such as "Games/Puzzle"
+    QString menuPath;
+    //! Position among the Menu, AppLink, Separator and Header children of the parent
+    int row;
+    //! The removed element, or the element in the newer menu
+    QDomElement element;
+};
+
 /*! @brief The XdgMenu class implements the "Desktop Menu Specification" from freedesktop.org.
 
  Freedesktop menu is a user-visible hierarchy of applications, typically displayed as a menu.
@@ -44,6 +84,7 @@ class LIRIXDG_EXPORT DesktopMenu : public QObject
     Q_OBJECT
     Q_DECLARE_PRIVATE(DesktopMenu)
 
+    friend class DesktopMenuPrivate;
     friend class XdgMenuReader;
     friend class XdgMenuApplinkProcessor;
 
@@ -51,7 +92,25 @@ public:
     explicit DesktopMenu(QObject *parent = nullptr);
     virtual ~DesktopMenu();
 
+    /*!
+     * Reads the menu on this thread, readFinished() is emitted when done.
+     * Returns false if the menu file cannot be read, see errorString().
+     */
     bool read(const QString &menuFileName);
+
+    /*!
+     * Reads the menu on a worker thread. When done the result replaces
+     * the current menu and readFinished() is emitted on the thread of
+     * this object. Calling read() or readAsync() again cancels a read
+     * that is still running. Sub-menus are always built, regardless
+     * of isLazy().
+     */
+    void readAsync(const QString &menuFileName);
+
+    /*!
+     * Returns whether a readAsync() is running.
+     */
+    bool isReading() const;
     void save(const QString &fileName);
 
     const QDomDocument xml() const;
@@ -59,6 +118,27 @@ public:
 
     QDomElement findMenu(QDomElement &baseElement, const QString &path, bool createNonExisting);
 
+    /*!
+     * Returns whether sub-menus are built on demand.
+     */
+    bool isLazy() const;
+
+    /*!
+     * When lazy is true, read() only builds the menu skeleton and the
+     * contents of the root menu. Application links and layout of each
+     * sub-menu are computed the first time it's requested with menu().
+     * Takes effect on the next read().
+     */
+    void setLazy(bool lazy);
+
+    /*!
+     * Returns the menu element at path, for example "/Applications/Games"
+     * or "Games", relative to the root menu. The menu and its parents are
+     * built first if needed. Returns a null element if the menu doesn't exist
+     * or turns out to have no visible entries.
+     */
+    QDomElement menu(const QString &path);
+
     /*! Returns a  list of strings identifying the environments that should
      *  display a desktop entry. Internally all comparisions involving the
      *  desktop enviroment names are made case insensitive.
@@ -73,6 +153,28 @@ public:
     void setEnvironments(const QStringList &envs);
     void setEnvironments(const QString &env);
 
+    /*!
+     * Returns the environments the menu is built for at once, see setPreviewEnvironments().
+     */
+    QStringList previewEnvironments() const;
+
+    /*!
+     * Builds a single menu for several environments, sharing parsing and rule
+     * evaluation. When set, environments() is ignored and the menu contains
+     * the entries visible in any of these environments. Every AppLink and menu
+     * gets a "visibleIn" attribute, a bit mask where bit i stands for
+     * envs.at(i), test it with isVisibleIn(). At most 64 environments are
+     * taken into account. Takes effect on the next read().
+     */
+    void setPreviewEnvironments(const QStringList &envs);
+
+    /*!
+     * Returns whether an AppLink or menu element is visible in the environment
+     * at index environment of previewEnvironments(). Elements without mask,
+     * such as separators, are visible everywhere.
+     */
+    static bool isVisibleIn(const QDomElement &element, int environment);
+
     /*!
      * Returns a string description of the last error that occurred if read() returns false.
      */
@@ -93,8 +195,59 @@ public:
 
     bool isOutDated() const;
 
+    /*!
+     * Returns how long, in milliseconds, the menu waits for watched files
+     * and directories to settle before it's rebuilt. Changes within this
+     * delay are coalesced into one rebuild.
+     */
+    int rebuildDelay() const;
+    void setRebuildDelay(int msec);
+
+    /*!
+     * Returns whether read() measures its passes.
+     */
+    bool isProfiling() const;
+
+    /*!
+     * When enabled, read() records wall time, heap growth and element count
+     * of each pass and of each menu file it loads, see profile(). The heap is
+     * shared by the whole process, other threads allocating at the same time
+     * are accounted too.
+     */
+    void setProfiling(bool enabled);
+
+    /*!
+     * Returns the measurements of the last read(), in the order they completed.
+     */
+    QList<DesktopMenuProfileEntry> profile() const;
+
+    /*!
+     * Saves profile() to fileName in the Trace Event Format of chrome://tracing.
+     * Returns false if the file cannot be written.
+     */
+    bool saveProfile(const QString &fileName) const;
+
+    /*!
+     * Returns the changes made to the menu by the last rebuild that emitted changed().
+     * When the menu is lazy, the sub-menus built before the rebuild are built again
+     * and compared, the others are compared as skeletons.
+     */
+    QList<DesktopMenuChange> changes() const;
+
+    /*!
+     * Returns the changes that turn oldMenu into newMenu. Applied in order,
+     * removals come first from the last row, then insertions from the first
+     * row, then changed attributes. Menus and AppLinks are matched by name and
+     * id, matching sub-menus are compared recursively, others are removed or
+     * inserted as a whole.
+     */
+    static QList<DesktopMenuChange> diff(const QDomElement &oldMenu, const QDomElement &newMenu);
+
 Q_SIGNALS:
+    //! The menu was rebuilt because a watched file or directory changed, see changes()
     void changed();
+    //! A read() or readAsync() is done and the result replaced the menu, unless success is false
+    void readFinished(bool success);
 
 protected:
     void addWatchPath(const QString &path);
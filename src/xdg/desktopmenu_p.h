@@ -7,10 +7,18 @@
 #define LIRI_DESKTOPMENU_P_H
 
 #include <QObject>
+#include <QElapsedTimer>
 #include <QFileSystemWatcher>
+#include <QHash>
+#include <QMap>
+#include <QSet>
 #include <QStringList>
+#include <QThreadPool>
 #include <QTimer>
 
+#include <functional>
+#include <memory>
+
 #include "desktopmenu.h"
 
 #define REBUILD_DELAY 3000
@@ -28,22 +36,85 @@
 
 namespace Liri {
 
+class XdgMenuApplinkProcessor;
+class XdgMenuLayoutProcessor;
+
+/*
+ * Menu tree indexed by name, built once for the whole moveMenus() pass
+ * so that resolving a <Move> path costs one hash lookup per component.
+ * Sibling menus with the same name are kept in document order.
+ */
+class DesktopMenuIndex
+{
+public:
+    struct Node {
+        QDomElement element;
+        Node *parent = nullptr;
+        QHash<QString, QList<Node *>> children;
+    };
+
+    explicit DesktopMenuIndex(const QDomElement &root);
+    ~DesktopMenuIndex();
+
+    Node *root() const { return mRoot; }
+    Node *child(Node *node, const QDomElement &element) const;
+    Node *find(Node *base, const QString &path, bool createNonExisting);
+    void merge(Node *src, Node *dest);
+
+    static bool isParent(const Node *parent, const Node *child);
+
+private:
+    Node *add(const QDomElement &element, Node *parent);
+
+    QList<Node *> mNodes;
+    Node *mRoot = nullptr;
+};
+
+/*
+ * Result of a build on a worker thread, nothing else references
+ * the document once it's handed over to the owner thread.
+ */
+struct DesktopMenuSnapshot {
+    bool success = false;
+    QDomDocument xml;
+    size_t hash = 0;
+    QSet<QString> watchPaths;
+    QString errorString;
+    QList<DesktopMenuProfileEntry> profile;
+};
+
+struct DesktopMenuProfileMark {
+    qint64 time = 0;
+    qint64 heap = -1;
+};
+
 class DesktopMenuPrivate : public QObject
 {
     Q_OBJECT
     Q_DECLARE_PUBLIC(DesktopMenu)
 public:
     explicit DesktopMenuPrivate(DesktopMenu *parent);
+    ~DesktopMenuPrivate();
 
     void simplify(QDomElement &element);
     void mergeMenus(QDomElement &element);
     void moveMenus(QDomElement &element);
+    void moveMenus(DesktopMenuIndex &index, DesktopMenuIndex::Node *node);
     void deleteDeletedMenus(QDomElement &element);
     void processDirectoryEntries(QDomElement &element, const QStringList &parentDirs);
     void processApps(QDomElement &element);
     void deleteEmpty(QDomElement &element);
     void processLayouts(QDomElement &element);
-    void fixSeparators(QDomElement &element);
+    void fixSeparators(QDomElement &element, bool recursive = true);
+    quint64 combineMasks(QDomElement &element, bool recursive = true);
+
+    void processAppsLazily(QDomElement &element);
+    QDomElement materialize(QDomElement &element, bool recursive = false);
+    bool hasCandidates(const QDomElement &element) const;
+    static void collectMenus(const QDomElement &element, QMap<QString, QDomElement> &menus);
+    void moveLazyState(const QMap<QString, QDomElement> &menus);
+    void clearLazyState();
+    static QString menuPath(const QDomElement &element);
 
     bool loadDirectoryFile(const QString &fileName, QDomElement &element);
     void prependChilds(QDomElement &srcElement, QDomElement &destElement);
@@ -52,19 +123,54 @@ public:
     void saveLog(const QString &logFileName);
     void load(const QString &fileName);
 
-    void clearWatcher();
+    bool read(const QString &menuFileName);
+    bool build();
+    void endPass(const QString &name, const QString &logFileName, const DesktopMenuProfileMark &mark);
+
+    DesktopMenuProfileMark profileMark() const;
+    void addProfileEntry(const QString &name, const QString &category,
+                         const DesktopMenuProfileMark &mark, int nodes);
+    bool isCancelled() const { return mCancelled && mCancelled(); }
+    void startBuild(bool explicitRead);
+    void finishBuild(int generation, const DesktopMenuSnapshot &snapshot, bool explicitRead);
+
+    void watch();
+
+    static size_t structuralHash(const QDomElement &element, size_t seed = 0);
 
     QString mErrorString;
     QStringList mEnvironments;
+    QStringList mPreviewEnvironments;
     QString mMenuFileName;
     QString mLogDir;
     QDomDocument mXml;
-    QByteArray mHash;
+    size_t mHash = 0;
+    QList<DesktopMenuChange> mChanges;
     QTimer mRebuildDelayTimer;
 
     QFileSystemWatcher mWatcher;
+    QSet<QString> mWatchPaths;
     bool mOutDated;
 
+    // Bumped by every read, a build is cancelled once it's outdated
+    std::shared_ptr<QAtomicInt> mGeneration = std::make_shared<QAtomicInt>(0);
+    std::function<bool()> mCancelled;
+    bool mReading = false;
+
+    bool mProfiling = false;
+    QElapsedTimer mProfileTimer;
+    QList<DesktopMenuProfileEntry> mProfile;
+
+    // Lazy mode, keyed by menu path
+    bool mLazy = false;
+    XdgMenuApplinkProcessor *mLazyApps = nullptr;
+    QHash<QString, XdgMenuApplinkProcessor *> mLazyMenus;
+    QHash<QString, XdgMenuLayoutProcessor *> mLazyLayouts;
+    QSet<QString> mMaterialized;
+
+    // Declared last: waits for the running build before anything else is destroyed
+    QThreadPool mBuildPool;
+
 public Q_SLOTS:
     void rebuild();
 
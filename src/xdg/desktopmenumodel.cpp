@@ -0,0 +1,407 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "desktopmenumodel.h"
+#include "desktopmenumodel_p.h"
+#include "xmlhelper_p_p.h"
+
+namespace Liri {
+
+/*!
+ * \class DesktopMenuModel
+ * \inmodule LiriXdg
+ * \brief Tree model over the menus and application links of a DesktopMenu.
+ *
+ * When the menu is rebuilt the model applies DesktopMenu::changes() row by
+ * row, so that persistent indexes and views survive. A new read() or
+ * readAsync() resets the model.
+ *
+ * For lazy menus the sub-menus are built by fetchMore() and every rebuild
+ * resets the model.
+ */
+
+static bool isMenuItem(const QDomElement &element)
+{
+    const QString tagName = element.tagName();
+    return tagName == QLatin1String("Menu") || tagName == QLatin1String("AppLink")
+            || tagName == QLatin1String("Separator") || tagName == QLatin1String("Header");
+}
+
+static bool isMenu(const DesktopMenuModelNode *node)
+{
+    return node->element.tagName() == QLatin1String("Menu");
+}
+
+/*
+ * DesktopMenuModelPrivate
+ */
+
+DesktopMenuModelPrivate::DesktopMenuModelPrivate(DesktopMenuModel *model)
+    : q_ptr(model)
+{
+}
+
+DesktopMenuModelPrivate::~DesktopMenuModelPrivate()
+{
+    delete root;
+}
+
+DesktopMenuModelNode *DesktopMenuModelPrivate::createNode(const QDomElement &element,
+                                                          DesktopMenuModelNode *parent,
+                                                          bool populate)
+{
+    DesktopMenuModelNode *node = new DesktopMenuModelNode;
+    node->element = element;
+    node->parent = parent;
+
+    if (!isMenu(node))
+        node->fetched = true;
+    else if (populate)
+        node->children = createChildren(node, populate);
+
+    return node;
+}
+
+QList<DesktopMenuModelNode *> DesktopMenuModelPrivate::createChildren(DesktopMenuModelNode *node, bool populate)
+{
+    QList<DesktopMenuModelNode *> children;
+
+    DomElementIterator it(node->element);
+    while (it.hasNext()) {
+        const QDomElement e = it.next();
+        if (isMenuItem(e))
+            children.append(createNode(e, node, populate));
+    }
+
+    node->fetched = true;
+    return children;
+}
+
+DesktopMenuModelNode *DesktopMenuModelPrivate::findMenu(const QString &path) const
+{
+    DesktopMenuModelNode *node = root;
+
+    const QStringList names = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    for (const QString &name : names) {
+        if (!node || !node->fetched)
+            return nullptr;
+
+        DesktopMenuModelNode *found = nullptr;
+        for (DesktopMenuModelNode *child : const_cast<const QList<DesktopMenuModelNode *> &>(node->children)) {
+            if (isMenu(child) && child->element.attribute(QStringLiteral("name")) == name) {
+                found = child;
+                break;
+            }
+        }
+        node = found;
+    }
+
+    return node;
+}
+
+QString DesktopMenuModelPrivate::pathOf(const DesktopMenuModelNode *node) const
+{
+    QStringList names;
+    for (; node && node != root; node = node->parent)
+        names.prepend(node->element.attribute(QStringLiteral("name")));
+    return names.join(QLatin1Char('/'));
+}
+
+QModelIndex DesktopMenuModelPrivate::indexOf(DesktopMenuModelNode *node) const
+{
+    Q_Q(const DesktopMenuModel);
+
+    if (!node || node == root)
+        return QModelIndex();
+
+    return q->createIndex(node->parent->children.indexOf(node), 0, node);
+}
+
+void DesktopMenuModelPrivate::reset()
+{
+    Q_Q(DesktopMenuModel);
+
+    q->beginResetModel();
+
+    delete root;
+    root = nullptr;
+
+    if (menu) {
+        const QDomElement element = menu->xml().documentElement();
+        if (!element.isNull()) {
+            root = createNode(element, nullptr, false);
+            root->children = createChildren(root, !menu->isLazy());
+        }
+    }
+
+    q->endResetModel();
+}
+
+/*
+ * Applies the changes of the last rebuild, see DesktopMenu::diff()
+ * for the order they come in. Changes below menus that were not
+ * fetched yet are skipped, those menus are built from the new
+ * document when fetched.
+ */
+void DesktopMenuModelPrivate::applyChanges()
+{
+    Q_Q(DesktopMenuModel);
+
+    if (!menu || !root || menu->isLazy()) {
+        reset();
+        return;
+    }
+
+    const QList<DesktopMenuChange> changes = menu->changes();
+    for (const DesktopMenuChange &change : changes) {
+        DesktopMenuModelNode *parent = findMenu(change.menuPath);
+        if (!parent || !parent->fetched)
+            continue;
+
+        const QModelIndex parentIndex = indexOf(parent);
+
+        switch (change.type) {
+        case DesktopMenuChange::Removed:
+            if (change.row >= parent->children.count())
+                break;
+            q->beginRemoveRows(parentIndex, change.row, change.row);
+            delete parent->children.takeAt(change.row);
+            q->endRemoveRows();
+            break;
+        case DesktopMenuChange::Inserted: {
+            if (change.row > parent->children.count())
+                break;
+            DesktopMenuModelNode *node = createNode(change.element, parent, true);
+            q->beginInsertRows(parentIndex, change.row, change.row);
+            parent->children.insert(change.row, node);
+            q->endInsertRows();
+            break;
+        }
+        case DesktopMenuChange::Changed: {
+            if (change.row >= parent->children.count())
+                break;
+            parent->children.at(change.row)->element = change.element;
+            const QModelIndex index = q->index(change.row, 0, parentIndex);
+            Q_EMIT q->dataChanged(index, index);
+            break;
+        }
+        }
+    }
+
+    // Unchanged nodes still point to the previous document
+    rebind(root, menu->xml().documentElement());
+}
+
+void DesktopMenuModelPrivate::rebind(DesktopMenuModelNode *node, const QDomElement &element)
+{
+    node->element = element;
+
+    if (!node->fetched || !isMenu(node))
+        return;
+
+    int row = 0;
+    DomElementIterator it(element);
+    while (it.hasNext() && row < node->children.count()) {
+        const QDomElement e = it.next();
+        if (isMenuItem(e))
+            rebind(node->children.at(row++), e);
+    }
+}
+
+/*
+ * DesktopMenuModel
+ */
+
+DesktopMenuModel::DesktopMenuModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , d_ptr(new DesktopMenuModelPrivate(this))
+{
+}
+
+DesktopMenuModel::~DesktopMenuModel()
+{
+    delete d_ptr;
+}
+
+DesktopMenu *DesktopMenuModel::menu() const
+{
+    Q_D(const DesktopMenuModel);
+    return d->menu;
+}
+
+void DesktopMenuModel::setMenu(DesktopMenu *menu)
+{
+    Q_D(DesktopMenuModel);
+
+    if (d->menu == menu)
+        return;
+
+    if (d->menu)
+        d->menu->disconnect(this);
+
+    d->menu = menu;
+
+    if (d->menu) {
+        connect(d->menu, &DesktopMenu::changed, this, [d] {
+            d->applyChanges();
+        });
+        connect(d->menu, &DesktopMenu::readFinished, this, [d] {
+            d->reset();
+        });
+        connect(d->menu, &QObject::destroyed, this, [d] {
+            d->reset();
+        });
+    }
+
+    d->reset();
+
+    Q_EMIT menuChanged();
+}
+
+QHash<int, QByteArray> DesktopMenuModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(TypeRole, QByteArrayLiteral("type"));
+    roles.insert(NameRole, QByteArrayLiteral("name"));
+    roles.insert(TitleRole, QByteArrayLiteral("title"));
+    roles.insert(IconNameRole, QByteArrayLiteral("iconName"));
+    roles.insert(ExecRole, QByteArrayLiteral("exec"));
+    roles.insert(CommentRole, QByteArrayLiteral("comment"));
+    roles.insert(DesktopFileRole, QByteArrayLiteral("desktopFile"));
+    return roles;
+}
+
+QVariant DesktopMenuModel::data(const QModelIndex &index, int role) const
+{
+    if (!checkIndex(index, CheckIndexOption::IndexIsValid))
+        return QVariant();
+
+    const DesktopMenuModelNode *node = static_cast<DesktopMenuModelNode *>(index.internalPointer());
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case TitleRole:
+        return node->element.attribute(QStringLiteral("title"));
+    case TypeRole:
+        return node->element.tagName();
+    case NameRole:
+        return node->element.attribute(QStringLiteral("name"));
+    case IconNameRole:
+        return node->element.attribute(QStringLiteral("icon"));
+    case ExecRole:
+        return node->element.attribute(QStringLiteral("exec"));
+    case CommentRole:
+        return node->element.attribute(QStringLiteral("comment"));
+    case DesktopFileRole:
+        return node->element.attribute(QStringLiteral("desktopFile"));
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+QModelIndex DesktopMenuModel::index(int row, int column, const QModelIndex &parent) const
+{
+    Q_D(const DesktopMenuModel);
+
+    if (!d->root || column != 0 || row < 0)
+        return QModelIndex();
+
+    const DesktopMenuModelNode *node = parent.isValid()
+            ? static_cast<DesktopMenuModelNode *>(parent.internalPointer())
+            : d->root;
+    if (row >= node->children.count())
+        return QModelIndex();
+
+    return createIndex(row, column, node->children.at(row));
+}
+
+QModelIndex DesktopMenuModel::parent(const QModelIndex &index) const
+{
+    Q_D(const DesktopMenuModel);
+
+    if (!index.isValid())
+        return QModelIndex();
+
+    const DesktopMenuModelNode *node = static_cast<DesktopMenuModelNode *>(index.internalPointer());
+    return d->indexOf(node->parent);
+}
+
+int DesktopMenuModel::rowCount(const QModelIndex &parent) const
+{
+    Q_D(const DesktopMenuModel);
+
+    if (parent.column() > 0)
+        return 0;
+
+    const DesktopMenuModelNode *node = parent.isValid()
+            ? static_cast<DesktopMenuModelNode *>(parent.internalPointer())
+            : d->root;
+    return node ? node->children.count() : 0;
+}
+
+int DesktopMenuModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return 1;
+}
+
+bool DesktopMenuModel::hasChildren(const QModelIndex &parent) const
+{
+    Q_D(const DesktopMenuModel);
+
+    const DesktopMenuModelNode *node = parent.isValid()
+            ? static_cast<DesktopMenuModelNode *>(parent.internalPointer())
+            : d->root;
+    if (!node)
+        return false;
+
+    return !node->fetched || !node->children.isEmpty();
+}
+
+bool DesktopMenuModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return false;
+
+    const DesktopMenuModelNode *node = static_cast<DesktopMenuModelNode *>(parent.internalPointer());
+    return !node->fetched;
+}
+
+/*!
+ * Builds the sub-menu at \a parent with DesktopMenu::menu().
+ */
+void DesktopMenuModel::fetchMore(const QModelIndex &parent)
+{
+    Q_D(DesktopMenuModel);
+
+    if (!canFetchMore(parent) || !d->menu)
+        return;
+
+    DesktopMenuModelNode *node = static_cast<DesktopMenuModelNode *>(parent.internalPointer());
+
+    // The entries of the sub-menu might all be hidden, then it's
+    // removed from the menu
+    const QDomElement element = d->menu->menu(d->pathOf(node));
+    if (element.isNull()) {
+        DesktopMenuModelNode *parentNode = node->parent;
+        const int row = static_cast<int>(parentNode->children.indexOf(node));
+        beginRemoveRows(parent.parent(), row, row);
+        delete parentNode->children.takeAt(row);
+        endRemoveRows();
+        return;
+    }
+
+    node->element = element;
+    const QList<DesktopMenuModelNode *> children = d->createChildren(node, false);
+    if (children.isEmpty())
+        return;
+
+    beginInsertRows(parent, 0, children.count() - 1);
+    node->children = children;
+    endInsertRows();
+}
+
+} // namespace Liri
@@ -0,0 +1,65 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPMENUMODEL_H
+#define LIRI_DESKTOPMENUMODEL_H
+
+#include <QAbstractItemModel>
+
+#include <LiriXdg/DesktopMenu>
+
+namespace Liri {
+
+class DesktopMenuModelPrivate;
+
+class LIRIXDG_EXPORT DesktopMenuModel : public QAbstractItemModel
+{
+    Q_OBJECT
+    Q_PROPERTY(Liri::DesktopMenu *menu READ menu WRITE setMenu NOTIFY menuChanged)
+    Q_DECLARE_PRIVATE(DesktopMenuModel)
+public:
+    enum Roles {
+        TypeRole = Qt::UserRole + 1,
+        NameRole,
+        TitleRole,
+        IconNameRole,
+        ExecRole,
+        CommentRole,
+        DesktopFileRole,
+    };
+    Q_ENUM(Roles)
+
+    explicit DesktopMenuModel(QObject *parent = nullptr);
+    virtual ~DesktopMenuModel();
+
+    DesktopMenu *menu() const;
+    void setMenu(DesktopMenu *menu);
+
+    QHash<int, QByteArray> roleNames() const override;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+
+    QModelIndex parent(const QModelIndex &index) const override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+Q_SIGNALS:
+    void menuChanged();
+
+private:
+    DesktopMenuModelPrivate *const d_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPMENUMODEL_H
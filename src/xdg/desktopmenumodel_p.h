@@ -0,0 +1,60 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_DESKTOPMENUMODEL_P_H
+#define LIRI_DESKTOPMENUMODEL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QPointer>
+
+#include "desktopmenumodel.h"
+
+namespace Liri {
+
+struct DesktopMenuModelNode {
+    ~DesktopMenuModelNode() { qDeleteAll(children); }
+
+    QDomElement element;
+    DesktopMenuModelNode *parent = nullptr;
+    QList<DesktopMenuModelNode *> children;
+    bool fetched = false;
+};
+
+class DesktopMenuModelPrivate
+{
+    Q_DECLARE_PUBLIC(DesktopMenuModel)
+public:
+    explicit DesktopMenuModelPrivate(DesktopMenuModel *model);
+    ~DesktopMenuModelPrivate();
+
+    DesktopMenuModelNode *createNode(const QDomElement &element, DesktopMenuModelNode *parent, bool populate);
+    QList<DesktopMenuModelNode *> createChildren(DesktopMenuModelNode *node, bool populate);
+    DesktopMenuModelNode *findMenu(const QString &path) const;
+    QString pathOf(const DesktopMenuModelNode *node) const;
+    QModelIndex indexOf(DesktopMenuModelNode *node) const;
+
+    void reset();
+    void applyChanges();
+    void rebind(DesktopMenuModelNode *node, const QDomElement &element);
+
+    QPointer<DesktopMenu> menu;
+    DesktopMenuModelNode *root = nullptr;
+
+protected:
+    DesktopMenuModel *q_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_DESKTOPMENUMODEL_P_H
@@ -0,0 +1,454 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <climits>
+
+#include "iconcache.h"
+#include "iconcache_p.h"
+#include "xdgdirs_p_p.h"
+
+namespace Liri {
+
+Q_GLOBAL_STATIC(IconCache, s_iconCache)
+
+// In order of preference
+static const char *const iconExtensions[] = { "png", "svg", "xpm" };
+
+static const QString hicolorTheme = QStringLiteral("hicolor");
+
+/*
+ * IconThemeDirectory
+ */
+
+bool IconThemeDirectory::matchesSize(int iconSize, int iconScale) const
+{
+    if (scale != iconScale)
+        return false;
+
+    switch (type) {
+    case Fixed:
+        return size == iconSize;
+    case Scalable:
+        return minSize <= iconSize && iconSize <= maxSize;
+    case Threshold:
+        return size - threshold <= iconSize && iconSize <= size + threshold;
+    }
+
+    return false;
+}
+
+int IconThemeDirectory::sizeDistance(int iconSize, int iconScale) const
+{
+    const int scaled = iconSize * iconScale;
+
+    switch (type) {
+    case Fixed:
+        return qAbs(size * scale - scaled);
+    case Scalable:
+        if (scaled < minSize * scale)
+            return minSize * scale - scaled;
+        if (scaled > maxSize * scale)
+            return scaled - maxSize * scale;
+        return 0;
+    case Threshold:
+        if (scaled < (size - threshold) * scale)
+            return minSize * scale - scaled;
+        if (scaled > (size + threshold) * scale)
+            return scaled - maxSize * scale;
+        return 0;
+    }
+
+    return INT_MAX;
+}
+
+/*
+ * IconDirectoryIndex
+ */
+
+/*
+ * Lists the icons of a directory, which doesn't need to exist: its
+ * modification time is recorded either way, so that its creation is
+ * noticed too.
+ */
+void IconDirectoryIndex::add(const QString &dirName, int directory, int baseDir)
+{
+    const QFileInfo info(dirName);
+    mModified.insert(dirName, info.lastModified());
+    if (!info.isDir())
+        return;
+
+    QDirIterator it(dirName, QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+
+        const QString fileName = it.fileName();
+        const qsizetype dot = fileName.lastIndexOf(QLatin1Char('.'));
+        if (dot <= 0)
+            continue;
+
+        const QStringView suffix = QStringView(fileName).mid(dot + 1);
+        for (int extension = 0; extension < 3; ++extension) {
+            if (suffix == QLatin1String(iconExtensions[extension])) {
+                mIcons[fileName.left(dot)].append(File{ directory, baseDir, extension, it.filePath() });
+                break;
+            }
+        }
+    }
+}
+
+void IconDirectoryIndex::clear()
+{
+    mIcons.clear();
+    mModified.clear();
+}
+
+void IconDirectoryIndex::sort()
+{
+    const auto lessThan = [](const File &a, const File &b) {
+        if (a.directory != b.directory)
+            return a.directory < b.directory;
+        if (a.baseDir != b.baseDir)
+            return a.baseDir < b.baseDir;
+        return a.extension < b.extension;
+    };
+
+    for (auto it = mIcons.begin(); it != mIcons.end(); ++it)
+        std::sort(it->begin(), it->end(), lessThan);
+}
+
+bool IconDirectoryIndex::isStale() const
+{
+    for (auto it = mModified.cbegin(); it != mModified.cend(); ++it) {
+        if (QFileInfo(it.key()).lastModified() != it.value())
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * IconTheme
+ */
+
+IconTheme::IconTheme(const QString &name, const QStringList &baseDirs)
+    : mName(name)
+{
+    // The first index.theme found describes the theme. The theme directory
+    // of every base directory is watched, so that the theme is noticed when
+    // it's installed anywhere, even if it's missing now
+    QString indexFileName;
+    for (const QString &baseDir : baseDirs) {
+        const QString dirName = baseDir + QLatin1Char('/') + name;
+        mModified.insert(dirName, QFileInfo(dirName).lastModified());
+
+        const QString fileName = dirName + QStringLiteral("/index.theme");
+        if (indexFileName.isEmpty() && QFileInfo::exists(fileName))
+            indexFileName = fileName;
+    }
+
+    if (indexFileName.isEmpty())
+        return;
+
+    // Editing it doesn't touch the directory
+    mModified.insert(indexFileName, QFileInfo(indexFileName).lastModified());
+
+    DesktopFile index;
+    if (!index.load(indexFileName))
+        return;
+    index.beginGroup(QStringLiteral("Icon Theme"));
+
+    const auto toList = [](const QVariant &value) {
+        // Comma separated, but lists with semicolons are read as such
+        QStringList list;
+        const QStringList parts = value.toStringList();
+        for (const QString &part : parts)
+            list += part.split(QLatin1Char(','), Qt::SkipEmptyParts);
+        for (QString &item : list)
+            item = item.trimmed();
+        return list;
+    };
+
+    mParents = toList(index.value(QStringLiteral("Inherits")));
+    const QStringList paths = toList(index.value(QStringLiteral("Directories")))
+            + toList(index.value(QStringLiteral("ScaledDirectories")));
+
+    index.endGroup();
+
+    for (const QString &path : paths) {
+        const QString group = path + QLatin1Char('/');
+
+        IconThemeDirectory directory;
+        directory.path = path;
+        directory.size = index.value(group + QStringLiteral("Size")).toInt();
+        directory.scale = index.value(group + QStringLiteral("Scale"), 1).toInt();
+        directory.minSize = index.value(group + QStringLiteral("MinSize"), directory.size).toInt();
+        directory.maxSize = index.value(group + QStringLiteral("MaxSize"), directory.size).toInt();
+        directory.threshold = index.value(group + QStringLiteral("Threshold"), 2).toInt();
+
+        const QString type = index.value(group + QStringLiteral("Type")).toString();
+        if (type == QLatin1String("Fixed"))
+            directory.type = IconThemeDirectory::Fixed;
+        else if (type == QLatin1String("Scalable"))
+            directory.type = IconThemeDirectory::Scalable;
+
+        if (directory.size <= 0 || directory.scale <= 0)
+            continue;
+
+        mDirectories.append(directory);
+    }
+
+    for (int i = 0; i < mDirectories.size(); ++i) {
+        for (int b = 0; b < baseDirs.size(); ++b)
+            mIndex.add(QStringLiteral("%1/%2/%3").arg(baseDirs.at(b), name, mDirectories.at(i).path), i, b);
+    }
+    mIndex.sort();
+
+    mValid = true;
+}
+
+bool IconTheme::isStale() const
+{
+    for (auto it = mModified.cbegin(); it != mModified.cend(); ++it) {
+        if (QFileInfo(it.key()).lastModified() != it.value())
+            return true;
+    }
+
+    return mIndex.isStale();
+}
+
+/*
+ * Files of the icon are sorted in the order the specification looks
+ * them up: the first one matching the size is the result, otherwise
+ * the first one of the closest size.
+ */
+QString IconTheme::lookup(const QString &iconName, int size, int scale) const
+{
+    const QVector<IconDirectoryIndex::File> files = mIndex.files(iconName);
+
+    for (const IconDirectoryIndex::File &file : files) {
+        if (mDirectories.at(file.directory).matchesSize(size, scale))
+            return file.fileName;
+    }
+
+    int minimalDistance = INT_MAX;
+    QString closest;
+    for (const IconDirectoryIndex::File &file : files) {
+        const int distance = mDirectories.at(file.directory).sizeDistance(size, scale);
+        if (distance < minimalDistance) {
+            minimalDistance = distance;
+            closest = file.fileName;
+        }
+    }
+
+    return closest;
+}
+
+/*
+ * IconCachePrivate
+ */
+
+IconCachePrivate::IconCachePrivate()
+    : themeName(hicolorTheme)
+    , baseDirs(searchPaths())
+{
+}
+
+/*
+ * Icons are looked for in $HOME/.icons, in $XDG_DATA_DIRS/icons
+ * and in /usr/share/pixmaps, in that order.
+ */
+QStringList IconCachePrivate::searchPaths()
+{
+    QStringList dirs;
+    dirs.append(QDir::homePath() + QStringLiteral("/.icons"));
+    dirs.append(XdgDirs::dataHome(false) + QStringLiteral("/icons"));
+    dirs.append(XdgDirs::dataDirs(QStringLiteral("/icons")));
+    dirs.append(QStringLiteral("/usr/share/pixmaps"));
+    dirs.removeDuplicates();
+    return dirs;
+}
+
+IconTheme *IconCachePrivate::theme(const QString &name)
+{
+    auto it = themes.find(name);
+    if (it == themes.end())
+        it = themes.insert(name, std::make_shared<IconTheme>(name, baseDirs));
+    return it->get();
+}
+
+QString IconCachePrivate::lookup(const QString &iconName, int size, int scale, const QString &themeName)
+{
+    checkForChanges();
+
+    const IconCacheKey key{ iconName, size, scale, themeName };
+    auto it = results.constFind(key);
+    if (it != results.constEnd())
+        return it.value();
+
+    QString result;
+    if (QDir::isAbsolutePath(iconName)) {
+        if (QFileInfo::exists(iconName))
+            result = iconName;
+    } else if (!iconName.isEmpty()) {
+        // Some entries wrongly name the file rather than the icon
+        QString name = iconName;
+        for (const char *extension : iconExtensions) {
+            if (name.endsWith(QLatin1Char('.') + QLatin1String(extension))) {
+                name.chop(int(qstrlen(extension)) + 1);
+                break;
+            }
+        }
+
+        QStringList visited;
+        result = lookupInTheme(name, size, scale, themeName, &visited);
+        if (result.isEmpty())
+            result = lookupInTheme(name, size, scale, hicolorTheme, &visited);
+
+        if (result.isEmpty()) {
+            if (!unthemedReady)
+                indexUnthemed();
+
+            const QVector<IconDirectoryIndex::File> files = unthemed.files(name);
+            if (!files.isEmpty())
+                result = files.first().fileName;
+        }
+    }
+
+    // Icons that are not found are remembered as well
+    results.insert(key, result);
+    return result;
+}
+
+/*
+ * Looks in the theme, then in the themes it inherits from, depth first.
+ */
+QString IconCachePrivate::lookupInTheme(const QString &iconName, int size, int scale,
+                                        const QString &themeName, QStringList *visited)
+{
+    if (themeName.isEmpty() || visited->contains(themeName))
+        return QString();
+    visited->append(themeName);
+
+    IconTheme *current = theme(themeName);
+    if (!current->isValid())
+        return QString();
+
+    const QString result = current->lookup(iconName, size, scale);
+    if (!result.isEmpty())
+        return result;
+
+    const QStringList parents = current->parents();
+    for (const QString &parent : parents) {
+        const QString inherited = lookupInTheme(iconName, size, scale, parent, visited);
+        if (!inherited.isEmpty())
+            return inherited;
+    }
+
+    return QString();
+}
+
+// Icons right in the base directories, such as /usr/share/pixmaps
+void IconCachePrivate::indexUnthemed()
+{
+    unthemed.clear();
+    for (int b = 0; b < baseDirs.size(); ++b)
+        unthemed.add(baseDirs.at(b), 0, b);
+    unthemed.sort();
+    unthemedReady = true;
+}
+
+/*
+ * Themes whose index.theme or directories changed are built again,
+ * and the results are forgotten.
+ */
+void IconCachePrivate::checkForChanges()
+{
+    if (lastCheck.isValid() && lastCheck.elapsed() < ICON_CACHE_CHECK_INTERVAL)
+        return;
+    const bool firstCheck = !lastCheck.isValid();
+    lastCheck.start();
+
+    if (firstCheck)
+        return;
+
+    bool changed = false;
+
+    for (auto it = themes.begin(); it != themes.end(); ++it) {
+        if (it.value()->isStale()) {
+            it.value() = std::make_shared<IconTheme>(it.key(), baseDirs);
+            changed = true;
+        }
+    }
+
+    if (unthemedReady && unthemed.isStale()) {
+        indexUnthemed();
+        changed = true;
+    }
+
+    if (changed)
+        results.clear();
+}
+
+/*
+ * IconCache
+ */
+
+IconCache::IconCache()
+    : d_ptr(new IconCachePrivate())
+{
+}
+
+IconCache::~IconCache()
+{
+    delete d_ptr;
+}
+
+IconCache *IconCache::instance()
+{
+    return s_iconCache();
+}
+
+QString IconCache::themeName()
+{
+    IconCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->themeName;
+}
+
+void IconCache::setThemeName(const QString &themeName)
+{
+    IconCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    d->themeName = themeName.isEmpty() ? hicolorTheme : themeName;
+}
+
+QString IconCache::lookup(const QString &iconName, int size, int scale, const QString &themeName)
+{
+    IconCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    return d->lookup(iconName, size, scale, themeName.isEmpty() ? d->themeName : themeName);
+}
+
+QString IconCache::lookup(const DesktopFile &file, int size, int scale, const QString &themeName)
+{
+    return lookup(file.iconName(), size, scale, themeName);
+}
+
+void IconCache::clear()
+{
+    IconCachePrivate *d = instance()->d_ptr;
+    QMutexLocker locker(&d->mutex);
+    d->themes.clear();
+    d->unthemed.clear();
+    d->unthemedReady = false;
+    d->results.clear();
+    d->lastCheck.invalidate();
+}
+
+} // namespace Liri
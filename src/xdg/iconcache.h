@@ -0,0 +1,53 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_ICONCACHE_H
+#define LIRI_ICONCACHE_H
+
+#include <LiriXdg/DesktopFile>
+
+namespace Liri {
+
+class IconCachePrivate;
+
+/*!
+ * Resolves icon names to files following the "Icon Theme Specification"
+ * from freedesktop.org, and remembers the results.
+ *
+ * The directories of each theme are listed once, according to its
+ * index.theme, so that a lookup is a hash lookup instead of a file
+ * system probe per directory. The modification times of the directories
+ * are checked every few seconds and the directories that changed are
+ * listed again.
+ *
+ * @sa https://specifications.freedesktop.org/icon-theme-spec/latest/
+ */
+class LIRIXDG_EXPORT IconCache
+{
+public:
+    explicit IconCache();
+    ~IconCache();
+
+    static IconCache *instance();
+
+    //! Theme used when lookup() is called without one, "hicolor" by default
+    static QString themeName();
+    static void setThemeName(const QString &themeName);
+
+    //! Path of the icon, or an empty string when no theme has it
+    static QString lookup(const QString &iconName, int size, int scale = 1,
+                          const QString &themeName = QString());
+    static QString lookup(const DesktopFile &file, int size, int scale = 1,
+                          const QString &themeName = QString());
+
+    //! Forgets the results and the directory listings
+    static void clear();
+
+private:
+    IconCachePrivate *const d_ptr;
+};
+
+} // namespace Liri
+
+#endif // LIRI_ICONCACHE_H
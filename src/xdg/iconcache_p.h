@@ -0,0 +1,148 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef LIRI_ICONCACHE_P_H
+#define LIRI_ICONCACHE_P_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include <memory>
+
+#include "iconcache.h"
+
+// The directories are checked for changes at most this often
+#define ICON_CACHE_CHECK_INTERVAL 5000
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Liri API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace Liri {
+
+struct IconThemeDirectory {
+    enum Type {
+        Fixed,
+        Scalable,
+        Threshold,
+    };
+
+    QString path;
+    Type type = Threshold;
+    int size = 0;
+    int scale = 1;
+    int minSize = 0;
+    int maxSize = 0;
+    int threshold = 2;
+
+    bool matchesSize(int iconSize, int iconScale) const;
+    int sizeDistance(int iconSize, int iconScale) const;
+};
+
+/*
+ * Icons of a directory listing, by name without extension. The files
+ * of an icon are sorted in lookup order: theme directory, base
+ * directory, then extension.
+ */
+class IconDirectoryIndex
+{
+public:
+    struct File {
+        int directory;
+        int baseDir;
+        int extension;
+        QString fileName;
+    };
+
+    void add(const QString &dirName, int directory, int baseDir);
+    void clear();
+    void sort();
+
+    bool isStale() const;
+
+    QVector<File> files(const QString &iconName) const { return mIcons.value(iconName); }
+
+private:
+    QHash<QString, QVector<File>> mIcons;
+    QHash<QString, QDateTime> mModified;
+};
+
+class IconTheme
+{
+public:
+    explicit IconTheme(const QString &name, const QStringList &baseDirs);
+
+    QString name() const { return mName; }
+    QStringList parents() const { return mParents; }
+    bool isValid() const { return mValid; }
+
+    bool isStale() const;
+
+    QString lookup(const QString &iconName, int size, int scale) const;
+
+private:
+    QString mName;
+    QHash<QString, QDateTime> mModified;
+    bool mValid = false;
+    QStringList mParents;
+    QVector<IconThemeDirectory> mDirectories;
+    IconDirectoryIndex mIndex;
+};
+
+struct IconCacheKey {
+    QString iconName;
+    int size;
+    int scale;
+    QString themeName;
+
+    bool operator==(const IconCacheKey &other) const
+    {
+        return size == other.size && scale == other.scale
+                && iconName == other.iconName && themeName == other.themeName;
+    }
+};
+
+inline size_t qHash(const IconCacheKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.iconName, key.size, key.scale, key.themeName);
+}
+
+class IconCachePrivate
+{
+public:
+    explicit IconCachePrivate();
+
+    static QStringList searchPaths();
+
+    IconTheme *theme(const QString &name);
+    QString lookup(const QString &iconName, int size, int scale, const QString &themeName);
+    QString lookupInTheme(const QString &iconName, int size, int scale,
+                          const QString &themeName, QStringList *visited);
+    void indexUnthemed();
+    void checkForChanges();
+
+    // Held by the static accessors of IconCache
+    QMutex mutex;
+    QString themeName;
+    QStringList baseDirs;
+    QHash<QString, std::shared_ptr<IconTheme>> themes;
+    IconDirectoryIndex unthemed;
+    bool unthemedReady = false;
+    QHash<IconCacheKey, QString> results;
+    QElapsedTimer lastCheck;
+};
+
+} // namespace Liri
+
+#endif // LIRI_ICONCACHE_P_H
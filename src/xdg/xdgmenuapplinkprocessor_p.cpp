@@ -7,7 +7,9 @@
 #include "xmlhelper_p_p.h"
 #include "desktopfile.h"
 
+#include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
 
 namespace Liri {
 
@@ -16,6 +18,8 @@ XdgMenuApplinkProcessor::XdgMenuApplinkProcessor(QDomElement &element, Liri::Des
     , mElement(element)
     , mParent(parent)
     , mMenu(menu)
+    , mAtoms(parent ? parent->mAtoms : QSharedPointer<XdgMenuCategoryAtoms>::create())
+    , mRules(mAtoms.data())
 {
     mOnlyUnallocated = element.attribute(QStringLiteral("onlyUnallocated")) == QStringLiteral("1");
 
@@ -42,20 +46,31 @@ void XdgMenuApplinkProcessor::step1()
     createRules();
 
     // Check Include rules & mark as allocated ............
+    XdgMenuRuleAppSet apps;
+    QVector<XdgMenuAppFileInfo *> fileInfos;
+    apps.reserve(mAppFileInfoHash.count());
+    fileInfos.reserve(mAppFileInfoHash.count());
+
     XdgMenuAppFileInfoHashIterator i = mAppFileInfoHash.begin();
     while (i != mAppFileInfoHash.end()) {
-        Liri::DesktopFile *file = i.value()->desktopFile();
+        apps.append(i.key(), i.value()->categories());
+        fileInfos.append(i.value());
+        ++i;
+    }
 
-        if (mRules.checkInclude(i.key(), *file)) {
-            if (!mOnlyUnallocated)
-                i.value()->setAllocated(true);
+    const QBitArray included = mRules.checkInclude(apps);
+    const QBitArray excluded = mRules.checkExclude(apps);
 
-            if (!mRules.checkExclude(i.key(), *file)) {
-                mSelected.append(i.value());
-            }
-        }
+    const int N = fileInfos.count();
+    for (int n = 0; n < N; ++n) {
+        if (!included.testBit(n))
+            continue;
 
-        ++i;
+        if (!mOnlyUnallocated)
+            fileInfos.at(n)->setAllocated(true);
+
+        if (!excluded.testBit(n))
+            mSelected.append(fileInfos.at(n));
     }
 
     // Process childs menus ...............................
@@ -66,23 +81,47 @@ void XdgMenuApplinkProcessor::step1()
 
 void XdgMenuApplinkProcessor::step2()
 {
-    // Create AppLinks elements ...........................
+    createAppLinks();
+
+    // Process childs menus ...............................
+    for (XdgMenuApplinkProcessor *child : const_cast<const QLinkedList<XdgMenuApplinkProcessor *> &>(mChilds))
+        child->step2();
+}
+
+/************************************************
+ Create AppLinks elements for this menu only, step1() must have
+ been run on the whole tree for allocation to be known.
+ ************************************************/
+void XdgMenuApplinkProcessor::createAppLinks()
+{
     QDomDocument doc = mElement.ownerDocument();
+    const QStringList envs = mMenu->environments();
+    const QStringList previews = mMenu->previewEnvironments();
 
     for (XdgMenuAppFileInfo *fileInfo : const_cast<const QLinkedList<XdgMenuAppFileInfo *> &>(mSelected)) {
         if (mOnlyUnallocated && fileInfo->allocated())
             continue;
 
         Liri::DesktopFile *file = fileInfo->desktopFile();
+        if (!file->isVisible())
+            continue;
 
+        // One bit per preview environment, otherwise any of the current ones
+        quint64 mask = 0;
         bool show = false;
-        QStringList envs = mMenu->environments();
-        const int N = envs.size();
-        for (int i = 0; i < N; ++i) {
-            if (file->isVisible() && file->isSuitable(envs.at(i))) {
-                show = true;
-                break;
+        if (previews.isEmpty()) {
+            for (const QString &env : envs) {
+                if (file->isSuitable(env)) {
+                    show = true;
+                    break;
+                }
+            }
+        } else {
+            for (int i = 0; i < previews.size() && i < 64; ++i) {
+                if (file->isSuitable(previews.at(i)))
+                    mask |= quint64(1) << i;
             }
+            show = mask != 0;
         }
 
         if (!show)
@@ -100,13 +139,55 @@ void XdgMenuApplinkProcessor::step2()
         appLink.setAttribute(QStringLiteral("path"), file->path());
         appLink.setAttribute(QStringLiteral("icon"), file->iconName());
         appLink.setAttribute(QStringLiteral("desktopFile"), file->fileName());
+        if (!previews.isEmpty())
+            appLink.setAttribute(QStringLiteral("visibleIn"), QString::number(mask));
 
         mElement.appendChild(appLink);
     }
+}
 
-    // Process childs menus ...............................
-    for (XdgMenuApplinkProcessor *child : const_cast<const QLinkedList<XdgMenuApplinkProcessor *> &>(mChilds))
-        child->step2();
+/************************************************
+ Returns whether this menu or any of its sub-menus selected entries
+ that survive the allocation. Entries might still be hidden when
+ their AppLinks are created.
+ ************************************************/
+bool XdgMenuApplinkProcessor::hasCandidates() const
+{
+    for (XdgMenuAppFileInfo *fileInfo : mSelected) {
+        if (!mOnlyUnallocated || !fileInfo->allocated())
+            return true;
+    }
+
+    for (XdgMenuApplinkProcessor *child : mChilds) {
+        if (child->hasCandidates())
+            return true;
+    }
+
+    return false;
+}
+
+/************************************************
+ Hashes the entries selected by this menu and its sub-menus, by id,
+ file and modification time, once step1() has run on the whole tree.
+ Entries are combined regardless of their order, which depends on
+ the hash of desktop-file ids.
+ ************************************************/
+size_t XdgMenuApplinkProcessor::selectionHash(size_t seed) const
+{
+    size_t selected = 0;
+    for (XdgMenuAppFileInfo *fileInfo : mSelected) {
+        if (mOnlyUnallocated && fileInfo->allocated())
+            continue;
+
+        const QString fileName = fileInfo->desktopFile()->fileName();
+        selected += qHashMulti(0, fileInfo->id(), fileName,
+                               QFileInfo(fileName).lastModified().toMSecsSinceEpoch());
+    }
+
+    seed = qHashMulti(seed, selected);
+    for (XdgMenuApplinkProcessor *child : mChilds)
+        seed = child->selectionHash(seed);
+    return seed;
 }
 
 /************************************************
@@ -152,7 +233,9 @@ void XdgMenuApplinkProcessor::findDesktopFiles(const QString &dirName, const QSt
     for (const QFileInfo &file : files) {
         Liri::DesktopFile *f = Liri::DesktopFileCache::getFile(file.canonicalFilePath());
         if (f)
-            mAppFileInfoHash.insert(prefix + file.fileName(), new XdgMenuAppFileInfo(f, prefix + file.fileName(), this));
+            mAppFileInfoHash.insert(prefix + file.fileName(),
+                                    new XdgMenuAppFileInfo(f, prefix + file.fileName(),
+                                                           mAtoms->categories(f->categories()), this));
     }
 
     // Working recursively ............
@@ -11,6 +11,7 @@
 #include <QLinkedList>
 #include <QString>
 #include <QHash>
+#include <QSharedPointer>
 
 namespace Liri {
 
@@ -32,9 +33,16 @@ public:
     virtual ~XdgMenuApplinkProcessor();
     void run();
 
-protected:
     void step1();
     void step2();
+    void createAppLinks();
+    bool hasCandidates() const;
+    size_t selectionHash(size_t seed = 0) const;
+
+    QDomElement element() const { return mElement; }
+    QLinkedList<XdgMenuApplinkProcessor *> childs() const { return mChilds; }
+
+protected:
     void fillAppFileInfoList();
     void findDesktopFiles(const QString &dirName, const QString &prefix);
 
@@ -51,6 +59,7 @@ private:
     bool mOnlyUnallocated;
 
     Liri::DesktopMenu *mMenu;
+    QSharedPointer<XdgMenuCategoryAtoms> mAtoms;
     XdgMenuRules mRules;
 };
 
@@ -58,15 +67,18 @@ class XdgMenuAppFileInfo : public QObject
 {
     Q_OBJECT
 public:
-    explicit XdgMenuAppFileInfo(Liri::DesktopFile *desktopFile, const QString &id, QObject *parent)
+    explicit XdgMenuAppFileInfo(Liri::DesktopFile *desktopFile, const QString &id,
+                                const QBitArray &categories, QObject *parent)
         : QObject(parent)
         , mDesktopFile(desktopFile)
         , mAllocated(false)
         , mId(id)
+        , mCategories(categories)
     {
     }
 
     Liri::DesktopFile *desktopFile() const { return mDesktopFile; }
+    QBitArray categories() const { return mCategories; }
     bool allocated() const { return mAllocated; }
     void setAllocated(bool value) { mAllocated = value; }
     QString id() const { return mId; }
@@ -75,6 +87,7 @@ private:
     Liri::DesktopFile *mDesktopFile;
     bool mAllocated;
     QString mId;
+    QBitArray mCategories;
 };
 
 } // namespace Liri
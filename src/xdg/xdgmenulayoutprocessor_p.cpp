@@ -5,21 +5,17 @@
 #include "xdgmenulayoutprocessor_p_p.h"
 #include "xmlhelper_p_p.h"
 #include <QDebug>
-#include <QMap>
+
+#include <algorithm>
 
 namespace Liri {
 
 // Helper functions prototypes
 QDomElement findLastElementByTag(const QDomElement &element, const QString &tagName);
-int childsCount(const QDomElement &element);
 
 QDomElement findLastElementByTag(const QDomElement &element, const QString &tagName)
 {
-    QDomNodeList l = element.elementsByTagName(tagName);
-    if (l.isEmpty())
-        return QDomElement();
-
-    return l.at(l.length() - 1).toElement();
+    return element.lastChildElement(tagName);
 }
 
 /************************************************
@@ -111,20 +107,45 @@ void XdgMenuLayoutProcessor::setParams(QDomElement defaultLayout, LayoutParams *
         result->mInlineAlias = defaultLayout.attribute(QStringLiteral("inline_alias")) == QLatin1String("true");
 }
 
-QDomElement XdgMenuLayoutProcessor::searchElement(const QString &tagName, const QString &attributeName, const QString &attributeValue) const
+void XdgMenuLayoutProcessor::indexChildren()
 {
-    DomElementIterator it(mElement, tagName);
+    mChildren.clear();
+    mAppLinks.clear();
+    mMenus.clear();
+
+    DomElementIterator it(mElement);
     while (it.hasNext()) {
-        QDomElement e = it.next();
-        if (e.attribute(attributeName) == attributeValue) {
-            return e;
+        const QDomElement e = it.next();
+        if (e.tagName() == QLatin1String("AppLink"))
+            mAppLinks[e.attribute(QStringLiteral("id"))].append(mChildren.count());
+        else if (e.tagName() == QLatin1String("Menu"))
+            mMenus[e.attribute(QStringLiteral("name"))].append(mChildren.count());
+        else
+            continue;
+        mChildren.append(e);
+    }
+
+    mPlaced.fill(false, mChildren.count());
+}
+
+/************************************************
+ Returns the first element with the given key the layout
+ didn't place yet, and marks it as placed.
+ ************************************************/
+QDomElement XdgMenuLayoutProcessor::take(const QHash<QString, QList<int>> &index, const QString &key)
+{
+    const QList<int> rows = index.value(key);
+    for (int row : rows) {
+        if (!mPlaced.at(row)) {
+            mPlaced[row] = true;
+            return mChildren.at(row);
         }
     }
 
     return QDomElement();
 }
 
-int childsCount(const QDomElement &element)
+int XdgMenuLayoutProcessor::childsCount(const QDomElement &element)
 {
     int count = 0;
     DomElementIterator it(element);
@@ -139,10 +160,6 @@ int childsCount(const QDomElement &element)
 
 void XdgMenuLayoutProcessor::run()
 {
-    QDomDocument doc = mLayout.ownerDocument();
-    mResult = doc.createElement(QStringLiteral("Result"));
-    mElement.appendChild(mResult);
-
     // Process childs menus ...............................
     {
         DomElementIterator it(mElement, QStringLiteral("Menu"));
@@ -153,6 +170,19 @@ void XdgMenuLayoutProcessor::run()
         }
     }
 
+    layout();
+}
+
+/************************************************
+ Lays out this menu only, its sub-menus are left untouched.
+ Elements are looked up in an index of the children and
+ moved once, in their final order, to the end of the menu.
+ ************************************************/
+void XdgMenuLayoutProcessor::layout()
+{
+    indexChildren();
+    mResult.clear();
+
     // Step 1 ...................................
     DomElementIterator it(mLayout);
     it.toFront();
@@ -168,30 +198,26 @@ void XdgMenuLayoutProcessor::run()
         else if (e.tagName() == QLatin1String("Separator"))
             processSeparatorTag(e);
 
-        else if (e.tagName() == QLatin1String("Merge")) {
-            QDomElement merge = mResult.ownerDocument().createElement(QStringLiteral("Merge"));
-            merge.setAttribute(QStringLiteral("type"), e.attribute(QStringLiteral("type")));
-            mResult.appendChild(merge);
-        }
+        else if (e.tagName() == QLatin1String("Merge"))
+            mResult.append(ResultItem{ QDomElement(), true, e.attribute(QStringLiteral("type")) });
     }
 
     // Step 2 ...................................
-    {
-        MutableDomElementIterator ri(mResult, QStringLiteral("Merge"));
-        while (ri.hasNext()) {
-            processMergeTag(ri.next());
-        }
+    QList<QDomElement> result;
+    result.reserve(mChildren.count());
+    for (const ResultItem &item : const_cast<const QList<ResultItem> &>(mResult)) {
+        if (item.isMerge)
+            processMergeTag(item.mergeType, &result);
+        else
+            result.append(item.element);
     }
+    mResult.clear();
 
-    // Move result cilds to element .............
-    MutableDomElementIterator ri(mResult);
-    while (ri.hasNext()) {
-        mElement.appendChild(ri.next());
-    }
+    // Move result to element ...................
+    for (QDomElement &e : result)
+        mElement.appendChild(e);
 
     // Final ....................................
-    mElement.removeChild(mResult);
-
     if (mLayout.parentNode() == mElement)
         mElement.removeChild(mLayout);
 
@@ -207,9 +233,9 @@ void XdgMenuLayoutProcessor::processFilenameTag(const QDomElement &element)
 {
     QString id = element.text();
 
-    QDomElement appLink = searchElement(QStringLiteral("AppLink"), QStringLiteral("id"), id);
+    QDomElement appLink = take(mAppLinks, id);
     if (!appLink.isNull())
-        mResult.appendChild(appLink);
+        mResult.append(ResultItem{ appLink, false, QString() });
 }
 
 /************************************************
@@ -247,19 +273,19 @@ void XdgMenuLayoutProcessor::processFilenameTag(const QDomElement &element)
 void XdgMenuLayoutProcessor::processMenunameTag(const QDomElement &element)
 {
     QString id = element.text();
-    QDomElement menu = searchElement(QStringLiteral("Menu"), QStringLiteral("name"), id);
+    QDomElement menu = take(mMenus, id);
     if (menu.isNull())
         return;
 
     LayoutParams params = mDefaultParams;
     setParams(element, &params);
 
-    int count = childsCount(menu);
+    int count = mCountFunction ? mCountFunction(menu, params.mInline) : childsCount(menu);
 
     if (count == 0) {
         if (params.mShowEmpty) {
             menu.setAttribute(QStringLiteral("keep"), QStringLiteral("true"));
-            mResult.appendChild(menu);
+            mResult.append(ResultItem{ menu, false, QString() });
         }
         return;
     }
@@ -271,7 +297,7 @@ void XdgMenuLayoutProcessor::processMenunameTag(const QDomElement &element)
     bool doHeader = params.mInlineHeader && doInline && !doAlias;
 
     if (!doInline) {
-        mResult.appendChild(menu);
+        mResult.append(ResultItem{ menu, false, QString() });
         return;
     }
 
@@ -284,7 +310,7 @@ void XdgMenuLayoutProcessor::processMenunameTag(const QDomElement &element)
             header.setAttributeNode(attrs.item(i).toAttr());
         }
 
-        mResult.appendChild(header);
+        mResult.append(ResultItem{ header, false, QString() });
     }
 
     // Alias .....................................
@@ -293,9 +319,9 @@ void XdgMenuLayoutProcessor::processMenunameTag(const QDomElement &element)
     }
 
     // Inline ....................................
-    MutableDomElementIterator it(menu);
+    DomElementIterator it(menu);
     while (it.hasNext()) {
-        mResult.appendChild(it.next());
+        mResult.append(ResultItem{ it.next(), false, QString() });
     }
 }
 
@@ -307,7 +333,7 @@ void XdgMenuLayoutProcessor::processMenunameTag(const QDomElement &element)
 void XdgMenuLayoutProcessor::processSeparatorTag(const QDomElement &element)
 {
     QDomElement separator = element.ownerDocument().createElement(QStringLiteral("Separator"));
-    mResult.appendChild(separator);
+    mResult.append(ResultItem{ separator, false, QString() });
 }
 
 /************************************************
@@ -326,26 +352,30 @@ void XdgMenuLayoutProcessor::processSeparatorTag(const QDomElement &element)
     mentioned should be inserted in alphabetical order of their visual caption at this point.
 
  ************************************************/
-void XdgMenuLayoutProcessor::processMergeTag(const QDomElement &element)
+void XdgMenuLayoutProcessor::processMergeTag(const QString &type, QList<QDomElement> *result)
 {
-    QString type = element.attribute(QStringLiteral("type"));
-    QMap<QString, QDomElement> map;
-    MutableDomElementIterator it(mElement);
-
-    while (it.hasNext()) {
-        QDomElement e = it.next();
-        if (
-                ((type == QLatin1String("menus") || type == QLatin1String("all")) && e.tagName() == QLatin1String("Menu")) || ((type == QLatin1String("files") || type == QLatin1String("all")) && e.tagName() == QLatin1String("AppLink")))
-            map.insert(e.attribute(QStringLiteral("title")), e);
+    const bool menus = type == QLatin1String("menus") || type == QLatin1String("all");
+    const bool files = type == QLatin1String("files") || type == QLatin1String("all");
+
+    QList<QPair<QString, QDomElement>> merged;
+    for (int i = 0; i < mChildren.count(); ++i) {
+        if (mPlaced.at(i))
+            continue;
+
+        const QDomElement &e = mChildren.at(i);
+        const bool isMenu = e.tagName() == QLatin1String("Menu");
+        if ((menus && isMenu) || (files && !isMenu)) {
+            mPlaced[i] = true;
+            merged.append(qMakePair(e.attribute(QStringLiteral("title")), e));
+        }
     }
 
-    QMap<QString, QDomElement>::const_iterator mi = map.constBegin();
-    while (mi != map.constEnd()) {
-         mResult.insertBefore(mi.value(), element);
-        ++mi;
-    }
+    std::stable_sort(merged.begin(), merged.end(), [](const QPair<QString, QDomElement> &a, const QPair<QString, QDomElement> &b) {
+        return a.first < b.first;
+    });
 
-    mResult.removeChild(element);
+    for (const auto &item : const_cast<const QList<QPair<QString, QDomElement>> &>(merged))
+        result->append(item.second);
 }
 
 } // namespace Liri
@@ -6,7 +6,11 @@
 #define QTXDG_XDGMENULAYOUTPROCESSOR_H
 
 #include <QtXml/QDomElement>
+#include <QHash>
 #include <QList>
+#include <QVector>
+
+#include <functional>
 
 namespace Liri {
 
@@ -66,25 +70,50 @@ struct LayoutParams {
 class XdgMenuLayoutProcessor
 {
 public:
+    /*
+     * Returns the number of entries of a sub-menu, inlined is true when
+     * the sub-menu contents are about to be copied into its parent.
+     */
+    typedef std::function<int(QDomElement &menu, bool inlined)> CountFunction;
+
     XdgMenuLayoutProcessor(QDomElement &element);
+    XdgMenuLayoutProcessor(QDomElement &element, XdgMenuLayoutProcessor *parent);
     void run();
+    void layout();
 
-protected:
-    XdgMenuLayoutProcessor(QDomElement &element, XdgMenuLayoutProcessor *parent);
+    void setCountFunction(const CountFunction &function) { mCountFunction = function; }
+
+    static int childsCount(const QDomElement &element);
 
 private:
+    // A placed element, or a <Merge> still to be expanded
+    struct ResultItem {
+        QDomElement element;
+        bool isMerge;
+        QString mergeType;
+    };
+
     void setParams(QDomElement defaultLayout, LayoutParams *result);
-    QDomElement searchElement(const QString &tagName, const QString &attributeName, const QString &attributeValue) const;
+    void indexChildren();
+    QDomElement take(const QHash<QString, QList<int>> &index, const QString &key);
     void processFilenameTag(const QDomElement &element);
     void processMenunameTag(const QDomElement &element);
     void processSeparatorTag(const QDomElement &element);
-    void processMergeTag(const QDomElement &element);
+    void processMergeTag(const QString &type, QList<QDomElement> *result);
 
     LayoutParams mDefaultParams;
-    QDomElement &mElement;
+    CountFunction mCountFunction;
+    QDomElement mElement;
     QDomElement mDefaultLayout;
     QDomElement mLayout;
-    QDomElement mResult;
+
+    // AppLinks and sub-menus of mElement in document order, indexed
+    // by id and name, and whether the layout placed them already
+    QList<QDomElement> mChildren;
+    QVector<bool> mPlaced;
+    QHash<QString, QList<int>> mAppLinks;
+    QHash<QString, QList<int>> mMenus;
+    QList<ResultItem> mResult;
 };
 
 } // namespace Liri
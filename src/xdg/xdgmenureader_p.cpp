@@ -4,6 +4,7 @@
 
 #include "xdgmenureader_p_p.h"
 #include "desktopmenu.h"
+#include "desktopmenu_p.h"
 #include "xdgdirs_p_p.h"
 #include "xmlhelper_p_p.h"
 
@@ -12,17 +13,56 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QString>
+#include <QXmlStreamReader>
+#include <QtXml/QDomDocumentFragment>
 #include <QtXml/QDomNamedNodeMap>
 #include <QtXml/QDomNode>
 
 namespace Liri {
 
+Q_GLOBAL_STATIC(XdgMenuFragmentCache, s_fragmentCache)
+
+XdgMenuFragmentCache *XdgMenuFragmentCache::instance()
+{
+    return s_fragmentCache();
+}
+
+bool XdgMenuFragmentCache::find(const QString &canonicalFileName, const QDateTime &lastModified,
+                                qint64 size, XdgMenuFragment *fragment) const
+{
+    QMutexLocker locker(&mMutex);
+
+    auto it = mEntries.constFind(canonicalFileName);
+    if (it == mEntries.constEnd() || it->lastModified != lastModified || it->size != size)
+        return false;
+
+    *fragment = it->fragment;
+    return true;
+}
+
+void XdgMenuFragmentCache::insert(const QString &canonicalFileName, const QDateTime &lastModified,
+                                  qint64 size, const XdgMenuFragment &fragment)
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.insert(canonicalFileName, Entry { lastModified, size, fragment });
+}
+
+void XdgMenuFragmentCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.clear();
+}
+
 XdgMenuReader::XdgMenuReader(Liri::DesktopMenu *menu, XdgMenuReader *parentReader, QObject *parent)
     : QObject(parent), mMenu(menu)
 {
     mParentReader = parentReader;
-    if (mParentReader)
+    if (mParentReader) {
         mBranchFiles << mParentReader->mBranchFiles;
+        // Merged files are parsed straight into the document of the
+        // top level menu file, there is no need to import them later
+        mXml = mParentReader->mXml;
+    }
 }
 
 XdgMenuReader::~XdgMenuReader()
@@ -36,37 +76,51 @@ bool XdgMenuReader::load(const QString &fileName, const QString &baseDir)
         return false;
     }
 
-    QFileInfo fileInfo(QDir(baseDir), fileName);
+    mFileName = QFileInfo(QDir(baseDir), fileName).canonicalFilePath();
 
-    mFileName = fileInfo.canonicalFilePath();
-    mDirName = fileInfo.canonicalPath();
+    const QFileInfo fileInfo(mFileName);
+    mDirName = fileInfo.absolutePath();
 
     if (mBranchFiles.contains(mFileName))
         return false; // Recursive loop detected
 
     mBranchFiles << mFileName;
 
-    QFile file(mFileName);
-    if (!file.open(QFile::ReadOnly | QFile::Text)) {
-        mErrorStr = QStringLiteral("%1 not loading: %2").arg(fileName, file.errorString());
-        return false;
+    DesktopMenuPrivate *menu = mMenu->d_func();
+    const DesktopMenuProfileMark mark = menu->profileMark();
+
+    // Parse the file unless it didn't change since the last time
+    XdgMenuFragment fragment;
+    XdgMenuFragmentCache *cache = XdgMenuFragmentCache::instance();
+    if (!cache->find(mFileName, fileInfo.lastModified(), fileInfo.size(), &fragment)) {
+        QFile file(mFileName);
+        if (!file.open(QFile::ReadOnly | QFile::Text)) {
+            mErrorStr = QStringLiteral("%1 not loading: %2").arg(fileName, file.errorString());
+            return false;
+        }
+
+        if (!parse(&file, &fragment))
+            return false;
+
+        cache->insert(mFileName, fileInfo.lastModified(), fileInfo.size(), fragment);
     }
     //qDebug() << "Load file:" << mFileName;
     mMenu->addWatchPath(mFileName);
 
-    QString errorStr;
-    int errorLine;
-    int errorColumn;
+    // Merged files are moved into place by mergeFile(), while the
+    // top level menu file becomes the document element
+    QDomNode container = mXml.createDocumentFragment();
+    build(fragment, container);
 
-    if (!mXml.setContent(&file, true, &errorStr, &errorLine, &errorColumn)) {
-        mErrorStr = QStringLiteral("Parse error at line %1, column %2:\n%3")
-                            .arg(errorLine)
-                            .arg(errorColumn)
-                            .arg(errorStr);
+    mRoot = container.firstChildElement();
+    QDomElement &root = mRoot;
+    if (root.isNull()) {
+        mErrorStr = QStringLiteral("%1 has no root element").arg(fileName);
         return false;
     }
 
-    QDomElement root = mXml.documentElement();
+    if (!mParentReader)
+        mXml.appendChild(root);
 
     QDomElement debugElement = mXml.createElement(QStringLiteral("FileInfo"));
     debugElement.setAttribute(QStringLiteral("file"), mFileName);
@@ -77,9 +131,79 @@ bool XdgMenuReader::load(const QString &fileName, const QString &baseDir)
     root.insertBefore(debugElement, null);
 
     processMergeTags(root);
+
+    menu->addProfileEntry(mFileName, QStringLiteral("file"), mark, static_cast<int>(fragment.count()));
     return true;
 }
 
+/************************************************
+ Reads the XML stream into a flat list of nodes, whitespace-only text
+ is dropped like QDomDocument::setContent() does.
+ ************************************************/
+bool XdgMenuReader::parse(QIODevice *device, XdgMenuFragment *fragment)
+{
+    QXmlStreamReader xml(device);
+    int depth = 0;
+
+    while (!xml.atEnd()) {
+        switch (xml.readNext()) {
+        case QXmlStreamReader::StartElement: {
+            XdgMenuFragmentNode node { depth++, xml.name().toString(), QString(), {} };
+            const QXmlStreamAttributes attributes = xml.attributes();
+            for (const QXmlStreamAttribute &attribute : attributes)
+                node.attributes.append(qMakePair(attribute.qualifiedName().toString(),
+                                                 attribute.value().toString()));
+            fragment->append(node);
+            break;
+        }
+        case QXmlStreamReader::EndElement:
+            --depth;
+            break;
+        case QXmlStreamReader::Characters:
+            if (!xml.isWhitespace())
+                fragment->append(XdgMenuFragmentNode { depth, QString(), xml.text().toString(), {} });
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (xml.hasError()) {
+        mErrorStr = QStringLiteral("Parse error at line %1, column %2:\n%3")
+                            .arg(xml.lineNumber())
+                            .arg(xml.columnNumber())
+                            .arg(xml.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+/************************************************
+ Creates the nodes directly with the document of the top level
+ menu file.
+ ************************************************/
+void XdgMenuReader::build(const XdgMenuFragment &fragment, QDomNode &parentNode)
+{
+    QVector<QDomNode> parents;
+    parents.append(parentNode);
+
+    for (const XdgMenuFragmentNode &node : fragment) {
+        parents.resize(node.depth + 1);
+
+        if (node.tagName.isEmpty()) {
+            parents.last().appendChild(mXml.createTextNode(node.text));
+            continue;
+        }
+
+        QDomElement e = mXml.createElement(node.tagName);
+        for (const auto &attribute : node.attributes)
+            e.setAttribute(attribute.first, attribute.second);
+        parents.last().appendChild(e);
+        parents.append(e);
+    }
+}
+
 /************************************************
  Duplicate <MergeXXX> elements (that specify the same file) are handled as with
  duplicate <AppDir> elements (the last duplicate is used).
@@ -332,26 +456,28 @@ void XdgMenuReader::mergeFile(const QString &fileName, QDomElement &element, QSt
     if (!fileInfo.exists())
         return;
 
-    if (mergedFiles->contains(fileInfo.canonicalFilePath())) {
+    const QString canonicalFileName = fileInfo.canonicalFilePath();
+    if (mergedFiles->contains(canonicalFileName)) {
         //qDebug() << "\tSkip: allredy merged";
         return;
     }
 
     //qDebug() << "Merge file: " << fileName;
-    mergedFiles->append(fileInfo.canonicalFilePath());
+    mergedFiles->append(canonicalFileName);
 
-    if (reader.load(fileName, mDirName)) {
+    if (reader.load(canonicalFileName)) {
         //qDebug() << "\tOK";
-        QDomElement n = reader.xml().firstChildElement().firstChildElement();
+        QDomNode parentNode = element.parentNode();
+        QDomElement n = reader.mRoot.firstChildElement();
         while (!n.isNull()) {
+            QDomElement next = n.nextSiblingElement();
+
             // As a special exception, remove the <Name> element from the root
             // element of each file being merged.
-            if (n.tagName() != QLatin1String("Name")) {
-                QDomNode imp = mXml.importNode(n, true);
-                element.parentNode().insertBefore(imp, element);
-            }
+            if (n.tagName() != QLatin1String("Name"))
+                parentNode.insertBefore(n, element);
 
-            n = n.nextSiblingElement();
+            n = next;
         }
     }
 }
@@ -365,8 +491,9 @@ void XdgMenuReader::mergeDir(const QString &dirName, QDomElement &element, QStri
         QDir dir = QDir(dirInfo.canonicalFilePath());
         const QFileInfoList files = dir.entryInfoList(QStringList() << QStringLiteral("*.menu"), QDir::Files | QDir::Readable);
 
+        // mergeFile() resolves symbolic links
         for (const QFileInfo &file : files)
-            mergeFile(file.canonicalFilePath(), element, mergedFiles);
+            mergeFile(file.absoluteFilePath(), element, mergedFiles);
     }
 }
 
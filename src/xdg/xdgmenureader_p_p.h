@@ -5,9 +5,14 @@
 #ifndef QTXDG_XDGMENUREADER_H
 #define QTXDG_XDGMENUREADER_H
 
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QPair>
 #include <QString>
 #include <QStringList>
+#include <QVector>
 #include <QtXml/QDomDocument>
 #include <QtXml/QDomElement>
 
@@ -15,6 +20,45 @@ namespace Liri {
 
 class DesktopMenu;
 
+/*
+ * A parsed .menu file: elements and text nodes in document order,
+ * the depth of each node is enough to rebuild the tree.
+ */
+struct XdgMenuFragmentNode {
+    int depth;
+    QString tagName; // Empty for text nodes
+    QString text;
+    QList<QPair<QString, QString>> attributes;
+};
+
+typedef QVector<XdgMenuFragmentNode> XdgMenuFragment;
+
+/*
+ * Process-wide cache of parsed .menu files keyed by canonical path,
+ * entries are valid as long as modification time and size match.
+ */
+class XdgMenuFragmentCache
+{
+public:
+    static XdgMenuFragmentCache *instance();
+
+    bool find(const QString &canonicalFileName, const QDateTime &lastModified, qint64 size,
+              XdgMenuFragment *fragment) const;
+    void insert(const QString &canonicalFileName, const QDateTime &lastModified, qint64 size,
+                const XdgMenuFragment &fragment);
+    void clear();
+
+private:
+    struct Entry {
+        QDateTime lastModified;
+        qint64 size;
+        XdgMenuFragment fragment;
+    };
+
+    mutable QMutex mMutex;
+    QHash<QString, Entry> mEntries;
+};
+
 class XdgMenuReader : public QObject
 {
     Q_OBJECT
@@ -28,6 +72,9 @@ public:
     QDomDocument &xml() { return mXml; }
 
 protected:
+    bool parse(QIODevice *device, XdgMenuFragment *fragment);
+    void build(const XdgMenuFragment &fragment, QDomNode &parentNode);
+
     void processMergeTags(QDomElement &element);
     void processMergeFileTag(QDomElement &element, QStringList *mergedFiles);
     void processMergeDirTag(QDomElement &element, QStringList *mergedFiles);
@@ -48,6 +95,7 @@ private:
     QString mDirName;
     QString mErrorStr;
     QDomDocument mXml;
+    QDomElement mRoot;
     XdgMenuReader *mParentReader;
     QStringList mBranchFiles;
     Liri::DesktopMenu *mMenu;
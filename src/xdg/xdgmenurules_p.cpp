@@ -6,7 +6,6 @@
 #include "xmlhelper_p_p.h"
 
 #include <QDebug>
-#include <QStringList>
 
 namespace Liri {
 
@@ -14,183 +13,222 @@ namespace Liri {
  * See: http://standards.freedesktop.org/desktop-entry-spec
  */
 
-XdgMenuRule::XdgMenuRule(const QDomElement &element, QObject *parent)
-    : QObject(parent) {
-        Q_UNUSED(element)
-    }
-
-    XdgMenuRule::~XdgMenuRule()
+int XdgMenuCategoryAtoms::atom(const QString &category)
 {
+    auto it = mAtoms.constFind(category);
+    if (it != mAtoms.constEnd())
+        return it.value();
+
+    const int atom = mAtoms.count();
+    mAtoms.insert(category, atom);
+    return atom;
 }
 
-/************************************************
- The <Or> element contains a list of matching rules. If any of the matching rules
- inside the <Or> element match a desktop entry, then the entire <Or> rule matches
- the desktop entry.
- ************************************************/
-XdgMenuRuleOr::XdgMenuRuleOr(const QDomElement &element, QObject *parent)
-    : XdgMenuRule(element, parent)
+QBitArray XdgMenuCategoryAtoms::categories(const QStringList &list)
 {
-    //qDebug() << "Create OR rule";
-    DomElementIterator iter(element, QString());
-
-    while (iter.hasNext()) {
-        QDomElement e = iter.next();
-
-        if (e.tagName() == QLatin1String("Or"))
-            mChilds.append(new XdgMenuRuleOr(e, this));
-
-        else if (e.tagName() == QLatin1String("And"))
-            mChilds.append(new XdgMenuRuleAnd(e, this));
-
-        else if (e.tagName() == QLatin1String("Not"))
-            mChilds.append(new XdgMenuRuleNot(e, this));
-
-        else if (e.tagName() == QLatin1String("Filename"))
-            mChilds.append(new XdgMenuRuleFileName(e, this));
+    QVector<int> atoms;
+    atoms.reserve(list.count());
+    for (const QString &category : list)
+        atoms.append(atom(category));
 
-        else if (e.tagName() == QLatin1String("Category"))
-            mChilds.append(new XdgMenuRuleCategory(e, this));
-
-        else if (e.tagName() == QLatin1String("All"))
-            mChilds.append(new XdgMenuRuleAll(e, this));
-
-        else
-            qWarning() << QStringLiteral("Unknown rule") << e.tagName();
-    }
+    QBitArray result(mAtoms.count());
+    for (int atom : const_cast<const QVector<int> &>(atoms))
+        result.setBit(atom);
+    return result;
 }
 
-bool XdgMenuRuleOr::check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
+void XdgMenuRuleAppSet::reserve(int size)
 {
-    for (QLinkedList<XdgMenuRule *>::Iterator i = mChilds.begin(); i != mChilds.end(); ++i)
-        if ((*i)->check(desktopFileId, desktopFile))
-            return true;
-
-    return false;
+    mIndex.reserve(size);
+    mRows.reserve(size);
 }
 
-/************************************************
- The <And> element contains a list of matching rules. If each of the matching rules
- inside the <And> element match a desktop entry, then the entire <And> rule matches
- the desktop entry.
- ************************************************/
-XdgMenuRuleAnd::XdgMenuRuleAnd(const QDomElement &element, QObject *parent)
-    : XdgMenuRuleOr(element, parent)
+void XdgMenuRuleAppSet::append(const QString &desktopFileId, const QBitArray &categories)
 {
-    //    qDebug() << "Create AND rule";
+    mIndex.insert(desktopFileId, mRows.count());
+    mRows.append(categories);
+    mColumns.clear();
 }
 
-bool XdgMenuRuleAnd::check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
+QBitArray XdgMenuRuleAppSet::all() const
 {
-    for (QLinkedList<XdgMenuRule *>::Iterator i = mChilds.begin(); i != mChilds.end(); ++i)
-        if (!(*i)->check(desktopFileId, desktopFile))
-            return false;
-
-    return mChilds.count();
+    return QBitArray(mRows.count(), true);
 }
 
-/************************************************
- The <Not> element contains a list of matching rules. If any of the matching rules
- inside the <Not> element matches a desktop entry, then the entire <Not> rule does
- not match the desktop entry. That is, matching rules below <Not> have a logical OR
- relationship.
- ************************************************/
-XdgMenuRuleNot::XdgMenuRuleNot(const QDomElement &element, QObject *parent)
-    : XdgMenuRuleOr(element, parent)
+QBitArray XdgMenuRuleAppSet::none() const
 {
-    //    qDebug() << "Create NOT rule";
+    return QBitArray(mRows.count(), false);
 }
 
-bool XdgMenuRuleNot::check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
+QBitArray XdgMenuRuleAppSet::withId(const QString &desktopFileId) const
 {
-    return !XdgMenuRuleOr::check(desktopFileId, desktopFile);
+    QBitArray result = none();
+    const int index = mIndex.value(desktopFileId, -1);
+    if (index >= 0)
+        result.setBit(index);
+    return result;
 }
 
 /************************************************
- The <Filename> element is the most basic matching rule. It matches a desktop entry
- if the desktop entry has the given desktop-file id. See Desktop-File Id.
+ Returns the entries whose Categories field contains the category
+ identified by atom. Columns are computed once per pool and reused
+ by every rule referring to the same category.
+
+ The category index of DesktopFileCache isn't used here: it would pin
+ every entry of the category, lock the cache once per rule from the
+ build thread and depend on the pool holding the very same pointers
+ the cache hands out. The bits of the entries are already at hand.
  ************************************************/
-XdgMenuRuleFileName::XdgMenuRuleFileName(const QDomElement &element, QObject *parent)
-    : XdgMenuRule(element, parent)
-{
-    //qDebug() << "Create FILENAME rule";
-    mId = element.text();
-}
+QBitArray XdgMenuRuleAppSet::withCategory(int atom) const
+{
+    auto it = mColumns.constFind(atom);
+    if (it != mColumns.constEnd())
+        return it.value();
+
+    QBitArray result = none();
+    const int N = mRows.count();
+    for (int i = 0; i < N; ++i) {
+        const QBitArray &row = mRows.at(i);
+        if (atom < row.size() && row.testBit(atom))
+            result.setBit(i);
+    }
 
-bool XdgMenuRuleFileName::check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
-{
-    Q_UNUSED(desktopFile)
-    //qDebug() << "XdgMenuRuleFileName:" << desktopFileId << mId;
-    return desktopFileId == mId;
+    mColumns.insert(atom, result);
+    return result;
 }
 
 /************************************************
- The <Category> element is another basic matching predicate. It matches a desktop entry
- if the desktop entry has the given category in its Categories field.
+ The <Include> and <Exclude> elements behave as an <Or> element
+ containing their matching rules.
  ************************************************/
-XdgMenuRuleCategory::XdgMenuRuleCategory(const QDomElement &element, QObject *parent)
-    : XdgMenuRule(element, parent)
+XdgMenuRuleProgram::XdgMenuRuleProgram(const QDomElement &element, XdgMenuCategoryAtoms *atoms)
 {
-    mCategory = element.text();
-}
-
-bool XdgMenuRuleCategory::check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
-{
-    Q_UNUSED(desktopFileId)
-    QStringList cats = desktopFile.categories();
-    return cats.contains(mCategory);
+    const int operands = compile(element, atoms);
+    mCode.append(Instruction{ Or, operands });
 }
 
 /************************************************
- The <All> element is a matching rule that matches all desktop entries.
+ Appends the code for the children of element and returns the
+ number of operands they leave on the stack.
  ************************************************/
-XdgMenuRuleAll::XdgMenuRuleAll(const QDomElement &element, QObject *parent)
-    : XdgMenuRule(element, parent)
+int XdgMenuRuleProgram::compile(const QDomElement &element, XdgMenuCategoryAtoms *atoms)
 {
-}
+    int operands = 0;
 
-bool XdgMenuRuleAll::check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
-{
-    Q_UNUSED(desktopFileId)
-    Q_UNUSED(desktopFile)
-    return true;
+    DomElementIterator iter(element, QString());
+    while (iter.hasNext()) {
+        QDomElement e = iter.next();
+
+        if (e.tagName() == QLatin1String("Or"))
+            mCode.append(Instruction{ Or, compile(e, atoms) });
+
+        else if (e.tagName() == QLatin1String("And"))
+            mCode.append(Instruction{ And, compile(e, atoms) });
+
+        else if (e.tagName() == QLatin1String("Not"))
+            mCode.append(Instruction{ Not, compile(e, atoms) });
+
+        else if (e.tagName() == QLatin1String("Filename")) {
+            mCode.append(Instruction{ MatchFileName, static_cast<int>(mFileNames.count()) });
+            mFileNames.append(e.text());
+        }
+
+        else if (e.tagName() == QLatin1String("Category"))
+            mCode.append(Instruction{ MatchCategory, atoms->atom(e.text()) });
+
+        else if (e.tagName() == QLatin1String("All"))
+            mCode.append(Instruction{ MatchAll, 0 });
+
+        else {
+            qWarning() << QStringLiteral("Unknown rule") << e.tagName();
+            continue;
+        }
+
+        ++operands;
+    }
+
+    return operands;
 }
 
-XdgMenuRules::XdgMenuRules(QObject *parent)
-    : QObject(parent)
-{
+/************************************************
+ The <Or> element matches an entry if any of its rules matches it.
+ The <And> element matches an entry if each of its rules matches it,
+ an empty <And> matches nothing.
+ The <Not> element matches an entry if none of its rules matches it,
+ that is rules below <Not> have a logical OR relationship.
+ The <Filename> element matches the entry with the given desktop-file id.
+ The <Category> element matches entries having the given category in
+ their Categories field.
+ The <All> element matches all entries.
+ ************************************************/
+QBitArray XdgMenuRuleProgram::evaluate(const XdgMenuRuleAppSet &apps) const
+{
+    QVector<QBitArray> stack;
+
+    for (const Instruction &instruction : mCode) {
+        switch (instruction.op) {
+        case MatchFileName:
+            stack.append(apps.withId(mFileNames.at(instruction.operand)));
+            break;
+        case MatchCategory:
+            stack.append(apps.withCategory(instruction.operand));
+            break;
+        case MatchAll:
+            stack.append(apps.all());
+            break;
+        case Or:
+        case Not: {
+            QBitArray result = apps.none();
+            for (int i = stack.count() - instruction.operand; i < stack.count(); ++i)
+                result |= stack.at(i);
+            stack.resize(stack.count() - instruction.operand);
+            stack.append(instruction.op == Not ? ~result : result);
+            break;
+        }
+        case And: {
+            QBitArray result = instruction.operand ? apps.all() : apps.none();
+            for (int i = stack.count() - instruction.operand; i < stack.count(); ++i)
+                result &= stack.at(i);
+            stack.resize(stack.count() - instruction.operand);
+            stack.append(result);
+            break;
+        }
+        }
+    }
+
+    Q_ASSERT(stack.count() == 1);
+    return stack.takeLast();
 }
 
-XdgMenuRules::~XdgMenuRules()
+XdgMenuRules::XdgMenuRules(XdgMenuCategoryAtoms *atoms)
+    : mAtoms(atoms)
 {
 }
 
 void XdgMenuRules::addInclude(const QDomElement &element)
 {
-    mIncludeRules.append(new XdgMenuRuleOr(element, this));
+    mIncludeRules.append(XdgMenuRuleProgram(element, mAtoms));
 }
 
 void XdgMenuRules::addExclude(const QDomElement &element)
 {
-    mExcludeRules.append(new XdgMenuRuleOr(element, this));
+    mExcludeRules.append(XdgMenuRuleProgram(element, mAtoms));
 }
 
-bool XdgMenuRules::checkInclude(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
+QBitArray XdgMenuRules::checkInclude(const XdgMenuRuleAppSet &apps) const
 {
-    for (QLinkedList<XdgMenuRule *>::Iterator i = mIncludeRules.begin(); i != mIncludeRules.end(); ++i)
-        if ((*i)->check(desktopFileId, desktopFile))
-            return true;
-
-    return false;
+    QBitArray result = apps.none();
+    for (const XdgMenuRuleProgram &program : mIncludeRules)
+        result |= program.evaluate(apps);
+    return result;
 }
 
-bool XdgMenuRules::checkExclude(const QString &desktopFileId, const Liri::DesktopFile &desktopFile)
+QBitArray XdgMenuRules::checkExclude(const XdgMenuRuleAppSet &apps) const
 {
-    for (QLinkedList<XdgMenuRule *>::Iterator i = mExcludeRules.begin(); i != mExcludeRules.end(); ++i)
-        if ((*i)->check(desktopFileId, desktopFile))
-            return true;
-
-    return false;
+    QBitArray result = apps.none();
+    for (const XdgMenuRuleProgram &program : mExcludeRules)
+        result |= program.evaluate(apps);
+    return result;
 }
 
 } // namespace Liri
@@ -5,11 +5,11 @@
 #ifndef QTXDG_XDGMENURULES_H
 #define QTXDG_XDGMENURULES_H
 
-#include <QObject>
+#include <QBitArray>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
 #include <QtXml/QDomElement>
-#include <QLinkedList>
-
-#include "desktopfile.h"
 
 namespace Liri {
 
@@ -17,90 +17,94 @@ namespace Liri {
  * See: http://standards.freedesktop.org/desktop-entry-spec
  */
 
-class XdgMenuRule : public QObject
-{
-    Q_OBJECT
-public:
-    explicit XdgMenuRule(const QDomElement &element, QObject *parent = 0);
-    virtual ~XdgMenuRule();
-
-    virtual bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile) = 0;
-};
-
-class XdgMenuRuleOr : public XdgMenuRule
+/*
+ * Interns category names into small integers ("atoms"), so that the
+ * categories of a desktop entry can be stored as a bitset.
+ */
+class XdgMenuCategoryAtoms
 {
-    Q_OBJECT
 public:
-    explicit XdgMenuRuleOr(const QDomElement &element, QObject *parent = 0);
+    int atom(const QString &category);
+    int count() const { return mAtoms.count(); }
 
-    bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
+    QBitArray categories(const QStringList &list);
 
-protected:
-    QLinkedList<XdgMenuRule *> mChilds;
+private:
+    QHash<QString, int> mAtoms;
 };
 
-class XdgMenuRuleAnd : public XdgMenuRuleOr
+/*
+ * The pool of desktop entries a menu is built from. Entry i of the pool
+ * is bit i in every bitset produced by the rules.
+ */
+class XdgMenuRuleAppSet
 {
-    Q_OBJECT
 public:
-    explicit XdgMenuRuleAnd(const QDomElement &element, QObject *parent = 0);
-    bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
-};
+    void reserve(int size);
+    void append(const QString &desktopFileId, const QBitArray &categories);
 
-class XdgMenuRuleNot : public XdgMenuRuleOr
-{
-    Q_OBJECT
-public:
-    explicit XdgMenuRuleNot(const QDomElement &element, QObject *parent = 0);
-    bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
-};
+    int count() const { return mRows.count(); }
 
-class XdgMenuRuleFileName : public XdgMenuRule
-{
-    Q_OBJECT
-public:
-    explicit XdgMenuRuleFileName(const QDomElement &element, QObject *parent = 0);
-    bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
+    QBitArray all() const;
+    QBitArray none() const;
+    QBitArray withId(const QString &desktopFileId) const;
+    QBitArray withCategory(int atom) const;
 
 private:
-    QString mId;
+    QHash<QString, int> mIndex;
+    QVector<QBitArray> mRows;
+    mutable QHash<int, QBitArray> mColumns;
 };
 
-class XdgMenuRuleCategory : public XdgMenuRule
+/*
+ * An <Include> or <Exclude> element compiled into a flat postfix program.
+ * Leaves push the set of matching entries, <And>, <Or> and <Not> pop
+ * their operands and combine them with bitwise operations, so a rule is
+ * evaluated over the whole pool in a single sweep.
+ */
+class XdgMenuRuleProgram
 {
-    Q_OBJECT
 public:
-    explicit XdgMenuRuleCategory(const QDomElement &element, QObject *parent = 0);
-    bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
+    explicit XdgMenuRuleProgram(const QDomElement &element, XdgMenuCategoryAtoms *atoms);
 
-private:
-    QString mCategory;
-};
+    QBitArray evaluate(const XdgMenuRuleAppSet &apps) const;
 
-class XdgMenuRuleAll : public XdgMenuRule
-{
-    Q_OBJECT
-public:
-    explicit XdgMenuRuleAll(const QDomElement &element, QObject *parent = 0);
-    bool check(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
+private:
+    enum OpCode {
+        MatchFileName,
+        MatchCategory,
+        MatchAll,
+        Or,
+        And,
+        Not,
+    };
+
+    struct Instruction {
+        OpCode op;
+        int operand;
+    };
+
+    int compile(const QDomElement &element, XdgMenuCategoryAtoms *atoms);
+
+    QVector<Instruction> mCode;
+    QStringList mFileNames;
 };
 
-class XdgMenuRules : public QObject
+class XdgMenuRules
 {
-    Q_OBJECT
 public:
-    explicit XdgMenuRules(QObject *parent = 0);
-    virtual ~XdgMenuRules();
+    explicit XdgMenuRules(XdgMenuCategoryAtoms *atoms);
 
     void addInclude(const QDomElement &element);
     void addExclude(const QDomElement &element);
 
-    bool checkInclude(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
-    bool checkExclude(const QString &desktopFileId, const Liri::DesktopFile &desktopFile);
+    QBitArray checkInclude(const XdgMenuRuleAppSet &apps) const;
+    QBitArray checkExclude(const XdgMenuRuleAppSet &apps) const;
 
 protected:
-    QLinkedList<XdgMenuRule *> mIncludeRules;
-    QLinkedList<XdgMenuRule *> mExcludeRules;
+    XdgMenuCategoryAtoms *mAtoms;
+    QVector<XdgMenuRuleProgram> mIncludeRules;
+    QVector<XdgMenuRuleProgram> mExcludeRules;
 };
 
 } // namespace Liri
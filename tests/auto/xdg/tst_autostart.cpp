@@ -0,0 +1,378 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/AutoStart>
+#include <LiriXdg/AutoStartLauncher>
+#include <LiriXdg/AutoStartRegistry>
+
+static bool writeEntry(const QString &fileName, const QString &name, const QByteArray &extra = QByteArray())
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+    file.write("[Desktop Entry]\n"
+               "Type=Application\n"
+               "Name=" + name.toUtf8() + "\n"
+               "Exec=" + name.toUtf8() + "\n" + extra);
+    return true;
+}
+
+static QStringList describe(const Liri::DesktopFileList &list)
+{
+    QStringList result;
+    for (const Liri::DesktopFile &file : list)
+        result.append(file.name() + QLatin1Char(' ') + file.fileName());
+    return result;
+}
+
+/*
+ * Start function that records the names of the entries it's called
+ * for, from the worker threads of the launcher.
+ */
+class StartRecorder
+{
+public:
+    Liri::AutoStartLauncher::StartFunction function()
+    {
+        return [this](Liri::DesktopFile &file) {
+            QMutexLocker locker(&mMutex);
+            mNames.append(file.name());
+            mFileNames.append(file.fileName());
+            return !mFailing.contains(file.name());
+        };
+    }
+
+    void setFailing(const QStringList &names)
+    {
+        mFailing = names;
+    }
+
+    QStringList names() const
+    {
+        QMutexLocker locker(&mMutex);
+        return mNames;
+    }
+
+    QStringList fileNames() const
+    {
+        QMutexLocker locker(&mMutex);
+        return mFileNames;
+    }
+
+private:
+    mutable QMutex mMutex;
+    QStringList mNames;
+    QStringList mFileNames;
+    QStringList mFailing;
+};
+
+class TestAutoStart : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        // Keeps the desktop file cache and its store away from the user's files
+        qputenv("XDG_DATA_HOME", mDir.filePath(QStringLiteral("home")).toLocal8Bit());
+        qputenv("XDG_DATA_DIRS", mDir.filePath(QStringLiteral("data")).toLocal8Bit());
+        qputenv("XDG_CACHE_HOME", mDir.filePath(QStringLiteral("cache")).toLocal8Bit());
+    }
+
+    void testRegistryList()
+    {
+        const QString home = mDir.filePath(QStringLiteral("list/home"));
+        const QString system = mDir.filePath(QStringLiteral("list/system"));
+        const QStringList dirs = { home, system };
+
+        // Overridden
+        QVERIFY(writeEntry(system + QStringLiteral("/override.desktop"), QStringLiteral("System")));
+        QVERIFY(writeEntry(home + QStringLiteral("/override.desktop"), QStringLiteral("Home")));
+
+        // Shadowed by a hidden entry
+        QVERIFY(writeEntry(system + QStringLiteral("/shadowed.desktop"), QStringLiteral("Shadowed")));
+        QVERIFY(writeEntry(home + QStringLiteral("/shadowed.desktop"), QStringLiteral("Shadowed"),
+                           QByteArrayLiteral("Hidden=true\n")));
+
+        // Listed regardless of case
+        QVERIFY(writeEntry(system + QStringLiteral("/apple.desktop"), QStringLiteral("apple")));
+        QVERIFY(writeEntry(system + QStringLiteral("/Zed.desktop"), QStringLiteral("Zed")));
+
+        // Linked to an application
+        const QString application = mDir.filePath(QStringLiteral("data/applications/linked.desktop"));
+        QVERIFY(writeEntry(application, QStringLiteral("Linked")));
+        QVERIFY(QFile::link(application, system + QStringLiteral("/linked.desktop")));
+
+        Liri::AutoStartRegistry registry(dirs);
+
+        const QStringList expected = {
+            QStringLiteral("Home %1/override.desktop").arg(home),
+            QStringLiteral("apple %1/apple.desktop").arg(system),
+            QStringLiteral("Linked %1/linked.desktop").arg(system),
+            QStringLiteral("Zed %1/Zed.desktop").arg(system),
+        };
+        QCOMPARE(describe(Liri::AutoStart::desktopFileList(dirs)), expected);
+        QCOMPARE(describe(registry.desktopFileList()), expected);
+
+        QCOMPARE(describe(registry.desktopFileList(false)), describe(Liri::AutoStart::desktopFileList(dirs, false)));
+
+        QCOMPARE(registry.entry(QStringLiteral("linked.desktop")).fileName(),
+                 system + QStringLiteral("/linked.desktop"));
+        QCOMPARE(registry.fileName(QStringLiteral("override.desktop")), home + QStringLiteral("/override.desktop"));
+        QCOMPARE(registry.overriddenFileNames(QStringLiteral("override.desktop")),
+                 QStringList(system + QStringLiteral("/override.desktop")));
+    }
+
+    void testRegistrySignals()
+    {
+        const QString home = mDir.filePath(QStringLiteral("signals/home"));
+        const QString system = mDir.filePath(QStringLiteral("signals/system"));
+        QVERIFY(QDir().mkpath(home));
+        QVERIFY(QDir().mkpath(system));
+
+        const QString homeFileName = home + QStringLiteral("/app.desktop");
+        const QString systemFileName = system + QStringLiteral("/app.desktop");
+
+        Liri::AutoStartRegistry registry(QStringList() << home << system);
+        QVERIFY(registry.names().isEmpty());
+
+        QSignalSpy added(&registry, &Liri::AutoStartRegistry::entryAdded);
+        QSignalSpy removed(&registry, &Liri::AutoStartRegistry::entryRemoved);
+        QSignalSpy overridden(&registry, &Liri::AutoStartRegistry::entryOverridden);
+
+        // Noticed by the watcher
+        QVERIFY(writeEntry(systemFileName, QStringLiteral("System")));
+        QVERIFY(added.wait());
+        QCOMPARE(added.takeFirst().at(0).toString(), systemFileName);
+        QCOMPARE(registry.names(), QStringList(QStringLiteral("app.desktop")));
+
+        QVERIFY(writeEntry(homeFileName, QStringLiteral("Home")));
+        registry.refresh();
+        QCOMPARE(overridden.count(), 1);
+        QCOMPARE(overridden.at(0).at(0).toString(), systemFileName);
+        QCOMPARE(overridden.at(0).at(1).toString(), homeFileName);
+        QCOMPARE(registry.entry(QStringLiteral("app.desktop")).name(), QStringLiteral("Home"));
+
+        QVERIFY(QFile::remove(homeFileName));
+        registry.refresh();
+        QCOMPARE(overridden.count(), 2);
+        QCOMPARE(overridden.at(1).at(0).toString(), homeFileName);
+        QCOMPARE(overridden.at(1).at(1).toString(), systemFileName);
+
+        QVERIFY(QFile::remove(systemFileName));
+        registry.refresh();
+        QCOMPARE(removed.count(), 1);
+        QCOMPARE(removed.at(0).at(0).toString(), systemFileName);
+        QVERIFY(registry.names().isEmpty());
+
+        QCOMPARE(added.count(), 0);
+    }
+
+    void testLauncherOrder()
+    {
+        const QString home = mDir.filePath(QStringLiteral("launcher/order/home"));
+        const QString system = mDir.filePath(QStringLiteral("launcher/order/system"));
+
+        QVERIFY(writeEntry(system + QStringLiteral("/init.desktop"), QStringLiteral("init"),
+                           QByteArrayLiteral("X-Liri-Autostart-Phase=Initialization\n")));
+        QVERIFY(writeEntry(system + QStringLiteral("/kdeinit.desktop"), QStringLiteral("kdeinit"),
+                           QByteArrayLiteral("X-KDE-autostart-phase=0\n")));
+        QVERIFY(writeEntry(system + QStringLiteral("/panel.desktop"), QStringLiteral("panel"),
+                           QByteArrayLiteral("X-GNOME-Autostart-Phase=Panel\n")));
+
+        // Dependencies on later phases can't be honoured, those on
+        // earlier phases are satisfied already
+        QVERIFY(writeEntry(system + QStringLiteral("/early.desktop"), QStringLiteral("early"),
+                           QByteArrayLiteral("X-Liri-Autostart-Phase=Initialization\n"
+                                             "X-Liri-Autostart-After=first\n")));
+        QVERIFY(writeEntry(system + QStringLiteral("/late.desktop"), QStringLiteral("late"),
+                           QByteArrayLiteral("X-Liri-Autostart-After=panel\n")));
+
+        // Chained within the same phase
+        QVERIFY(writeEntry(system + QStringLiteral("/first.desktop"), QStringLiteral("first")));
+        QVERIFY(writeEntry(system + QStringLiteral("/second.desktop"), QStringLiteral("second"),
+                           QByteArrayLiteral("X-KDE-autostart-after=first\n")));
+        QVERIFY(writeEntry(system + QStringLiteral("/third.desktop"), QStringLiteral("third"),
+                           QByteArrayLiteral("X-Liri-Autostart-After=second.desktop;first;\n")));
+
+        // Dependents of a failed entry are launched anyway
+        QVERIFY(writeEntry(system + QStringLiteral("/fail.desktop"), QStringLiteral("fail")));
+        QVERIFY(writeEntry(system + QStringLiteral("/afterfail.desktop"), QStringLiteral("afterfail"),
+                           QByteArrayLiteral("X-KDE-autostart-after=fail\n")));
+
+        QVERIFY(writeEntry(system + QStringLiteral("/disabled.desktop"), QStringLiteral("disabled"),
+                           QByteArrayLiteral("X-GNOME-Autostart-enabled=false\n")));
+        QVERIFY(writeEntry(system + QStringLiteral("/hidden.desktop"), QStringLiteral("hidden"),
+                           QByteArrayLiteral("Hidden=true\n")));
+
+        // Only the most important directory is considered
+        QVERIFY(writeEntry(system + QStringLiteral("/override.desktop"), QStringLiteral("override")));
+        QVERIFY(writeEntry(home + QStringLiteral("/override.desktop"), QStringLiteral("override")));
+
+        StartRecorder recorder;
+        recorder.setFailing(QStringList(QStringLiteral("fail")));
+
+        Liri::AutoStartLauncher launcher;
+        launcher.setDirectories(QStringList() << home << system);
+        launcher.setDesktopEnvironment(QStringLiteral("Liri"));
+        launcher.setMaxThreadCount(4);
+        launcher.setStartFunction(recorder.function());
+
+        QSignalSpy phaseStarted(&launcher, &Liri::AutoStartLauncher::phaseStarted);
+        QSignalSpy phaseFinished(&launcher, &Liri::AutoStartLauncher::phaseFinished);
+        QSignalSpy entryStarted(&launcher, &Liri::AutoStartLauncher::entryStarted);
+        QSignalSpy finished(&launcher, &Liri::AutoStartLauncher::finished);
+
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Failed to start autostart entry.*fail\\.desktop")));
+        launcher.start();
+        QVERIFY(launcher.isRunning());
+        QVERIFY(finished.wait());
+        QVERIFY(!launcher.isRunning());
+        QCOMPARE(finished.count(), 1);
+
+        const QStringList names = recorder.names();
+        QCOMPARE(names.size(), 11);
+        QVERIFY(!names.contains(QStringLiteral("disabled")));
+        QVERIFY(!names.contains(QStringLiteral("hidden")));
+
+        // Phase by phase
+        const QStringList initialization = { QStringLiteral("init"), QStringLiteral("kdeinit"), QStringLiteral("early") };
+        const QStringList applications = {
+            QStringLiteral("late"), QStringLiteral("first"), QStringLiteral("second"), QStringLiteral("third"),
+            QStringLiteral("fail"), QStringLiteral("afterfail"), QStringLiteral("override"),
+        };
+        for (const QString &name : initialization)
+            QVERIFY2(names.indexOf(name) < names.indexOf(QStringLiteral("panel")), qPrintable(name));
+        for (const QString &name : applications)
+            QVERIFY2(names.indexOf(name) > names.indexOf(QStringLiteral("panel")), qPrintable(name));
+
+        // Then by dependencies
+        QVERIFY(names.indexOf(QStringLiteral("second")) > names.indexOf(QStringLiteral("first")));
+        QVERIFY(names.indexOf(QStringLiteral("third")) > names.indexOf(QStringLiteral("second")));
+        QVERIFY(names.indexOf(QStringLiteral("afterfail")) > names.indexOf(QStringLiteral("fail")));
+
+        QVERIFY(recorder.fileNames().contains(home + QStringLiteral("/override.desktop")));
+        QVERIFY(!recorder.fileNames().contains(system + QStringLiteral("/override.desktop")));
+
+        const QStringList phases = { QStringLiteral("Initialization"), QStringLiteral("Panel"), QStringLiteral("Applications") };
+        QStringList startedPhases;
+        for (const QList<QVariant> &arguments : const_cast<const QSignalSpy &>(phaseStarted))
+            startedPhases.append(arguments.at(0).toString());
+        QCOMPARE(startedPhases, phases);
+        QStringList finishedPhases;
+        for (const QList<QVariant> &arguments : const_cast<const QSignalSpy &>(phaseFinished))
+            finishedPhases.append(arguments.at(0).toString());
+        QCOMPARE(finishedPhases, phases);
+
+        // One timing per launch, in the order they were reported
+        const QList<Liri::AutoStartTiming> timings = launcher.timings();
+        QCOMPARE(timings.size(), 11);
+        QCOMPARE(entryStarted.count(), 11);
+        for (int i = 0; i < timings.size(); ++i) {
+            const Liri::AutoStartTiming &timing = timings.at(i);
+            const QString name = QFileInfo(timing.fileName).completeBaseName();
+
+            QCOMPARE(timing.fileName, entryStarted.at(i).at(0).toString());
+            QCOMPARE(timing.success, entryStarted.at(i).at(1).toBool());
+            QCOMPARE(timing.success, name != QLatin1String("fail"));
+            QVERIFY(timing.ready >= 0);
+            QVERIFY(timing.start >= timing.ready);
+            QVERIFY(timing.duration >= 0);
+
+            if (initialization.contains(name))
+                QCOMPARE(timing.phase, QStringLiteral("Initialization"));
+            else if (name == QLatin1String("panel"))
+                QCOMPARE(timing.phase, QStringLiteral("Panel"));
+            else
+                QCOMPARE(timing.phase, QStringLiteral("Applications"));
+        }
+    }
+
+    void testLauncherCircular()
+    {
+        const QString dir = mDir.filePath(QStringLiteral("launcher/circular"));
+
+        QVERIFY(writeEntry(dir + QStringLiteral("/a.desktop"), QStringLiteral("a"),
+                           QByteArrayLiteral("X-Liri-Autostart-After=b\n")));
+        QVERIFY(writeEntry(dir + QStringLiteral("/b.desktop"), QStringLiteral("b"),
+                           QByteArrayLiteral("X-KDE-autostart-after=a\n")));
+        QVERIFY(writeEntry(dir + QStringLiteral("/c.desktop"), QStringLiteral("c"),
+                           QByteArrayLiteral("X-Liri-Autostart-After=a\n")));
+        QVERIFY(writeEntry(dir + QStringLiteral("/d.desktop"), QStringLiteral("d")));
+
+        StartRecorder recorder;
+
+        Liri::AutoStartLauncher launcher;
+        launcher.setDirectories(QStringList(dir));
+        launcher.setDesktopEnvironment(QStringLiteral("Liri"));
+        launcher.setStartFunction(recorder.function());
+
+        QSignalSpy finished(&launcher, &Liri::AutoStartLauncher::finished);
+
+        // Reported once nothing else is launching, then ignored
+        QTest::ignoreMessage(QtWarningMsg, "Circular autostart ordering in phase \"Applications\", ignoring it");
+        launcher.start();
+        QVERIFY(finished.wait());
+
+        const QStringList names = recorder.names();
+        QCOMPARE(names.size(), 4);
+        QCOMPARE(names.first(), QStringLiteral("d"));
+        QVERIFY(names.contains(QStringLiteral("a")));
+        QVERIFY(names.contains(QStringLiteral("b")));
+        QVERIFY(names.contains(QStringLiteral("c")));
+        QCOMPARE(launcher.timings().size(), 4);
+    }
+
+    void testLauncherDelay()
+    {
+        const QString dir = mDir.filePath(QStringLiteral("launcher/delay"));
+
+        QVERIFY(writeEntry(dir + QStringLiteral("/liri.desktop"), QStringLiteral("liri"),
+                           QByteArrayLiteral("X-Liri-Autostart-Delay=1\n")));
+        QVERIFY(writeEntry(dir + QStringLiteral("/gnome.desktop"), QStringLiteral("gnome"),
+                           QByteArrayLiteral("X-GNOME-Autostart-Delay=1\n")));
+        QVERIFY(writeEntry(dir + QStringLiteral("/dependent.desktop"), QStringLiteral("dependent"),
+                           QByteArrayLiteral("X-Liri-Autostart-After=liri\n")));
+        QVERIFY(writeEntry(dir + QStringLiteral("/now.desktop"), QStringLiteral("now")));
+
+        StartRecorder recorder;
+
+        Liri::AutoStartLauncher launcher;
+        launcher.setDirectories(QStringList(dir));
+        launcher.setDesktopEnvironment(QStringLiteral("Liri"));
+        launcher.setStartFunction(recorder.function());
+
+        QSignalSpy finished(&launcher, &Liri::AutoStartLauncher::finished);
+        launcher.start();
+        QVERIFY(finished.wait(10000));
+
+        const QStringList names = recorder.names();
+        QCOMPARE(names.size(), 4);
+        QCOMPARE(names.first(), QStringLiteral("now"));
+        QVERIFY(names.indexOf(QStringLiteral("dependent")) > names.indexOf(QStringLiteral("liri")));
+
+        // Held for the delay once ready, coarse timers may fire a bit early
+        const QList<Liri::AutoStartTiming> timings = launcher.timings();
+        for (const Liri::AutoStartTiming &timing : timings) {
+            const QString name = QFileInfo(timing.fileName).completeBaseName();
+            if (name == QLatin1String("liri") || name == QLatin1String("gnome"))
+                QVERIFY2(timing.start - timing.ready >= 900000, qPrintable(name));
+            else
+                QVERIFY2(timing.start - timing.ready < 900000, qPrintable(name));
+        }
+    }
+
+private:
+    QTemporaryDir mDir;
+};
+
+QTEST_MAIN(TestAutoStart)
+
+#include "tst_autostart.moc"
@@ -30,6 +30,55 @@ class TestDesktopFile : public QObject
 {
     Q_OBJECT
 private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        // Keeps the cache and its store away from the user's files
+        qputenv("XDG_DATA_HOME", mDir.filePath(QStringLiteral("home")).toLocal8Bit());
+        qputenv("XDG_DATA_DIRS", mDir.filePath(QStringLiteral("data")).toLocal8Bit());
+        qputenv("XDG_CACHE_HOME", mDir.filePath(QStringLiteral("cache")).toLocal8Bit());
+    }
+
+    // Comes first, the load mode must be set before the cache is used
+    void testStoreCurrentLocale()
+    {
+        const QString applications = mDir.filePath(QStringLiteral("data/applications"));
+        QVERIFY(QDir().mkpath(applications));
+
+        QFile file(applications + QStringLiteral("/liri-test-store.desktop"));
+        QVERIFY(file.open(QFile::WriteOnly | QFile::Text));
+        file.write("[Desktop Entry]\n"
+                   "Type=Application\n"
+                   "Name=My Application\n"
+                   "Name[de]=Meine Anwendung\n"
+                   "Name[pt]=A Minha Aplicação\n"
+                   "Name[pt_BR]=O Meu Aplicativo\n"
+                   "Categories=X-LiriTestStore;\n");
+        file.close();
+
+        Language lang(QStringLiteral("pt_BR"));
+
+        // Parses the files and writes the store
+        {
+            Liri::DesktopFileCache cache;
+        }
+        const QDir storeDir(mDir.filePath(QStringLiteral("cache/liri")));
+        QCOMPARE(storeDir.entryList(QStringList(QStringLiteral("desktop-entries-*.cache")), QDir::Files).size(), 1);
+
+        // Reads the store, dropping the other translations
+        Liri::DesktopFileCache::setLoadMode(Liri::DesktopFile::CurrentLocaleLoadMode);
+        const QList<Liri::DesktopFile *> files =
+                Liri::DesktopFileCache::getAppsByCategory(QStringLiteral("X-LiriTestStore"));
+        Liri::DesktopFileCache::setLoadMode(Liri::DesktopFile::AllLocalesLoadMode);
+
+        QVERIFY(Liri::DesktopFileCache::memoryUsage().sharedBytes > 0);
+        QCOMPARE(files.size(), 1);
+        QCOMPARE(files.at(0)->name(), QStringLiteral("O Meu Aplicativo"));
+        QVERIFY(files.at(0)->contains(QStringLiteral("Name[pt]")));
+        QVERIFY(!files.at(0)->contains(QStringLiteral("Name[de]")));
+    }
+
     void testRead()
     {
         QTemporaryFile file(QStringLiteral("testReadXXXXXX.desktop"));
@@ -99,6 +148,258 @@ private Q_SLOTS:
 
         QCOMPARE(df.name(), translation);
     }
+
+    void testLoadCurrentLocale()
+    {
+        QTemporaryFile file(QStringLiteral("testLoadCurrentLocaleXXXXXX.desktop"));
+        QVERIFY(file.open());
+        const QString fileName = file.fileName();
+        file.write("[Desktop Entry]\n"
+                   "Type=Application\n"
+                   "Name=My Application\n"
+                   "Name[de]=Meine Anwendung\n"
+                   "Name[pt]=A Minha Aplicação\n"
+                   "Name[pt_BR]=O Meu Aplicativo\n");
+        file.close();
+
+        Language lang(QStringLiteral("pt_BR"));
+
+        Liri::DesktopFile df;
+        QVERIFY(df.load(fileName, Liri::DesktopFile::CurrentLocaleLoadMode));
+        QCOMPARE(df.name(), QStringLiteral("O Meu Aplicativo"));
+        QVERIFY(df.contains(QStringLiteral("Name[pt]")));
+        QVERIFY(!df.contains(QStringLiteral("Name[de]")));
+
+        // Translations that were not loaded are not lost
+        df.setValue(QStringLiteral("Name"), QStringLiteral("Other"));
+        QVERIFY(df.save(fileName));
+
+        QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+        QCOMPARE(QString::fromUtf8(file.readAll()),
+                 QString::fromUtf8("[Desktop Entry]\n"
+                                   "Type=Application\n"
+                                   "Name=Other\n"
+                                   "Name[de]=Meine Anwendung\n"
+                                   "Name[pt]=A Minha Aplicação\n"
+                                   "Name[pt_BR]=O Meu Aplicativo\n"));
+        file.close();
+    }
+
+    void testCacheEviction()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QStringList fileNames;
+        for (const char *name : { "first", "second", "third" }) {
+            const QString fileName = dir.filePath(QLatin1String(name) + QStringLiteral(".desktop"));
+            QFile file(fileName);
+            QVERIFY(file.open(QFile::WriteOnly | QFile::Text));
+            file.write("[Desktop Entry]\n"
+                       "Type=Application\n"
+                       "Name=");
+            file.write(name);
+            file.write("\nCategories=X-LiriTestEviction;\n");
+            file.close();
+            fileNames.append(fileName);
+        }
+
+        Liri::DesktopFileCache::setMaximumSize(2);
+        const Liri::DesktopFileCacheStatistics before = Liri::DesktopFileCache::statistics();
+
+        QSharedPointer<Liri::DesktopFile> first = Liri::DesktopFileCache::getFileHandle(fileNames.at(0));
+        QVERIFY(first);
+        QVERIFY(Liri::DesktopFileCache::getFileHandle(fileNames.at(1)));
+        QVERIFY(Liri::DesktopFileCache::getFileHandle(fileNames.at(2)));
+
+        Liri::DesktopFileCacheStatistics after = Liri::DesktopFileCache::statistics();
+        QCOMPARE(after.misses - before.misses, quint64(3));
+        QCOMPARE(after.evictions - before.evictions, quint64(1));
+
+        // Evicted, but still alive for the handle
+        QCOMPARE(first->name(), QStringLiteral("first"));
+        const QList<Liri::DesktopFile *> files =
+                Liri::DesktopFileCache::getAppsByCategory(QStringLiteral("X-LiriTestEviction"));
+        QCOMPARE(files.size(), 2);
+        QCOMPARE(files.at(0)->name(), QStringLiteral("second"));
+        QCOMPARE(files.at(1)->name(), QStringLiteral("third"));
+
+        // Entries handed out as raw pointers are no longer evicted
+        QVERIFY(Liri::DesktopFileCache::getFileHandle(fileNames.at(0)));
+        QVERIFY(Liri::DesktopFileCache::getFileHandle(fileNames.at(2)));
+        after = Liri::DesktopFileCache::statistics();
+        QCOMPARE(after.misses - before.misses, quint64(4));
+        QCOMPARE(after.hits - before.hits, quint64(1));
+        QCOMPARE(after.evictions - before.evictions, quint64(1));
+
+        Liri::DesktopFileCache::setMaximumSize(0);
+    }
+
+    void testValidate()
+    {
+        QTemporaryFile file(QStringLiteral("testValidateXXXXXX.desktop"));
+        QVERIFY(file.open());
+        const QString fileName = file.fileName();
+        file.write("Stray=1\n"
+                   "[Desktop Entry]\n"
+                   "Type=Application\n"
+                   "Name=MyApp\n"
+                   "Name=Again\n"
+                   "Terminal=maybe\n"
+                   "  Encoding=UTF-8\n"
+                   "Not a pair\n"
+                   "Actions=new;\n"
+                   "[Desktop Action new]\n"
+                   "Exec=myapp --new\n");
+        file.close();
+
+        // Reported as a diagnostic only
+        QTest::failOnWarning(QRegularExpression(QStringLiteral("Stray assignment")));
+        const QList<Liri::DesktopFileDiagnostic> diagnostics = Liri::DesktopFile::validate(fileName);
+
+        QStringList codes;
+        for (const auto &diagnostic : diagnostics)
+            codes.append(QStringLiteral("%1:%2:%3").arg(diagnostic.line).arg(diagnostic.column).arg(diagnostic.code));
+
+        QCOMPARE(codes, QStringList()
+                 << QStringLiteral("1:1:key-outside-group")
+                 << QStringLiteral("2:0:missing-key")
+                 << QStringLiteral("5:1:duplicate-key")
+                 << QStringLiteral("6:0:invalid-value")
+                 << QStringLiteral("7:3:deprecated-key")
+                 << QStringLiteral("8:1:invalid-line")
+                 << QStringLiteral("8:1:invalid-key-name")
+                 << QStringLiteral("10:0:missing-key"));
+        QCOMPARE(diagnostics.at(4).severity, Liri::DesktopFileDiagnostic::WarningSeverity);
+    }
+
+    void testSave()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("testSave.desktop"));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::WriteOnly | QFile::Text));
+        file.write("# Managed by the settings\n"
+                   "[Desktop Entry]\n"
+                   "Type=Application\n"
+                   "Name=MyApp\n"
+                   "# The icon\n"
+                   "Icon=foo\n"
+                   "MimeType=text/plain;image/png;;\n"
+                   "\n"
+                   "[Desktop Action new]\n"
+                   "Name=New\n");
+        file.close();
+
+        Liri::DesktopFile df;
+        QVERIFY(df.load(fileName));
+        df.setValue(QStringLiteral("Icon"), QStringLiteral("bar"));
+        df.setValue(QStringLiteral("Terminal"), QStringLiteral("false"));
+        QVERIFY(df.save(fileName));
+
+        QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+        QCOMPARE(file.readAll(),
+                 QByteArray("# Managed by the settings\n"
+                            "[Desktop Entry]\n"
+                            "Type=Application\n"
+                            "Name=MyApp\n"
+                            "# The icon\n"
+                            "Icon=bar\n"
+                            "MimeType=text/plain;image/png;;\n"
+                            "Terminal=false\n"
+                            "\n"
+                            "[Desktop Action new]\n"
+                            "Name=New\n"));
+        file.close();
+    }
+
+    void testSaveDuplicateGroup()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("testSaveDuplicateGroup.desktop"));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::WriteOnly | QFile::Text));
+        file.write("[Desktop Entry]\n"
+                   "Type=Application\n"
+                   "Name=MyApp\n"
+                   "\n"
+                   "[Desktop Action new]\n"
+                   "Name=New\n"
+                   "\n"
+                   "[Desktop Entry]\n"
+                   "Icon=foo\n");
+        file.close();
+
+        Liri::DesktopFile df;
+        QVERIFY(df.load(fileName));
+        df.setValue(QStringLiteral("Terminal"), QStringLiteral("false"));
+        QVERIFY(df.save(fileName));
+
+        // Every key is written once, in the first occurrence of the group
+        QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+        QCOMPARE(file.readAll(),
+                 QByteArray("[Desktop Entry]\n"
+                            "Type=Application\n"
+                            "Name=MyApp\n"
+                            "Icon=foo\n"
+                            "Terminal=false\n"
+                            "\n"
+                            "[Desktop Action new]\n"
+                            "Name=New\n"
+                            "\n"
+                            "[Desktop Entry]\n"));
+        file.close();
+
+        // Saving again changes nothing
+        const QDateTime modified = QFileInfo(fileName).lastModified();
+        QVERIFY(df.load(fileName));
+        QVERIFY(df.save(fileName));
+        QCOMPARE(QFileInfo(fileName).lastModified(), modified);
+    }
+
+    void testTransaction()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("testTransaction.desktop"));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::WriteOnly | QFile::Text));
+        file.write("[Desktop Entry]\n"
+                   "Type=Application\n"
+                   "Name=MyApp\n");
+        file.close();
+
+        Liri::DesktopFile df;
+        QVERIFY(df.load(fileName));
+
+        df.beginTransaction();
+        df.setValue(QStringLiteral("Name"), QStringLiteral("Other"));
+        df.rollback();
+        QVERIFY(!df.isInTransaction());
+        QCOMPARE(df.name(), QStringLiteral("MyApp"));
+
+        df.beginTransaction();
+        df.setValue(QStringLiteral("Hidden"), QStringLiteral("true"));
+        df.setValue(QStringLiteral("X-Liri-Autostart-Phase"), QStringLiteral("Panel"));
+        QVERIFY(df.commit());
+
+        QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+        QCOMPARE(file.readAll(),
+                 QByteArray("[Desktop Entry]\n"
+                            "Type=Application\n"
+                            "Name=MyApp\n"
+                            "Hidden=true\n"
+                            "X-Liri-Autostart-Phase=Panel\n"));
+        file.close();
+    }
+
+private:
+    QTemporaryDir mDir;
 };
 
 QTEST_MAIN(TestDesktopFile)
@@ -0,0 +1,169 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <cstddef>
+#include <functional>
+
+#include "desktopfilestore_p.h"
+
+using Liri::DesktopFileStore;
+
+static QVector<DesktopFileStore::Source> sources()
+{
+    QMap<QString, QVariant> app;
+    app.insert(QStringLiteral("Desktop Entry/Type"), QStringLiteral("Application"));
+    app.insert(QStringLiteral("Desktop Entry/Name"), QStringLiteral("App"));
+    app.insert(QStringLiteral("Desktop Entry/Name[de]"), QStringLiteral("Anwendung"));
+    app.insert(QStringLiteral("Desktop Entry/Comment"), QString());
+    app.insert(QStringLiteral("Desktop Entry/Categories"),
+               QStringList() << QStringLiteral("Game") << QStringLiteral("Utility"));
+    app.insert(QStringLiteral("Desktop Entry/MimeType"), QStringList());
+
+    // Shares most of its strings with the first one
+    QMap<QString, QVariant> other;
+    other.insert(QStringLiteral("Desktop Entry/Type"), QStringLiteral("Application"));
+    other.insert(QStringLiteral("Desktop Entry/Name"), QStringLiteral("Other"));
+    other.insert(QStringLiteral("Desktop Entry/Categories"), QStringList() << QStringLiteral("Game"));
+
+    return QVector<DesktopFileStore::Source>()
+            << qMakePair(QStringLiteral("/usr/share/applications/app.desktop"), app)
+            << qMakePair(QStringLiteral("/usr/share/applications/other.desktop"), other);
+}
+
+static bool rewrite(const QString &fileName, const std::function<void(QByteArray &)> &change)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    QByteArray data = file.readAll();
+    file.close();
+
+    change(data);
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+    return file.write(data) == data.size();
+}
+
+class TestDesktopFileStore : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRoundTrip()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("store.cache"));
+        const QVector<DesktopFileStore::Source> entries = sources();
+
+        QVERIFY(DesktopFileStore::write(fileName, 42, entries));
+
+        DesktopFileStore store;
+        QVERIFY(store.open(fileName, 42));
+        QVERIFY(store.isOpen());
+        QCOMPARE(store.generation(), quint64(1));
+        QCOMPARE(store.size(), quint32(QFileInfo(fileName).size()));
+        QCOMPARE(store.count(), int(entries.size()));
+        for (int i = 0; i < entries.size(); ++i) {
+            QCOMPARE(store.fileName(i), entries.at(i).first);
+            QCOMPARE(store.items(i), entries.at(i).second);
+        }
+
+        // Replacing it bumps the generation
+        QVERIFY(DesktopFileStore::write(fileName, 43, entries));
+        QVERIFY(store.open(fileName, 43));
+        QCOMPARE(store.generation(), quint64(2));
+        QCOMPARE(store.count(), int(entries.size()));
+    }
+
+    void testStaleSourceStamp()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("store.cache"));
+
+        QVERIFY(DesktopFileStore::write(fileName, 42, sources()));
+
+        DesktopFileStore store;
+        QVERIFY(!store.open(fileName, 41));
+        QVERIFY(!store.isOpen());
+        QCOMPARE(store.count(), 0);
+    }
+
+    void testSourceStamp()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("app.desktop"));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("[Desktop Entry]\n");
+        file.close();
+
+        const quint64 stamp = DesktopFileStore::sourceStamp(QFileInfoList() << QFileInfo(fileName));
+        QCOMPARE(DesktopFileStore::sourceStamp(QFileInfoList() << QFileInfo(fileName)), stamp);
+
+        QVERIFY(file.open(QFile::Append));
+        file.write("Name=App\n");
+        file.close();
+
+        QVERIFY(DesktopFileStore::sourceStamp(QFileInfoList() << QFileInfo(fileName)) != stamp);
+        QVERIFY(DesktopFileStore::sourceStamp(QFileInfoList()) != stamp);
+    }
+
+    void testCorrupted_data()
+    {
+        QTest::addColumn<QString>("corruption");
+
+        QTest::newRow("truncated") << QStringLiteral("truncated");
+        QTest::newRow("header-only") << QStringLiteral("header-only");
+        QTest::newRow("trailer-generation") << QStringLiteral("trailer-generation");
+        QTest::newRow("header-generation") << QStringLiteral("header-generation");
+    }
+
+    void testCorrupted()
+    {
+        QFETCH(QString, corruption);
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("store.cache"));
+
+        QVERIFY(DesktopFileStore::write(fileName, 42, sources()));
+
+        // A different generation in the header and in the trailer is
+        // what a torn write leaves behind
+        QVERIFY(rewrite(fileName, [corruption](QByteArray &data) {
+            if (corruption == QLatin1String("truncated"))
+                data.chop(4);
+            else if (corruption == QLatin1String("header-only"))
+                data.truncate(int(sizeof(Liri::DesktopFileStoreHeader) + sizeof(quint64)));
+            else if (corruption == QLatin1String("trailer-generation"))
+                ++data[data.size() - int(sizeof(quint64))];
+            else if (corruption == QLatin1String("header-generation"))
+                ++data[int(offsetof(Liri::DesktopFileStoreHeader, generation))];
+        }));
+
+        DesktopFileStore store;
+        QVERIFY(!store.open(fileName, 42));
+        QVERIFY(!store.isOpen());
+    }
+
+    void testMissing()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        DesktopFileStore store;
+        QVERIFY(!store.open(dir.filePath(QStringLiteral("missing.cache")), 42));
+    }
+};
+
+QTEST_MAIN(TestDesktopFileStore)
+
+#include "tst_desktopfilestore.moc"
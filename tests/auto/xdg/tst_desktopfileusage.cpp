@@ -0,0 +1,133 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/DesktopFileUsage>
+
+static const qint64 day = 24 * 3600 * 1000;
+
+class TestDesktopFileUsage : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRanking()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        Liri::DesktopFileUsage usage(dir.filePath(QStringLiteral("usage.log")));
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+
+        // Used a lot two weeks ago
+        for (int i = 0; i < 8; ++i)
+            usage.recordLaunch(QStringLiteral("old.desktop"), now.addMSecs(-14 * day));
+        // Used a few times this week
+        for (int i = 0; i < 3; ++i)
+            usage.recordLaunch(QStringLiteral("frequent.desktop"), now.addMSecs(-i * day));
+        // Used once, just now
+        usage.recordLaunch(QStringLiteral("recent.desktop"), now);
+
+        QCOMPARE(usage.launchCount(QStringLiteral("old.desktop")), 8);
+        QCOMPARE(usage.mostUsed(2),
+                 QStringList({ QStringLiteral("frequent.desktop"), QStringLiteral("old.desktop") }));
+        QCOMPARE(usage.recentlyUsed(2),
+                 QStringList({ QStringLiteral("recent.desktop"), QStringLiteral("frequent.desktop") }));
+
+        usage.forget(QStringLiteral("frequent.desktop"));
+        QCOMPARE(usage.launchCount(QStringLiteral("frequent.desktop")), 0);
+        QCOMPARE(usage.mostUsed(1), QStringList(QStringLiteral("old.desktop")));
+    }
+
+    void testPersistence()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("usage.log"));
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+
+        {
+            Liri::DesktopFileUsage usage(fileName);
+            usage.recordLaunch(QStringLiteral("a.desktop"), now.addMSecs(-day));
+            usage.recordLaunch(QStringLiteral("b.desktop"), now);
+            usage.recordLaunch(QStringLiteral("b.desktop"), now);
+            usage.flush();
+        }
+
+        Liri::DesktopFileUsage usage(fileName);
+        QCOMPARE(usage.launchCount(QStringLiteral("a.desktop")), 1);
+        QCOMPARE(usage.launchCount(QStringLiteral("b.desktop")), 2);
+        QCOMPARE(usage.lastLaunched(QStringLiteral("b.desktop")), now);
+        QCOMPARE(usage.mostUsed(2), QStringList({ QStringLiteral("b.desktop"), QStringLiteral("a.desktop") }));
+    }
+
+    void testWriteFailure()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+
+        // A file where the directory of the log should be
+        const QString logDir = dir.filePath(QStringLiteral("blocked"));
+        QFile blocker(logDir);
+        QVERIFY(blocker.open(QFile::WriteOnly));
+        blocker.close();
+        const QString fileName = logDir + QStringLiteral("/usage.log");
+
+        {
+            Liri::DesktopFileUsage usage(fileName);
+            usage.recordLaunch(QStringLiteral("a.desktop"), now.addMSecs(-day));
+
+            QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Failed to lock")));
+            usage.flush();
+            QVERIFY(!QFile::exists(fileName));
+
+            // Kept for the next write, in order
+            QVERIFY(QFile::remove(logDir));
+            QVERIFY(QDir().mkpath(logDir));
+            usage.recordLaunch(QStringLiteral("b.desktop"), now);
+            usage.flush();
+        }
+
+        Liri::DesktopFileUsage usage(fileName);
+        QCOMPARE(usage.launchCount(QStringLiteral("a.desktop")), 1);
+        QCOMPARE(usage.launchCount(QStringLiteral("b.desktop")), 1);
+        QCOMPARE(usage.recentlyUsed(2), QStringList({ QStringLiteral("b.desktop"), QStringLiteral("a.desktop") }));
+    }
+
+    void testCompaction()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("usage.log"));
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+
+        {
+            Liri::DesktopFileUsage usage(fileName);
+            // Not used for a year, dropped by the compaction
+            usage.recordLaunch(QStringLiteral("stale.desktop"), now.addMSecs(-365 * day));
+            for (int i = 0; i < 1000; ++i) {
+                usage.recordLaunch(QStringLiteral("app%1.desktop").arg(i % 4), now);
+                if (i % 100 == 0)
+                    usage.flush();
+            }
+            usage.flush();
+        }
+
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::ReadOnly));
+        QVERIFY(file.readAll().count('\n') < 300);
+        file.close();
+
+        Liri::DesktopFileUsage usage(fileName);
+        for (int i = 0; i < 4; ++i)
+            QCOMPARE(usage.launchCount(QStringLiteral("app%1.desktop").arg(i)), 250);
+        QCOMPARE(usage.recentlyUsed(10).size(), 4);
+    }
+};
+
+QTEST_MAIN(TestDesktopFileUsage)
+
+#include "tst_desktopfileusage.moc"
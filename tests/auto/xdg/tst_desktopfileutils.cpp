@@ -0,0 +1,180 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include "desktopfileutils_p.h"
+
+class TestDesktopFileUtils : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testUnEscape_data()
+    {
+        QTest::addColumn<QString>("escaped");
+        QTest::addColumn<QString>("expected");
+
+        // Every entry of the table
+        QTest::newRow("backslash") << QStringLiteral("a\\\\b") << QStringLiteral("a\\b");
+        QTest::newRow("space") << QStringLiteral("a\\sb") << QStringLiteral("a b");
+        QTest::newRow("newline") << QStringLiteral("a\\nb") << QStringLiteral("a\nb");
+        QTest::newRow("tab") << QStringLiteral("a\\tb") << QStringLiteral("a\tb");
+        QTest::newRow("carriage-return") << QStringLiteral("a\\rb") << QStringLiteral("a\rb");
+
+        QTest::newRow("unknown") << QStringLiteral("a\\qb") << QStringLiteral("a\\qb");
+        QTest::newRow("not-ascii") << QStringLiteral("a\\\u00e9b") << QStringLiteral("a\\\u00e9b");
+        QTest::newRow("leading") << QStringLiteral("\\nb") << QStringLiteral("\nb");
+        QTest::newRow("adjacent") << QStringLiteral("\\n\\t\\\\") << QStringLiteral("\n\t\\");
+        QTest::newRow("escaped-sequence") << QStringLiteral("\\\\n") << QStringLiteral("\\n");
+
+        // A trailing backslash escapes nothing and is kept
+        QTest::newRow("trailing") << QStringLiteral("ab\\") << QStringLiteral("ab\\");
+        QTest::newRow("trailing-after-sequence") << QStringLiteral("a\\nb\\") << QStringLiteral("a\nb\\");
+        QTest::newRow("trailing-odd") << QStringLiteral("a\\\\\\") << QStringLiteral("a\\\\");
+        QTest::newRow("only-backslash") << QStringLiteral("\\") << QStringLiteral("\\");
+    }
+
+    void testUnEscape()
+    {
+        QFETCH(QString, escaped);
+        QFETCH(QString, expected);
+
+        QCOMPARE(unEscape(escaped), expected);
+    }
+
+    void testUnEscapeExec_data()
+    {
+        QTest::addColumn<QString>("escaped");
+        QTest::addColumn<QString>("expected");
+
+        // Every reserved character, quoted and then escaped as a string
+        const QString reserved = QStringLiteral("\"'\\><~|&;$*?#()`");
+        for (const QChar c : reserved) {
+            const QString name = QStringLiteral("reserved-%1").arg(c);
+            QTest::newRow(qPrintable(name)) << QStringLiteral("a\\\\%1b").arg(c) << QStringLiteral("a%1b").arg(c);
+        }
+
+        // Whitespace is replaced by markers that survive the splitting
+        QTest::newRow("space") << QStringLiteral("a\\\\ b") << QStringLiteral("a\01b");
+        QTest::newRow("tab") << QStringLiteral("a\\\\\tb") << QStringLiteral("a\02b");
+        QTest::newRow("newline") << QStringLiteral("a\\\\\nb") << QStringLiteral("a\03b");
+
+        // Only the string escapes apply to an unknown character
+        QTest::newRow("unknown") << QStringLiteral("a\\\\qb") << QStringLiteral("a\\qb");
+        QTest::newRow("string-newline") << QStringLiteral("a\\nb") << QStringLiteral("a\nb");
+        QTest::newRow("literal-backslash") << QStringLiteral("a\\\\\\\\b") << QStringLiteral("a\\b");
+
+        QTest::newRow("trailing") << QStringLiteral("ab\\") << QStringLiteral("ab\\");
+        QTest::newRow("trailing-after-string-escape") << QStringLiteral("ab\\\\") << QStringLiteral("ab\\");
+    }
+
+    void testUnEscapeExec()
+    {
+        QFETCH(QString, escaped);
+        QFETCH(QString, expected);
+
+        QCOMPARE(unEscapeExec(escaped), expected);
+    }
+
+    void testEscape_data()
+    {
+        QTest::addColumn<QString>("value");
+        QTest::addColumn<QString>("expected");
+
+        QTest::newRow("backslash") << QStringLiteral("a\\b") << QStringLiteral("a\\\\b");
+        QTest::newRow("newline") << QStringLiteral("a\nb") << QStringLiteral("a\\nb");
+        QTest::newRow("tab") << QStringLiteral("a\tb") << QStringLiteral("a\\tb");
+        QTest::newRow("carriage-return") << QStringLiteral("a\rb") << QStringLiteral("a\\rb");
+        QTest::newRow("space") << QStringLiteral("a b") << QStringLiteral("a b");
+        QTest::newRow("sequence") << QStringLiteral("a\\nb") << QStringLiteral("a\\\\nb");
+        QTest::newRow("trailing") << QStringLiteral("ab\\") << QStringLiteral("ab\\\\");
+        QTest::newRow("mixed") << QStringLiteral("\n\\\t\u00e9\r") << QStringLiteral("\\n\\\\\\t\u00e9\\r");
+        QTest::newRow("empty") << QString() << QString();
+    }
+
+    void testEscape()
+    {
+        QFETCH(QString, value);
+        QFETCH(QString, expected);
+
+        QString escaped = value;
+        QCOMPARE(escape(escaped), expected);
+        QCOMPARE(unEscape(escaped), value);
+    }
+
+    void testEscapeExec_data()
+    {
+        QTest::addColumn<QString>("value");
+        QTest::addColumn<QString>("expected");
+
+        QTest::newRow("double-quote") << QStringLiteral("a\"b") << QStringLiteral("a\\\\\"b");
+        QTest::newRow("single-quote") << QStringLiteral("a'b") << QStringLiteral("a\\\\'b");
+        QTest::newRow("dollar") << QStringLiteral("a$b") << QStringLiteral("a\\\\$b");
+        QTest::newRow("backtick") << QStringLiteral("a`b") << QStringLiteral("a\\\\`b");
+
+        // Four successive backslashes for a literal one
+        QTest::newRow("backslash") << QStringLiteral("a\\b") << QStringLiteral("a\\\\\\\\b");
+        QTest::newRow("backslash-space") << QStringLiteral("a\\ b") << QStringLiteral("a\\\\\\\\ b");
+        QTest::newRow("backslash-dollar") << QStringLiteral("a\\$b") << QStringLiteral("a\\\\\\\\\\\\$b");
+        QTest::newRow("trailing") << QStringLiteral("ab\\") << QStringLiteral("ab\\\\\\\\");
+
+        QTest::newRow("newline") << QStringLiteral("a\nb") << QStringLiteral("a\\nb");
+        QTest::newRow("space") << QStringLiteral("a b") << QStringLiteral("a b");
+    }
+
+    void testEscapeExec()
+    {
+        QFETCH(QString, value);
+        QFETCH(QString, expected);
+
+        QString escaped = value;
+        QCOMPARE(escapeExec(escaped), expected);
+        QCOMPARE(unEscapeExec(escaped), value);
+    }
+
+    void testUntouched_data()
+    {
+        QTest::addColumn<QString>("value");
+
+        QTest::newRow("plain") << QStringLiteral("Plain value with spaces");
+        QTest::newRow("not-ascii") << QStringLiteral("\u00e9\u4e2d\u6587");
+        QTest::newRow("empty") << QString();
+    }
+
+    void testUntouched()
+    {
+        QFETCH(QString, value);
+
+        // Nothing to do, the strings still share the data of value
+        QString escaped = value;
+        QCOMPARE(escape(escaped), value);
+        QCOMPARE(escaped.constData(), value.constData());
+
+        QString escapedExec = value;
+        QCOMPARE(escapeExec(escapedExec), value);
+        QCOMPARE(escapedExec.constData(), value.constData());
+
+        QString unEscaped = value;
+        QCOMPARE(unEscape(unEscaped), value);
+        QCOMPARE(unEscaped.constData(), value.constData());
+
+        QString unEscapedExec = value;
+        QCOMPARE(unEscapeExec(unEscapedExec), value);
+        QCOMPARE(unEscapedExec.constData(), value.constData());
+    }
+
+    void testUntouchedUnknownSequence()
+    {
+        // Backslashes followed by nothing to replace don't copy either
+        const QString value = QStringLiteral("C:\\Program Files\\");
+        QString unEscaped = value;
+        QCOMPARE(unEscape(unEscaped), value);
+        QCOMPARE(unEscaped.constData(), value.constData());
+    }
+};
+
+QTEST_MAIN(TestDesktopFileUtils)
+
+#include "tst_desktopfileutils.moc"
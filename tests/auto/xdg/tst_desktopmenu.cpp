@@ -0,0 +1,933 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/DesktopMenu>
+#include <LiriXdg/DesktopMenuModel>
+
+static QDomElement parseMenu(QDomDocument &doc, const QString &xml)
+{
+    doc.setContent(xml);
+    return doc.documentElement();
+}
+
+static QString describe(const Liri::DesktopMenuChange &change)
+{
+    static const char *const types[] = { "removed", "inserted", "changed" };
+    const QString item = change.element.tagName() == QLatin1String("AppLink")
+            ? change.element.attribute(QStringLiteral("id"))
+            : change.element.tagName();
+    return QStringLiteral("%1 %2:%3 %4")
+            .arg(QLatin1String(types[change.type]), change.menuPath)
+            .arg(change.row)
+            .arg(item);
+}
+
+static QStringList describeChanges(const QList<Liri::DesktopMenuChange> &changes)
+{
+    QStringList result;
+    for (const Liri::DesktopMenuChange &change : changes)
+        result.append(describe(change));
+    return result;
+}
+
+static bool writeFile(const QString &fileName, const QString &contents)
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+    return file.write(contents.toUtf8()) >= 0;
+}
+
+static QString desktopEntry(const QString &name, const QString &extra = QString())
+{
+    return QStringLiteral("[Desktop Entry]\n"
+                          "Type=Application\n"
+                          "Name=%1\n"
+                          "Exec=%1\n").arg(name) + extra;
+}
+
+static QString menuXml(const QString &body)
+{
+    return QStringLiteral("<!DOCTYPE Menu PUBLIC \"-//freedesktop//DTD Menu 1.0//EN\"\n"
+                          " \"http://www.freedesktop.org/standards/menu-spec/menu-1.0.dtd\">\n"
+                          "<Menu><Name>Applications</Name>%1</Menu>\n").arg(body);
+}
+
+/*
+ * Menus as "name[children]", AppLinks by id and separators as "-".
+ */
+static QString dump(const QDomElement &menu)
+{
+    QStringList items;
+    for (QDomElement e = menu.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        if (e.tagName() == QLatin1String("Menu"))
+            items.append(dump(e));
+        else if (e.tagName() == QLatin1String("AppLink"))
+            items.append(e.attribute(QStringLiteral("id")));
+        else if (e.tagName() == QLatin1String("Separator"))
+            items.append(QStringLiteral("-"));
+    }
+    return menu.attribute(QStringLiteral("name")) + QLatin1Char('[') + items.join(QLatin1Char(',')) + QLatin1Char(']');
+}
+
+/*
+ * Same as above, but each sub-menu is requested with DesktopMenu::menu()
+ * so that lazy menus are built.
+ */
+static QString dump(Liri::DesktopMenu &menu, const QString &path = QString())
+{
+    const QDomElement element = menu.menu(path);
+
+    QList<QDomElement> children;
+    for (QDomElement e = element.firstChildElement(); !e.isNull(); e = e.nextSiblingElement())
+        children.append(e);
+
+    QStringList items;
+    for (const QDomElement &e : children) {
+        if (e.tagName() == QLatin1String("Menu")) {
+            const QString name = e.attribute(QStringLiteral("name"));
+            const QString childPath = path.isEmpty() ? name : path + QLatin1Char('/') + name;
+            if (!menu.menu(childPath).isNull())
+                items.append(dump(menu, childPath));
+        } else if (e.tagName() == QLatin1String("AppLink")) {
+            items.append(e.attribute(QStringLiteral("id")));
+        } else if (e.tagName() == QLatin1String("Separator")) {
+            items.append(QStringLiteral("-"));
+        }
+    }
+    return element.attribute(QStringLiteral("name")) + QLatin1Char('[') + items.join(QLatin1Char(',')) + QLatin1Char(']');
+}
+
+/*
+ * Same as above, leaving out what isn't visible in the preview environment.
+ */
+static QString dumpVisible(Liri::DesktopMenu &menu, int environment, const QString &path = QString())
+{
+    const QDomElement element = menu.menu(path);
+
+    QList<QDomElement> children;
+    for (QDomElement e = element.firstChildElement(); !e.isNull(); e = e.nextSiblingElement())
+        children.append(e);
+
+    QStringList items;
+    for (const QDomElement &e : children) {
+        if (e.tagName() == QLatin1String("Menu")) {
+            // Lazy menus get their mask when they are built
+            const QString name = e.attribute(QStringLiteral("name"));
+            const QString childPath = path.isEmpty() ? name : path + QLatin1Char('/') + name;
+            const QDomElement child = menu.menu(childPath);
+            if (!child.isNull() && Liri::DesktopMenu::isVisibleIn(child, environment))
+                items.append(dumpVisible(menu, environment, childPath));
+        } else if (!Liri::DesktopMenu::isVisibleIn(e, environment)) {
+            continue;
+        } else if (e.tagName() == QLatin1String("AppLink")) {
+            items.append(e.attribute(QStringLiteral("id")));
+        } else if (e.tagName() == QLatin1String("Separator")) {
+            items.append(QStringLiteral("-"));
+        }
+    }
+    return element.attribute(QStringLiteral("name")) + QLatin1Char('[') + items.join(QLatin1Char(',')) + QLatin1Char(']');
+}
+
+/*
+ * The "visibleIn" masks of the sub-menus by name and of the AppLinks by id.
+ */
+static void collectMasks(const QDomElement &menu, QHash<QString, QString> *masks)
+{
+    for (QDomElement e = menu.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        if (e.tagName() == QLatin1String("Menu")) {
+            masks->insert(e.attribute(QStringLiteral("name")), e.attribute(QStringLiteral("visibleIn")));
+            collectMasks(e, masks);
+        } else if (e.tagName() == QLatin1String("AppLink")) {
+            masks->insert(e.attribute(QStringLiteral("id")), e.attribute(QStringLiteral("visibleIn")));
+        }
+    }
+}
+
+/*
+ * Elements with their sorted attributes, text and children.
+ */
+static QString dumpTree(const QDomElement &element)
+{
+    QStringList attributes;
+    const QDomNamedNodeMap map = element.attributes();
+    for (int i = 0; i < map.count(); ++i)
+        attributes.append(map.item(i).nodeName() + QLatin1Char('=') + map.item(i).nodeValue());
+    attributes.sort();
+
+    QString text;
+    QStringList children;
+    for (QDomNode n = element.firstChild(); !n.isNull(); n = n.nextSibling()) {
+        if (n.isElement())
+            children.append(dumpTree(n.toElement()));
+        else if (n.isText())
+            text += n.toText().data();
+    }
+
+    return QStringLiteral("<%1 %2>%3[%4]").arg(element.tagName(), attributes.join(QLatin1Char(' ')), text,
+                                               children.join(QLatin1Char(',')));
+}
+
+/*
+ * The QDomDocument reader that was replaced by the streaming one, limited
+ * to the merge tags with no default locations.
+ */
+static bool referenceLoad(const QString &fileName, const QString &parentFileName,
+                          QStringList branchFiles, QDomDocument *doc);
+
+static void referenceMergeFile(const QString &fileName, const QString &dirName, QDomElement &element,
+                               const QString &parentFileName, const QStringList &branchFiles,
+                               QStringList *mergedFiles)
+{
+    const QFileInfo fileInfo(QDir(dirName), fileName);
+    if (!fileInfo.exists() || mergedFiles->contains(fileInfo.canonicalFilePath()))
+        return;
+    mergedFiles->append(fileInfo.canonicalFilePath());
+
+    QDomDocument merged;
+    if (!referenceLoad(fileInfo.canonicalFilePath(), parentFileName, branchFiles, &merged))
+        return;
+
+    for (QDomElement n = merged.documentElement().firstChildElement(); !n.isNull(); n = n.nextSiblingElement()) {
+        if (n.tagName() != QLatin1String("Name"))
+            element.parentNode().insertBefore(element.ownerDocument().importNode(n, true), element);
+    }
+}
+
+static void referenceMergeTags(QDomElement &element, const QString &fileName, const QStringList &branchFiles)
+{
+    const QString dirName = QFileInfo(fileName).absolutePath();
+    QStringList mergedFiles;
+
+    QDomElement n = element.lastChildElement();
+    while (!n.isNull()) {
+        QDomElement previous = n.previousSiblingElement();
+
+        if (n.tagName() == QLatin1String("MergeFile")) {
+            referenceMergeFile(n.text(), dirName, n, fileName, branchFiles, &mergedFiles);
+            element.removeChild(n);
+        } else if (n.tagName() == QLatin1String("MergeDir")) {
+            const QFileInfo dirInfo(dirName, n.text());
+            if (dirInfo.isDir()) {
+                const QFileInfoList files = QDir(dirInfo.canonicalFilePath())
+                        .entryInfoList(QStringList(QStringLiteral("*.menu")), QDir::Files | QDir::Readable);
+                for (const QFileInfo &file : files)
+                    referenceMergeFile(file.absoluteFilePath(), dirName, n, fileName, branchFiles, &mergedFiles);
+            }
+            element.removeChild(n);
+        } else if (n.tagName() == QLatin1String("AppDir") || n.tagName() == QLatin1String("DirectoryDir")) {
+            const QFileInfo dirInfo(dirName, n.text());
+            if (dirInfo.isDir()) {
+                QDomElement dir = element.ownerDocument().createElement(n.tagName());
+                dir.appendChild(element.ownerDocument().createTextNode(dirInfo.canonicalFilePath()));
+                element.insertBefore(dir, n);
+            }
+            element.removeChild(n);
+        } else if (n.tagName() == QLatin1String("Menu")) {
+            referenceMergeTags(n, fileName, branchFiles);
+        }
+
+        n = previous;
+    }
+}
+
+static bool referenceLoad(const QString &fileName, const QString &parentFileName,
+                          QStringList branchFiles, QDomDocument *doc)
+{
+    const QString canonicalFileName = QFileInfo(fileName).canonicalFilePath();
+    if (branchFiles.contains(canonicalFileName))
+        return false;
+    branchFiles.append(canonicalFileName);
+
+    QFile file(canonicalFileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text) || !doc->setContent(&file, true))
+        return false;
+
+    QDomElement root = doc->documentElement();
+    QDomElement fileInfo = doc->createElement(QStringLiteral("FileInfo"));
+    fileInfo.setAttribute(QStringLiteral("file"), canonicalFileName);
+    if (!parentFileName.isEmpty())
+        fileInfo.setAttribute(QStringLiteral("parent"), parentFileName);
+    root.appendChild(fileInfo);
+
+    referenceMergeTags(root, canonicalFileName, branchFiles);
+    return true;
+}
+
+static QString readerOutput(const QString &logDir)
+{
+    QFile file(logDir + QStringLiteral("/00-reader.xml"));
+    QDomDocument doc;
+    if (!file.open(QFile::ReadOnly | QFile::Text) || !doc.setContent(&file))
+        return QString();
+    return dumpTree(doc.documentElement());
+}
+
+class TestDesktopMenu : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        // Keeps the desktop file cache and its store away from the user's files
+        qputenv("XDG_DATA_HOME", mDir.filePath(QStringLiteral("home")).toLocal8Bit());
+        qputenv("XDG_DATA_DIRS", mDir.filePath(QStringLiteral("data")).toLocal8Bit());
+        qputenv("XDG_CACHE_HOME", mDir.filePath(QStringLiteral("cache")).toLocal8Bit());
+    }
+
+    void testDiff()
+    {
+        QDomDocument oldDoc;
+        const QDomElement oldMenu = parseMenu(oldDoc, QStringLiteral(
+                "<Menu name=\"Applications\">"
+                "<AppLink id=\"a\"/><AppLink id=\"b\" title=\"B\"/>"
+                "<Menu name=\"Games\"><AppLink id=\"x\"/></Menu>"
+                "<Separator/><AppLink id=\"c\"/>"
+                "</Menu>"));
+
+        QDomDocument newDoc;
+        const QDomElement newMenu = parseMenu(newDoc, QStringLiteral(
+                "<Menu name=\"Applications\">"
+                "<AppLink id=\"b\" title=\"B2\"/><AppLink id=\"a\"/>"
+                "<Menu name=\"Games\"><AppLink id=\"x\"/><AppLink id=\"y\"/></Menu>"
+                "<AppLink id=\"d\"/>"
+                "</Menu>"));
+
+        QStringList changes;
+        const QList<Liri::DesktopMenuChange> diff = Liri::DesktopMenu::diff(oldMenu, newMenu);
+        for (const Liri::DesktopMenuChange &change : diff)
+            changes.append(describe(change));
+
+        const QStringList expected = {
+            QStringLiteral("removed :4 c"),
+            QStringLiteral("removed :3 Separator"),
+            QStringLiteral("removed :0 a"),
+            QStringLiteral("inserted :1 a"),
+            QStringLiteral("inserted :3 d"),
+            QStringLiteral("changed :0 b"),
+            QStringLiteral("inserted Games:1 y"),
+        };
+        QCOMPARE(changes, expected);
+    }
+
+    void testDiffUnchanged()
+    {
+        const QString xml = QStringLiteral(
+                "<Menu name=\"Applications\">"
+                "<Menu name=\"Games\"><AppLink id=\"x\" title=\"X\"/></Menu>"
+                "<Separator/><AppLink id=\"a\"/>"
+                "</Menu>");
+
+        QDomDocument oldDoc;
+        QDomDocument newDoc;
+        QVERIFY(Liri::DesktopMenu::diff(parseMenu(oldDoc, xml), parseMenu(newDoc, xml)).isEmpty());
+    }
+
+    void testChangedOnMove()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("move/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/g1.desktop"), desktopEntry(QStringLiteral("G1"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/r1.desktop"), desktopEntry(QStringLiteral("R1"))));
+
+        const QString menuFileName = mDir.filePath(QStringLiteral("move/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Include><Filename>r1.desktop</Filename></Include>"
+                "<Menu><Name>Games</Name><Include><Filename>g1.desktop</Filename></Include></Menu>").arg(apps))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        menu.setRebuildDelay(0);
+        QVERIFY(menu.read(menuFileName));
+        QCOMPARE(dump(menu.xml().documentElement()), QStringLiteral("Applications[Games[g1.desktop],r1.desktop]"));
+
+        // Same elements in the same order, only r1 moved into Games
+        QSignalSpy spy(&menu, &Liri::DesktopMenu::changed);
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Menu><Name>Games</Name><Include>"
+                "<Filename>g1.desktop</Filename><Filename>r1.desktop</Filename>"
+                "</Include></Menu>").arg(apps))));
+        QVERIFY(spy.wait());
+
+        QCOMPARE(dump(menu.xml().documentElement()), QStringLiteral("Applications[Games[g1.desktop,r1.desktop]]"));
+
+        QStringList changes;
+        const QList<Liri::DesktopMenuChange> diff = menu.changes();
+        for (const Liri::DesktopMenuChange &change : diff)
+            changes.append(describe(change));
+        const QStringList expected = {
+            QStringLiteral("removed :1 r1.desktop"),
+            QStringLiteral("inserted Games:1 r1.desktop"),
+        };
+        QCOMPARE(changes, expected);
+    }
+
+    void testLazyInline()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("inline/apps"));
+        for (const QString &name : { QStringLiteral("p1"), QStringLiteral("c1"), QStringLiteral("g1") })
+            QVERIFY(writeFile(QStringLiteral("%1/%2.desktop").arg(apps, name), desktopEntry(name.toUpper())));
+
+        // Inlining Child moves Grand into Parent
+        const QString menuFileName = mDir.filePath(QStringLiteral("inline/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Menu><Name>Parent</Name>"
+                "<Layout><Menuname inline=\"true\" inline_header=\"false\">Child</Menuname><Merge type=\"all\"/></Layout>"
+                "<Include><Filename>p1.desktop</Filename></Include>"
+                "<Menu><Name>Child</Name>"
+                "<Include><Filename>c1.desktop</Filename></Include>"
+                "<Menu><Name>Grand</Name><Include><Filename>g1.desktop</Filename></Include></Menu>"
+                "</Menu>"
+                "</Menu>").arg(apps))));
+
+        const QString expected = QStringLiteral("Applications[Parent[Grand[g1.desktop],c1.desktop,p1.desktop]]");
+
+        Liri::DesktopMenu eager;
+        eager.setEnvironments(QStringLiteral("X-Test"));
+        QVERIFY(eager.read(menuFileName));
+        QCOMPARE(dump(eager), expected);
+
+        Liri::DesktopMenu lazy;
+        lazy.setEnvironments(QStringLiteral("X-Test"));
+        lazy.setLazy(true);
+        QVERIFY(lazy.read(menuFileName));
+        QCOMPARE(dump(lazy), expected);
+    }
+
+    void testLazyChanged()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("lazychanged/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/g1.desktop"), desktopEntry(QStringLiteral("G1"), QStringLiteral("Categories=Game;\n"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/r1.desktop"), desktopEntry(QStringLiteral("R1"))));
+
+        const QString menuFileName = mDir.filePath(QStringLiteral("lazychanged/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Include><Filename>r1.desktop</Filename></Include>"
+                "<Menu><Name>Games</Name><Include><Category>Game</Category></Include></Menu>").arg(apps))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        menu.setRebuildDelay(0);
+        menu.setLazy(true);
+        QVERIFY(menu.read(menuFileName));
+        QCOMPARE(dump(menu), QStringLiteral("Applications[Games[g1.desktop],r1.desktop]"));
+
+        // Only the skeleton of Games is rebuilt, which looks the same
+        QSignalSpy spy(&menu, &Liri::DesktopMenu::changed);
+        QVERIFY(writeFile(apps + QStringLiteral("/g2.desktop"), desktopEntry(QStringLiteral("G2"), QStringLiteral("Categories=Game;\n"))));
+        QVERIFY(spy.wait());
+        QCOMPARE(dump(menu), QStringLiteral("Applications[Games[g1.desktop,g2.desktop],r1.desktop]"));
+
+        // Games was built before, its entries are compared
+        QCOMPARE(describeChanges(menu.changes()), QStringList(QStringLiteral("inserted Games:1 g2.desktop")));
+
+        QVERIFY(QFile::remove(apps + QStringLiteral("/g1.desktop")));
+        QVERIFY(spy.wait());
+        QCOMPARE(describeChanges(menu.changes()), QStringList(QStringLiteral("removed Games:0 g1.desktop")));
+        QCOMPARE(dump(menu), QStringLiteral("Applications[Games[g2.desktop],r1.desktop]"));
+    }
+
+    void testReader()
+    {
+        const QString dir = mDir.filePath(QStringLiteral("reader"));
+        QVERIFY(writeFile(dir + QStringLiteral("/apps/a.desktop"), desktopEntry(QStringLiteral("A"))));
+
+        // Merged last to first, duplicates and loops are skipped
+        QVERIFY(writeFile(dir + QStringLiteral("/applications.menu"), menuXml(QStringLiteral(
+                "<AppDir>apps</AppDir>"
+                "<DirectoryDir>missing</DirectoryDir>"
+                "<MergeFile>extra.menu</MergeFile>"
+                "<Menu><Name>Games</Name>"
+                "<Include><Category>Game</Category></Include>"
+                "<MergeFile type=\"path\">games.menu</MergeFile>"
+                "</Menu>"
+                "<MergeDir>merged</MergeDir>"
+                "<MergeFile>extra.menu</MergeFile>"
+                "<MergeFile>applications.menu</MergeFile>"
+                "<MergeFile>missing.menu</MergeFile>"
+                "<Layout><Merge type=\"menus\"/><Filename>a&amp;b.desktop</Filename></Layout>"))));
+        QVERIFY(writeFile(dir + QStringLiteral("/extra.menu"), menuXml(QStringLiteral(
+                "<Include><Filename>x.desktop</Filename></Include>"
+                "<MergeFile>sub/nested.menu</MergeFile>"
+                "<Menu><Name>Office</Name><Deleted/></Menu>"))));
+        QVERIFY(writeFile(dir + QStringLiteral("/sub/nested.menu"), menuXml(QStringLiteral(
+                "<AppDir>../apps</AppDir>"
+                "<Exclude><Filename>y.desktop</Filename></Exclude>"
+                "<MergeFile>../extra.menu</MergeFile>"))));
+        QVERIFY(writeFile(dir + QStringLiteral("/games.menu"), menuXml(QStringLiteral(
+                "<Menu><Name>Puzzle</Name><Include><Filename>puzzle.desktop</Filename></Include></Menu>"))));
+        QVERIFY(writeFile(dir + QStringLiteral("/merged/one.menu"), menuXml(QStringLiteral(
+                "<Menu><Name>One</Name><OnlyUnallocated/></Menu>"))));
+        QVERIFY(writeFile(dir + QStringLiteral("/merged/two.menu"), menuXml(QStringLiteral(
+                "<Menu><Name>Two</Name><Directory>two.directory</Directory></Menu>"))));
+        QVERIFY(writeFile(dir + QStringLiteral("/merged/three.txt"), menuXml(QString())));
+
+        const QString logDir = dir + QStringLiteral("/log");
+        QVERIFY(QDir().mkpath(logDir));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        menu.setLogDir(logDir);
+        QVERIFY(menu.read(dir + QStringLiteral("/applications.menu")));
+
+        QDomDocument expected;
+        QVERIFY(referenceLoad(dir + QStringLiteral("/applications.menu"), QString(), QStringList(), &expected));
+        QCOMPARE(readerOutput(logDir), dumpTree(expected.documentElement()));
+    }
+
+    void testFragmentCache()
+    {
+        const QString dir = mDir.filePath(QStringLiteral("fragments"));
+        const QString menuFileName = dir + QStringLiteral("/applications.menu");
+        const QString mergedFileName = dir + QStringLiteral("/merged.menu");
+        const QString logDir = dir + QStringLiteral("/log");
+        QVERIFY(QDir().mkpath(logDir));
+
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral("<MergeFile>merged.menu</MergeFile>"))));
+        QVERIFY(writeFile(mergedFileName, menuXml(QStringLiteral("<Include><Filename>x1.desktop</Filename></Include>"))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        menu.setLogDir(logDir);
+        QVERIFY(menu.read(menuFileName));
+        QVERIFY(readerOutput(logDir).contains(QLatin1String("x1.desktop")));
+
+        const auto modified = [&mergedFileName]() {
+            QFile file(mergedFileName);
+            return file.open(QFile::ReadOnly) ? file.fileTime(QFile::FileModificationTime) : QDateTime();
+        };
+        const auto setModified = [&mergedFileName](const QDateTime &time) {
+            QFile file(mergedFileName);
+            return file.open(QFile::ReadWrite) && file.setFileTime(time, QFile::FileModificationTime);
+        };
+
+        // Same size, newer modification time
+        const QDateTime before = modified();
+        QVERIFY(writeFile(mergedFileName, menuXml(QStringLiteral("<Include><Filename>x2.desktop</Filename></Include>"))));
+        QVERIFY(setModified(before.addSecs(1)));
+        QVERIFY(menu.read(menuFileName));
+        QVERIFY(readerOutput(logDir).contains(QLatin1String("x2.desktop")));
+
+        // Same modification time, other size
+        const QDateTime same = modified();
+        QVERIFY(writeFile(mergedFileName, menuXml(QStringLiteral("<Include><Filename>x33.desktop</Filename></Include>"))));
+        QVERIFY(setModified(same));
+        QCOMPARE(modified(), same);
+        QVERIFY(menu.read(menuFileName));
+        QVERIFY(readerOutput(logDir).contains(QLatin1String("x33.desktop")));
+
+        // A file that is merged again is built from the cache the same way
+        const QString output = readerOutput(logDir);
+        QVERIFY(menu.read(menuFileName));
+        QCOMPARE(readerOutput(logDir), output);
+    }
+
+    void testReadAsync()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("async/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/a1.desktop"), desktopEntry(QStringLiteral("A1"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/b1.desktop"), desktopEntry(QStringLiteral("B1"))));
+
+        const QString aFileName = mDir.filePath(QStringLiteral("async/a.menu"));
+        const QString bFileName = mDir.filePath(QStringLiteral("async/b.menu"));
+        QVERIFY(writeFile(aFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir><Include><Filename>a1.desktop</Filename></Include>").arg(apps))));
+        QVERIFY(writeFile(bFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir><Include><Filename>b1.desktop</Filename></Include>").arg(apps))));
+
+        const QString a = QStringLiteral("Applications[a1.desktop]");
+        const QString b = QStringLiteral("Applications[b1.desktop]");
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        QVERIFY(!menu.isReading());
+
+        QSignalSpy finished(&menu, &Liri::DesktopMenu::readFinished);
+
+        menu.readAsync(aFileName);
+        QVERIFY(menu.isReading());
+        QVERIFY(finished.wait());
+        QCOMPARE(finished.count(), 1);
+        QVERIFY(!menu.isReading());
+        QCOMPARE(dump(menu.xml().documentElement()), a);
+        QCOMPARE(menu.menuFileName(), aFileName);
+
+        // A second readAsync() cancels the first one
+        finished.clear();
+        menu.readAsync(aFileName);
+        menu.readAsync(bFileName);
+        QVERIFY(menu.isReading());
+        QVERIFY(finished.wait());
+        QVERIFY(!finished.wait(500));
+        QCOMPARE(finished.count(), 1);
+        QCOMPARE(finished.at(0).at(0).toBool(), true);
+        QCOMPARE(dump(menu.xml().documentElement()), b);
+
+        // So does read(), the result of the worker is dropped
+        finished.clear();
+        menu.readAsync(aFileName);
+        QVERIFY(menu.isReading());
+        QVERIFY(menu.read(bFileName));
+        QVERIFY(!menu.isReading());
+        QCOMPARE(finished.count(), 1);
+        QVERIFY(!finished.wait(500));
+        QCOMPARE(finished.count(), 1);
+        QCOMPARE(dump(menu.xml().documentElement()), b);
+        QCOMPARE(menu.menuFileName(), bFileName);
+
+        // Failures are reported too
+        finished.clear();
+        menu.readAsync(mDir.filePath(QStringLiteral("async/missing.menu")));
+        QVERIFY(finished.wait());
+        QCOMPARE(finished.at(0).at(0).toBool(), false);
+        QVERIFY(!menu.errorString().isEmpty());
+        QVERIFY(!menu.isReading());
+    }
+
+    void testProfile()
+    {
+        const QString dir = mDir.filePath(QStringLiteral("profile"));
+        const QString menuFileName = dir + QStringLiteral("/applications.menu");
+        const QString mergedFileName = dir + QStringLiteral("/merged.menu");
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral("<MergeFile>merged.menu</MergeFile>"))));
+        QVERIFY(writeFile(mergedFileName, menuXml(QStringLiteral("<Menu><Name>Games</Name></Menu>"))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        QVERIFY(!menu.isProfiling());
+        QVERIFY(menu.read(menuFileName));
+        QVERIFY(menu.profile().isEmpty());
+
+        menu.setProfiling(true);
+        QVERIFY(menu.read(menuFileName));
+
+        // Merged files complete before the file merging them
+        const QList<Liri::DesktopMenuProfileEntry> profile = menu.profile();
+        QStringList names;
+        for (const Liri::DesktopMenuProfileEntry &entry : profile) {
+            names.append(entry.category + QLatin1Char(':') + QFileInfo(entry.name).fileName());
+            QVERIFY(entry.start >= 0);
+            QVERIFY(entry.duration >= 0);
+            QVERIFY(entry.nodes > 0);
+            QVERIFY(entry.allocatedBytes >= -1);
+        }
+        const QStringList expected = {
+            QStringLiteral("file:merged.menu"),
+            QStringLiteral("file:applications.menu"),
+            QStringLiteral("pass:reader"),
+            QStringLiteral("pass:simplify"),
+            QStringLiteral("pass:mergeMenus"),
+            QStringLiteral("pass:moveMenus"),
+            QStringLiteral("pass:mergeMenus"),
+            QStringLiteral("pass:deleteDeletedMenus"),
+            QStringLiteral("pass:processDirectoryEntries"),
+            QStringLiteral("pass:processApps"),
+            QStringLiteral("pass:processLayouts"),
+            QStringLiteral("pass:deleteEmpty"),
+            QStringLiteral("pass:fixSeparators"),
+        };
+        QCOMPARE(names, expected);
+        QCOMPARE(profile.at(0).name, QFileInfo(mergedFileName).canonicalFilePath());
+
+        // Passes run one after the other
+        for (int i = 3; i < profile.count(); ++i)
+            QVERIFY(profile.at(i).start >= profile.at(i - 1).start + profile.at(i - 1).duration);
+
+        // Trace Event Format
+        const QString traceFileName = dir + QStringLiteral("/trace.json");
+        QVERIFY(menu.saveProfile(traceFileName));
+
+        QFile file(traceFileName);
+        QVERIFY(file.open(QFile::ReadOnly));
+        QJsonParseError error;
+        const QJsonDocument trace = QJsonDocument::fromJson(file.readAll(), &error);
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QVERIFY(trace.isObject());
+        QCOMPARE(trace[QStringLiteral("displayTimeUnit")].toString(), QStringLiteral("ms"));
+
+        const QJsonArray events = trace[QStringLiteral("traceEvents")].toArray();
+        QCOMPARE(events.count(), profile.count());
+        for (int i = 0; i < events.count(); ++i) {
+            const QJsonObject event = events.at(i).toObject();
+            const Liri::DesktopMenuProfileEntry &entry = profile.at(i);
+
+            QCOMPARE(event.value(QStringLiteral("name")).toString(), entry.name);
+            QCOMPARE(event.value(QStringLiteral("cat")).toString(), entry.category);
+            QCOMPARE(event.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+            QCOMPARE(event.value(QStringLiteral("ts")).toInteger(), entry.start);
+            QCOMPARE(event.value(QStringLiteral("dur")).toInteger(), entry.duration);
+            QCOMPARE(event.value(QStringLiteral("pid")).toInteger(), QCoreApplication::applicationPid());
+            QVERIFY(event.contains(QStringLiteral("tid")));
+
+            const QJsonObject args = event.value(QStringLiteral("args")).toObject();
+            QCOMPARE(args.value(QStringLiteral("nodes")).toInt(), entry.nodes);
+            QCOMPARE(args.contains(QStringLiteral("allocatedBytes")), entry.allocatedBytes >= 0);
+            if (entry.allocatedBytes >= 0)
+                QCOMPARE(args.value(QStringLiteral("allocatedBytes")).toInteger(), entry.allocatedBytes);
+        }
+
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Cannot write file")));
+        QVERIFY(!menu.saveProfile(dir + QStringLiteral("/missing/trace.json")));
+    }
+
+    void testLayoutEqualTitles()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("titles/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/s1.desktop"), desktopEntry(QStringLiteral("Same"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/s2.desktop"), desktopEntry(QStringLiteral("Same"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/s3.desktop"), desktopEntry(QStringLiteral("Same"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/z.desktop"), desktopEntry(QStringLiteral("Alpha"))));
+
+        const QString menuFileName = mDir.filePath(QStringLiteral("titles/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir><Include><All/></Include>").arg(apps))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        QVERIFY(menu.read(menuFileName));
+
+        // None is dropped by the merge, equal titles keep their order
+        QStringList ids;
+        const QDomElement root = menu.xml().documentElement();
+        for (QDomElement e = root.firstChildElement(QStringLiteral("AppLink")); !e.isNull();
+             e = e.nextSiblingElement(QStringLiteral("AppLink")))
+            ids.append(e.attribute(QStringLiteral("id")));
+        QCOMPARE(ids.count(), 4);
+        QCOMPARE(ids.first(), QStringLiteral("z.desktop"));
+        QStringList same = ids.mid(1);
+        same.sort();
+        QCOMPARE(same, QStringList({ QStringLiteral("s1.desktop"), QStringLiteral("s2.desktop"), QStringLiteral("s3.desktop") }));
+    }
+
+    void testLayoutOwnChildren()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("layout/apps"));
+        for (const QString &name : { QStringLiteral("a"), QStringLiteral("b"), QStringLiteral("p"), QStringLiteral("q") })
+            QVERIFY(writeFile(QStringLiteral("%1/%2.desktop").arg(apps, name), desktopEntry(name.toUpper())));
+
+        // The layout of Sub must not be taken for the one of the root menu,
+        // nor the one of Other, which only has the default layout
+        const QString menuFileName = mDir.filePath(QStringLiteral("layout/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<DefaultLayout><Merge type=\"files\"/><Merge type=\"menus\"/></DefaultLayout>"
+                "<Include><Filename>q.desktop</Filename><Filename>p.desktop</Filename></Include>"
+                "<Menu><Name>Sub</Name>"
+                "<Layout><Filename>b.desktop</Filename><Separator/><Filename>a.desktop</Filename></Layout>"
+                "<Include><Filename>a.desktop</Filename><Filename>b.desktop</Filename></Include>"
+                "</Menu>"
+                "<Menu><Name>Other</Name>"
+                "<Include><Filename>b.desktop</Filename></Include>"
+                "<Menu><Name>Inner</Name><Include><Filename>a.desktop</Filename></Include></Menu>"
+                "</Menu>").arg(apps))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        QVERIFY(menu.read(menuFileName));
+        QCOMPARE(dump(menu.xml().documentElement()),
+                 QStringLiteral("Applications[p.desktop,q.desktop,Other[b.desktop,Inner[a.desktop]],Sub[b.desktop,-,a.desktop]]"));
+    }
+
+    void testPreviewEnvironments()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("preview/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/all.desktop"), desktopEntry(QStringLiteral("All"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/kde.desktop"),
+                          desktopEntry(QStringLiteral("Kde"), QStringLiteral("OnlyShowIn=KDE;\n"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/gnome.desktop"),
+                          desktopEntry(QStringLiteral("Gnome"), QStringLiteral("OnlyShowIn=GNOME;\n"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/notgnome.desktop"),
+                          desktopEntry(QStringLiteral("NotGnome"), QStringLiteral("NotShowIn=GNOME;\n"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/xfce.desktop"),
+                          desktopEntry(QStringLiteral("Xfce"), QStringLiteral("OnlyShowIn=XFCE;\n"))));
+
+        const QString menuFileName = mDir.filePath(QStringLiteral("preview/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Include><Filename>all.desktop</Filename><Filename>notgnome.desktop</Filename>"
+                "<Filename>xfce.desktop</Filename></Include>"
+                "<Menu><Name>Kde</Name><Include><Filename>kde.desktop</Filename></Include></Menu>"
+                "<Menu><Name>Gnome</Name><Include><Filename>gnome.desktop</Filename></Include></Menu>").arg(apps))));
+
+        const QStringList environments = {
+            QStringLiteral("KDE"), QStringLiteral("GNOME"), QStringLiteral("Liri"),
+        };
+
+        Liri::DesktopMenu preview;
+        preview.setPreviewEnvironments(environments);
+        QCOMPARE(preview.previewEnvironments(), environments);
+        QVERIFY(preview.read(menuFileName));
+
+        // Masks of the entries, and of the menus as the union of their entries
+        QHash<QString, QString> masks;
+        const QDomElement root = preview.xml().documentElement();
+        masks.insert(QStringLiteral("Applications"), root.attribute(QStringLiteral("visibleIn")));
+        collectMasks(root, &masks);
+        QHash<QString, QString> expectedMasks;
+        expectedMasks.insert(QStringLiteral("Applications"), QStringLiteral("7"));
+        expectedMasks.insert(QStringLiteral("all.desktop"), QStringLiteral("7"));
+        expectedMasks.insert(QStringLiteral("notgnome.desktop"), QStringLiteral("5"));
+        expectedMasks.insert(QStringLiteral("Kde"), QStringLiteral("1"));
+        expectedMasks.insert(QStringLiteral("kde.desktop"), QStringLiteral("1"));
+        expectedMasks.insert(QStringLiteral("Gnome"), QStringLiteral("2"));
+        expectedMasks.insert(QStringLiteral("gnome.desktop"), QStringLiteral("2"));
+        QCOMPARE(masks, expectedMasks);
+
+        // Filtered by environment, the menu is the one built for it alone
+        Liri::DesktopMenu lazy;
+        lazy.setPreviewEnvironments(environments);
+        lazy.setLazy(true);
+        QVERIFY(lazy.read(menuFileName));
+
+        for (int i = 0; i < environments.size(); ++i) {
+            Liri::DesktopMenu single;
+            single.setEnvironments(environments.at(i));
+            QVERIFY(single.read(menuFileName));
+
+            QCOMPARE(dumpVisible(preview, i), dump(single));
+            QCOMPARE(dumpVisible(lazy, i), dump(single));
+        }
+
+        // Only elements with a mask are hidden
+        QDomDocument doc;
+        QDomElement separator = doc.createElement(QStringLiteral("Separator"));
+        QVERIFY(Liri::DesktopMenu::isVisibleIn(separator, 0));
+        QVERIFY(Liri::DesktopMenu::isVisibleIn(separator, 64));
+
+        QDomElement appLink = doc.createElement(QStringLiteral("AppLink"));
+        appLink.setAttribute(QStringLiteral("visibleIn"), QString::number(quint64(1) << 63 | 1));
+        QVERIFY(Liri::DesktopMenu::isVisibleIn(appLink, 0));
+        QVERIFY(!Liri::DesktopMenu::isVisibleIn(appLink, 1));
+        QVERIFY(Liri::DesktopMenu::isVisibleIn(appLink, 63));
+        QVERIFY(!Liri::DesktopMenu::isVisibleIn(appLink, 64));
+        QVERIFY(!Liri::DesktopMenu::isVisibleIn(appLink, -1));
+    }
+
+    void testModel()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("model/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/g1.desktop"), desktopEntry(QStringLiteral("G1"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/r1.desktop"), desktopEntry(QStringLiteral("R1"))));
+
+        const QString gamesXml = QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Include><Filename>r1.desktop</Filename></Include>"
+                "<Menu><Name>Games</Name><Include><Filename>g1.desktop</Filename></Include></Menu>").arg(apps);
+        const QString flatXml = QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Include><Filename>g1.desktop</Filename><Filename>r1.desktop</Filename></Include>").arg(apps);
+
+        const QString menuFileName = mDir.filePath(QStringLiteral("model/applications.menu"));
+        const QString flatFileName = mDir.filePath(QStringLiteral("model/flat.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(gamesXml)));
+        QVERIFY(writeFile(flatFileName, menuXml(flatXml)));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        menu.setRebuildDelay(0);
+
+        Liri::DesktopMenuModel model;
+        QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+        model.setMenu(&menu);
+
+        QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+        QSignalSpy finished(&menu, &Liri::DesktopMenu::readFinished);
+
+        // read() resets the model
+        QVERIFY(menu.read(flatFileName));
+        QCOMPARE(finished.count(), 1);
+        QCOMPARE(finished.at(0).at(0).toBool(), true);
+        QCOMPARE(reset.count(), 1);
+        QCOMPARE(model.rowCount(), 2);
+
+        // So does readAsync()
+        menu.readAsync(menuFileName);
+        QVERIFY(menu.isReading());
+        QVERIFY(finished.wait());
+        QCOMPARE(reset.count(), 2);
+        QCOMPARE(model.rowCount(), 2);
+        const QModelIndex games = model.index(0, 0);
+        QCOMPARE(games.data(Liri::DesktopMenuModel::NameRole).toString(), QStringLiteral("Games"));
+        QCOMPARE(model.rowCount(games), 1);
+        QPersistentModelIndex persistentGames(games);
+
+        // A rebuild is applied row by row
+        QSignalSpy changed(&menu, &Liri::DesktopMenu::changed);
+        QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+        QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Menu><Name>Games</Name><Include>"
+                "<Filename>g1.desktop</Filename><Filename>r1.desktop</Filename>"
+                "</Include></Menu>").arg(apps))));
+        QVERIFY(changed.wait());
+        QCOMPARE(reset.count(), 2);
+        QCOMPARE(finished.count(), 2);
+        QCOMPARE(removed.count(), 1);
+        QCOMPARE(inserted.count(), 1);
+        QVERIFY(persistentGames.isValid());
+        QCOMPARE(model.rowCount(), 1);
+        QCOMPARE(model.rowCount(persistentGames), 2);
+        QCOMPARE(model.index(1, 0, persistentGames).data(Liri::DesktopMenuModel::TitleRole).toString(),
+                 QStringLiteral("R1"));
+
+        // A failed read() still finishes
+        QVERIFY(!menu.read(mDir.filePath(QStringLiteral("model/missing.menu"))));
+        QCOMPARE(finished.count(), 3);
+        QCOMPARE(finished.at(2).at(0).toBool(), false);
+    }
+
+    void testModelLazyHidden()
+    {
+        const QString apps = mDir.filePath(QStringLiteral("modelhidden/apps"));
+        QVERIFY(writeFile(apps + QStringLiteral("/g1.desktop"), desktopEntry(QStringLiteral("G1"), QStringLiteral("NoDisplay=true\n"))));
+        QVERIFY(writeFile(apps + QStringLiteral("/r1.desktop"), desktopEntry(QStringLiteral("R1"))));
+
+        const QString menuFileName = mDir.filePath(QStringLiteral("modelhidden/applications.menu"));
+        QVERIFY(writeFile(menuFileName, menuXml(QStringLiteral(
+                "<AppDir>%1</AppDir>"
+                "<Include><Filename>r1.desktop</Filename></Include>"
+                "<Menu><Name>Games</Name><Include><Filename>g1.desktop</Filename></Include></Menu>").arg(apps))));
+
+        Liri::DesktopMenu menu;
+        menu.setEnvironments(QStringLiteral("X-Test"));
+        menu.setLazy(true);
+
+        // No QAbstractItemModelTester, it would fetch every menu itself
+        Liri::DesktopMenuModel model;
+        model.setMenu(&menu);
+        QVERIFY(menu.read(menuFileName));
+
+        // Games is kept until it's built, its only entry is hidden
+        QCOMPARE(model.rowCount(), 2);
+        const QModelIndex games = model.index(0, 0);
+        QCOMPARE(games.data(Liri::DesktopMenuModel::NameRole).toString(), QStringLiteral("Games"));
+        QVERIFY(model.canFetchMore(games));
+
+        QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+        model.fetchMore(games);
+        QCOMPARE(removed.count(), 1);
+        QCOMPARE(removed.at(0).at(0).toModelIndex(), QModelIndex());
+        QCOMPARE(removed.at(0).at(1).toInt(), 0);
+        QCOMPARE(model.rowCount(), 1);
+        QCOMPARE(model.index(0, 0).data(Liri::DesktopMenuModel::TitleRole).toString(), QStringLiteral("R1"));
+    }
+
+private:
+    QTemporaryDir mDir;
+};
+
+QTEST_MAIN(TestDesktopMenu)
+
+#include "tst_desktopmenu.moc"
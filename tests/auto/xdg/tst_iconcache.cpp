@@ -0,0 +1,185 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/IconCache>
+
+static bool writeFile(const QString &fileName, const QByteArray &contents = QByteArray())
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+    return file.write(contents) >= 0;
+}
+
+class TestIconCache : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        // Read once, when the cache is first used
+        qputenv("HOME", mDir.filePath(QStringLiteral("user")).toLocal8Bit());
+        qputenv("XDG_DATA_HOME", mDir.filePath(QStringLiteral("home")).toLocal8Bit());
+        qputenv("XDG_DATA_DIRS", mDir.filePath(QStringLiteral("data")).toLocal8Bit());
+        qputenv("XDG_CACHE_HOME", mDir.filePath(QStringLiteral("cache")).toLocal8Bit());
+
+        const QString home = mDir.filePath(QStringLiteral("home/icons"));
+        const QString data = mDir.filePath(QStringLiteral("data/icons"));
+
+        QVERIFY(writeFile(home + QStringLiteral("/Test/index.theme"),
+                          "[Icon Theme]\n"
+                          "Name=Test\n"
+                          "Inherits=Parent\n"
+                          "Directories=16x16/apps,32x32/apps,48x48/apps,scalable/apps\n"
+                          "ScaledDirectories=16x16@2/apps\n"
+                          "\n"
+                          "[16x16/apps]\n"
+                          "Size=16\n"
+                          "Type=Fixed\n"
+                          "\n"
+                          "[16x16@2/apps]\n"
+                          "Size=16\n"
+                          "Scale=2\n"
+                          "Type=Fixed\n"
+                          "\n"
+                          "[32x32/apps]\n"
+                          "Size=32\n"
+                          "Type=Threshold\n"
+                          "Threshold=2\n"
+                          "\n"
+                          "[48x48/apps]\n"
+                          "Size=48\n"
+                          "Type=Fixed\n"
+                          "\n"
+                          "[scalable/apps]\n"
+                          "Size=64\n"
+                          "MinSize=64\n"
+                          "MaxSize=256\n"
+                          "Type=Scalable\n"));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/16x16/apps/fixed.png")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/48x48/apps/fixed.png")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/32x32/apps/threshold.png")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/48x48/apps/threshold.png")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/32x32/apps/both.png")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/32x32/apps/both.svg")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/scalable/apps/both.svg")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/16x16/apps/scaled.png")));
+        QVERIFY(writeFile(home + QStringLiteral("/Test/16x16@2/apps/scaled.png")));
+
+        // Same theme, another base directory
+        QVERIFY(writeFile(data + QStringLiteral("/Test/16x16/apps/overlay.png")));
+
+        QVERIFY(writeFile(data + QStringLiteral("/Parent/index.theme"),
+                          "[Icon Theme]\n"
+                          "Name=Parent\n"
+                          "Directories=16x16/apps\n"
+                          "\n"
+                          "[16x16/apps]\n"
+                          "Size=16\n"
+                          "Type=Fixed\n"));
+        QVERIFY(writeFile(data + QStringLiteral("/Parent/16x16/apps/inherited.png")));
+        QVERIFY(writeFile(data + QStringLiteral("/Parent/16x16/apps/fixed.png")));
+
+        QVERIFY(writeFile(data + QStringLiteral("/hicolor/index.theme"),
+                          "[Icon Theme]\n"
+                          "Name=Hicolor\n"
+                          "Directories=48x48/apps\n"
+                          "\n"
+                          "[48x48/apps]\n"
+                          "Size=48\n"
+                          "Type=Threshold\n"));
+        QVERIFY(writeFile(data + QStringLiteral("/hicolor/48x48/apps/fallback.png")));
+
+        // Right in a base directory, like /usr/share/pixmaps
+        QVERIFY(writeFile(home + QStringLiteral("/unthemed.xpm")));
+    }
+
+    void testLookup_data()
+    {
+        QTest::addColumn<QString>("iconName");
+        QTest::addColumn<int>("size");
+        QTest::addColumn<int>("scale");
+        QTest::addColumn<QString>("expected");
+
+        const QString test = QStringLiteral("home/icons/Test/");
+
+        QTest::newRow("fixed") << QStringLiteral("fixed") << 48 << 1 << test + QStringLiteral("48x48/apps/fixed.png");
+        QTest::newRow("fixed-closest") << QStringLiteral("fixed") << 20 << 1 << test + QStringLiteral("16x16/apps/fixed.png");
+        QTest::newRow("fixed-closest-larger") << QStringLiteral("fixed") << 40 << 1 << test + QStringLiteral("48x48/apps/fixed.png");
+        QTest::newRow("threshold") << QStringLiteral("threshold") << 34 << 1 << test + QStringLiteral("32x32/apps/threshold.png");
+        QTest::newRow("threshold-below") << QStringLiteral("threshold") << 30 << 1 << test + QStringLiteral("32x32/apps/threshold.png");
+        QTest::newRow("threshold-closest") << QStringLiteral("threshold") << 41 << 1 << test + QStringLiteral("48x48/apps/threshold.png");
+        QTest::newRow("extension") << QStringLiteral("both") << 32 << 1 << test + QStringLiteral("32x32/apps/both.png");
+        QTest::newRow("scalable") << QStringLiteral("both") << 100 << 1 << test + QStringLiteral("scalable/apps/both.svg");
+        QTest::newRow("scalable-closest") << QStringLiteral("both") << 300 << 1 << test + QStringLiteral("scalable/apps/both.svg");
+        QTest::newRow("file-name") << QStringLiteral("both.svg") << 32 << 1 << test + QStringLiteral("32x32/apps/both.png");
+        QTest::newRow("scale-1") << QStringLiteral("scaled") << 16 << 1 << test + QStringLiteral("16x16/apps/scaled.png");
+        QTest::newRow("scale-2") << QStringLiteral("scaled") << 16 << 2 << test + QStringLiteral("16x16@2/apps/scaled.png");
+        QTest::newRow("base-dirs") << QStringLiteral("overlay") << 16 << 1 << QStringLiteral("data/icons/Test/16x16/apps/overlay.png");
+        QTest::newRow("inherits") << QStringLiteral("inherited") << 16 << 1 << QStringLiteral("data/icons/Parent/16x16/apps/inherited.png");
+        QTest::newRow("theme-before-inherits") << QStringLiteral("fixed") << 16 << 1 << test + QStringLiteral("16x16/apps/fixed.png");
+        QTest::newRow("hicolor") << QStringLiteral("fallback") << 16 << 1 << QStringLiteral("data/icons/hicolor/48x48/apps/fallback.png");
+        QTest::newRow("unthemed") << QStringLiteral("unthemed") << 16 << 1 << QStringLiteral("home/icons/unthemed.xpm");
+        QTest::newRow("missing") << QStringLiteral("missing") << 16 << 1 << QString();
+    }
+
+    void testLookup()
+    {
+        QFETCH(QString, iconName);
+        QFETCH(int, size);
+        QFETCH(int, scale);
+        QFETCH(QString, expected);
+
+        if (!expected.isEmpty())
+            expected = mDir.filePath(expected);
+
+        QCOMPARE(Liri::IconCache::lookup(iconName, size, scale, QStringLiteral("Test")), expected);
+    }
+
+    void testAbsolutePath()
+    {
+        const QString fileName = mDir.filePath(QStringLiteral("home/icons/unthemed.xpm"));
+        QCOMPARE(Liri::IconCache::lookup(fileName, 16), fileName);
+        QCOMPARE(Liri::IconCache::lookup(mDir.filePath(QStringLiteral("missing.png")), 16), QString());
+    }
+
+    void testThemeInstalled()
+    {
+        Liri::IconCache::clear();
+
+        // Not installed yet, found in hicolor
+        const QString fallback = mDir.filePath(QStringLiteral("data/icons/hicolor/48x48/apps/fallback.png"));
+        QCOMPARE(Liri::IconCache::lookup(QStringLiteral("fallback"), 48, 1, QStringLiteral("Late")), fallback);
+
+        // Installed in a base directory other than the first one
+        const QString late = mDir.filePath(QStringLiteral("data/icons/Late"));
+        QVERIFY(writeFile(late + QStringLiteral("/index.theme"),
+                          "[Icon Theme]\n"
+                          "Name=Late\n"
+                          "Directories=48x48/apps\n"
+                          "\n"
+                          "[48x48/apps]\n"
+                          "Size=48\n"
+                          "Type=Fixed\n"));
+        QVERIFY(writeFile(late + QStringLiteral("/48x48/apps/fallback.png")));
+
+        // Directories are checked every few seconds
+        QTRY_COMPARE_WITH_TIMEOUT(Liri::IconCache::lookup(QStringLiteral("fallback"), 48, 1, QStringLiteral("Late")),
+                                  late + QStringLiteral("/48x48/apps/fallback.png"), 15000);
+    }
+
+private:
+    QTemporaryDir mDir;
+};
+
+QTEST_MAIN(TestIconCache)
+
+#include "tst_iconcache.moc"
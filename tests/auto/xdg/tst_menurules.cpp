@@ -0,0 +1,177 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include "xdgmenurules_p_p.h"
+
+using namespace Liri;
+
+/*
+ * The pool every rule is evaluated against, by desktop file id.
+ */
+static const QList<QPair<QString, QStringList>> pool = {
+    { QStringLiteral("a.desktop"), { QStringLiteral("Game"), QStringLiteral("Puzzle") } },
+    { QStringLiteral("b.desktop"), { QStringLiteral("Game") } },
+    { QStringLiteral("c.desktop"), { QStringLiteral("Utility") } },
+    { QStringLiteral("d.desktop"), {} },
+    { QStringLiteral("kde-e.desktop"), { QStringLiteral("Utility"), QStringLiteral("Game") } },
+};
+
+static QDomElement parseRule(QDomDocument &doc, const QString &tagName, const QString &body)
+{
+    doc.setContent(QStringLiteral("<%1>%2</%1>").arg(tagName, body));
+    return doc.documentElement();
+}
+
+static QStringList members(const QBitArray &bits)
+{
+    QStringList result;
+    for (int i = 0; i < bits.size(); ++i) {
+        if (bits.testBit(i))
+            result.append(pool.at(i).first);
+    }
+    return result;
+}
+
+class TestMenuRules : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testInclude_data()
+    {
+        QTest::addColumn<QString>("rule");
+        QTest::addColumn<QStringList>("expected");
+
+        const QString a = QStringLiteral("a.desktop");
+        const QString b = QStringLiteral("b.desktop");
+        const QString c = QStringLiteral("c.desktop");
+        const QString d = QStringLiteral("d.desktop");
+        const QString e = QStringLiteral("kde-e.desktop");
+
+        // Same membership as the rule classes the programs replaced
+        QTest::newRow("empty") << QString() << QStringList();
+        QTest::newRow("all") << QStringLiteral("<All/>") << QStringList({ a, b, c, d, e });
+        QTest::newRow("filename") << QStringLiteral("<Filename>a.desktop</Filename>") << QStringList({ a });
+        QTest::newRow("filename-prefixed") << QStringLiteral("<Filename>kde-e.desktop</Filename>") << QStringList({ e });
+        QTest::newRow("filename-missing") << QStringLiteral("<Filename>z.desktop</Filename>") << QStringList();
+        QTest::newRow("category") << QStringLiteral("<Category>Game</Category>") << QStringList({ a, b, e });
+        QTest::newRow("category-case") << QStringLiteral("<Category>game</Category>") << QStringList();
+        QTest::newRow("category-missing") << QStringLiteral("<Category>Office</Category>") << QStringList();
+        QTest::newRow("implicit-or")
+                << QStringLiteral("<Filename>a.desktop</Filename><Category>Utility</Category>")
+                << QStringList({ a, c, e });
+        QTest::newRow("or")
+                << QStringLiteral("<Or><Category>Puzzle</Category><Filename>d.desktop</Filename></Or>")
+                << QStringList({ a, d });
+        QTest::newRow("or-empty") << QStringLiteral("<Or/>") << QStringList();
+        QTest::newRow("and")
+                << QStringLiteral("<And><Category>Game</Category><Category>Utility</Category></And>")
+                << QStringList({ e });
+        QTest::newRow("and-empty") << QStringLiteral("<And/>") << QStringList();
+        QTest::newRow("and-single") << QStringLiteral("<And><Category>Utility</Category></And>") << QStringList({ c, e });
+        QTest::newRow("not") << QStringLiteral("<Not><Category>Game</Category></Not>") << QStringList({ c, d });
+        QTest::newRow("not-or")
+                << QStringLiteral("<Not><Category>Game</Category><Filename>c.desktop</Filename></Not>")
+                << QStringList({ d });
+        QTest::newRow("not-empty") << QStringLiteral("<Not/>") << QStringList({ a, b, c, d, e });
+        QTest::newRow("not-all") << QStringLiteral("<Not><All/></Not>") << QStringList();
+        QTest::newRow("and-not")
+                << QStringLiteral("<And><Category>Game</Category><Not><Category>Puzzle</Category></Not></And>")
+                << QStringList({ b, e });
+        QTest::newRow("and-not-empty")
+                << QStringLiteral("<And><Category>Game</Category><Not/></And>")
+                << QStringList({ a, b, e });
+        QTest::newRow("and-empty-and")
+                << QStringLiteral("<And><All/><And/></And>")
+                << QStringList();
+        QTest::newRow("or-of-empties") << QStringLiteral("<Or><And/><Not/></Or>") << QStringList({ a, b, c, d, e });
+        QTest::newRow("nested")
+                << QStringLiteral("<Or>"
+                                  "<And><Category>Utility</Category><Not><Filename>c.desktop</Filename></Not></And>"
+                                  "<And><Not><Category>Game</Category></Not><Not><Category>Utility</Category></Not></And>"
+                                  "</Or>")
+                << QStringList({ d, e });
+    }
+
+    void testInclude()
+    {
+        QFETCH(QString, rule);
+        QFETCH(QStringList, expected);
+
+        // Categories of the pool get atoms first, like the menu does,
+        // so that categories only named by rules are out of the rows
+        XdgMenuCategoryAtoms atoms;
+        XdgMenuRuleAppSet apps;
+        for (const auto &entry : pool)
+            apps.append(entry.first, atoms.categories(entry.second));
+
+        QDomDocument doc;
+        XdgMenuRules rules(&atoms);
+        rules.addInclude(parseRule(doc, QStringLiteral("Include"), rule));
+
+        QCOMPARE(members(rules.checkInclude(apps)), expected);
+        QCOMPARE(members(rules.checkExclude(apps)), QStringList());
+
+        // The same rule excludes the same entries
+        QDomDocument excludeDoc;
+        XdgMenuRules excludeRules(&atoms);
+        excludeRules.addExclude(parseRule(excludeDoc, QStringLiteral("Exclude"), rule));
+        QCOMPARE(members(excludeRules.checkExclude(apps)), expected);
+    }
+
+    void testSeveralRules()
+    {
+        XdgMenuCategoryAtoms atoms;
+        XdgMenuRuleAppSet apps;
+        for (const auto &entry : pool)
+            apps.append(entry.first, atoms.categories(entry.second));
+
+        QDomDocument doc1;
+        QDomDocument doc2;
+        QDomDocument doc3;
+        XdgMenuRules rules(&atoms);
+        rules.addInclude(parseRule(doc1, QStringLiteral("Include"), QStringLiteral("<Category>Puzzle</Category>")));
+        rules.addInclude(parseRule(doc2, QStringLiteral("Include"), QStringLiteral("<Category>Utility</Category>")));
+        rules.addExclude(parseRule(doc3, QStringLiteral("Exclude"), QStringLiteral("<Filename>c.desktop</Filename>")));
+
+        // Included by any <Include>, excluded by any <Exclude>
+        QCOMPARE(members(rules.checkInclude(apps)),
+                 QStringList({ QStringLiteral("a.desktop"), QStringLiteral("c.desktop"), QStringLiteral("kde-e.desktop") }));
+        QCOMPARE(members(rules.checkExclude(apps)), QStringList(QStringLiteral("c.desktop")));
+    }
+
+    void testProgram()
+    {
+        XdgMenuCategoryAtoms atoms;
+
+        // Unknown rules are skipped and leave nothing on the stack
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Unknown rule.*Foo")));
+        QDomDocument doc;
+        const XdgMenuRuleProgram program(parseRule(doc, QStringLiteral("Include"), QStringLiteral(
+                "<And><Foo/><Category>Game</Category>"
+                "<Not><And><Category>Puzzle</Category><Category>Game</Category></And></Not></And>")), &atoms);
+
+        // Compiled before the pool exists, the categories it names get
+        // their atoms first
+        XdgMenuRuleAppSet apps;
+        for (const auto &entry : pool)
+            apps.append(entry.first, atoms.categories(entry.second));
+        QCOMPARE(members(program.evaluate(apps)),
+                 QStringList({ QStringLiteral("b.desktop"), QStringLiteral("kde-e.desktop") }));
+
+        // A pool of another size
+        XdgMenuRuleAppSet other;
+        other.append(QStringLiteral("b.desktop"), atoms.categories({ QStringLiteral("Game") }));
+        QCOMPARE(program.evaluate(other), QBitArray(1, true));
+
+        XdgMenuRuleAppSet empty;
+        QCOMPARE(program.evaluate(empty).size(), 0);
+    }
+};
+
+QTEST_MAIN(TestMenuRules)
+
+#include "tst_menurules.moc"
@@ -0,0 +1,252 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/AutoStart>
+#include <LiriXdg/DesktopFile>
+#include <LiriXdg/DesktopMenu>
+
+static const int appCount = 5000;
+static const int autostartCount = 200;
+
+static const char *const categories[] = {
+    "AudioVideo", "Development", "Education", "Game", "Graphics",
+    "Network", "Office", "Science", "Settings", "System", "Utility",
+};
+static const int categoryCount = sizeof(categories) / sizeof(categories[0]);
+
+static const char *const locales[] = {
+    "de", "es", "fr", "it", "ja", "nl", "pl", "pt", "pt_BR", "ru", "sv", "zh_CN",
+};
+
+/*
+ * Writes an application entry the size of a typical distribution one,
+ * with translations and actions.
+ */
+static bool writeApp(const QString &fileName, int i)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    QTextStream ts(&file);
+    ts << "[Desktop Entry]\n"
+          "Type=Application\n"
+          "Version=1.0\n"
+          "Name=Application " << i << "\n";
+    for (const char *locale : locales)
+        ts << "Name[" << locale << "]=Application " << i << " (" << locale << ")\n";
+    ts << "GenericName=Generic application\n";
+    for (const char *locale : locales)
+        ts << "GenericName[" << locale << "]=Generic application (" << locale << ")\n";
+    ts << "Comment=Does things with files number " << i << "\n"
+          "Keywords=app;bench;number" << i << ";\n"
+          "Icon=app" << i << "\n"
+          "Exec=app" << i << " --name \"Application " << i << "\" %U\n"
+          "Terminal=false\n"
+          "StartupNotify=true\n"
+          "MimeType=text/x-bench" << i % 100 << ";text/x-bench-fallback;\n"
+          "Categories=" << categories[i % categoryCount] << ";" << categories[(i * 7) % categoryCount] << ";\n"
+          "InitialPreference=" << i % 10 << "\n"
+          "Actions=new-window;\n"
+          "\n"
+          "[Desktop Action new-window]\n"
+          "Name=New Window\n"
+          "Exec=app" << i << " --new-window\n";
+
+    return true;
+}
+
+class TestBenchDesktopFile : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        const QString applications = mDir.filePath(QStringLiteral("data/applications"));
+        QVERIFY(QDir().mkpath(applications));
+        for (int i = 0; i < appCount; ++i)
+            QVERIFY(writeApp(QStringLiteral("%1/app%2.desktop").arg(applications).arg(i), i));
+        mFileName = applications + QStringLiteral("/app42.desktop");
+
+        // Half of the entries of each autostart directory are overridden
+        const QString autostartHome = mDir.filePath(QStringLiteral("config/autostart"));
+        const QString autostartDir = mDir.filePath(QStringLiteral("xdg/autostart"));
+        QVERIFY(QDir().mkpath(autostartHome));
+        QVERIFY(QDir().mkpath(autostartDir));
+        for (int i = 0; i < autostartCount; ++i) {
+            QVERIFY(writeApp(QStringLiteral("%1/autostart%2.desktop").arg(autostartDir).arg(i), i));
+            if (i % 2 == 0)
+                QVERIFY(writeApp(QStringLiteral("%1/autostart%2.desktop").arg(autostartHome).arg(i), i));
+        }
+
+        QFile mimeApps(mDir.filePath(QStringLiteral("config/mimeapps.list")));
+        QVERIFY(mimeApps.open(QFile::WriteOnly | QFile::Text));
+        mimeApps.write("[Default Applications]\n"
+                       "text/x-bench42=app42.desktop;\n");
+        mimeApps.close();
+
+        mMenuFileName = mDir.filePath(QStringLiteral("applications.menu"));
+        QFile menu(mMenuFileName);
+        QVERIFY(menu.open(QFile::WriteOnly | QFile::Text));
+        QTextStream ts(&menu);
+        ts << "<!DOCTYPE Menu PUBLIC \"-//freedesktop//DTD Menu 1.0//EN\"\n"
+              " \"http://www.freedesktop.org/standards/menu-spec/menu-1.0.dtd\">\n"
+              "<Menu><Name>Applications</Name><DefaultAppDirs/>\n";
+        for (const char *category : categories) {
+            ts << "<Menu><Name>" << category << "</Name>"
+               << "<Include><And><Category>" << category << "</Category>"
+               << "<Not><Category>Settings</Category></Not></And></Include></Menu>\n";
+        }
+        ts << "<Menu><Name>Other</Name><OnlyUnallocated/><Include><All/></Include></Menu>\n"
+              "</Menu>\n";
+        ts.flush();
+        menu.close();
+
+        // Must happen before the cache is created
+        qputenv("XDG_DATA_HOME", mDir.filePath(QStringLiteral("home")).toLocal8Bit());
+        qputenv("XDG_DATA_DIRS", mDir.filePath(QStringLiteral("data")).toLocal8Bit());
+        qputenv("XDG_CONFIG_HOME", mDir.filePath(QStringLiteral("config")).toLocal8Bit());
+        qputenv("XDG_CONFIG_DIRS", mDir.filePath(QStringLiteral("xdg")).toLocal8Bit());
+        qputenv("XDG_CACHE_HOME", mDir.filePath(QStringLiteral("cache")).toLocal8Bit());
+        qputenv("LC_MESSAGES", "pt_BR");
+    }
+
+    void load()
+    {
+        Liri::DesktopFile file;
+        QBENCHMARK {
+            QVERIFY(file.load(mFileName));
+        }
+    }
+
+    void value_data()
+    {
+        QTest::addColumn<QString>("key");
+
+        QTest::newRow("Exec") << QStringLiteral("Exec");
+        QTest::newRow("Categories") << QStringLiteral("Categories");
+        QTest::newRow("missing") << QStringLiteral("X-Missing");
+    }
+
+    void value()
+    {
+        QFETCH(QString, key);
+
+        Liri::DesktopFile file;
+        QVERIFY(file.load(mFileName));
+
+        QBENCHMARK {
+            file.value(key);
+        }
+    }
+
+    void localizedValue_data()
+    {
+        QTest::addColumn<QString>("key");
+
+        QTest::newRow("Name") << QStringLiteral("Name");
+        QTest::newRow("Comment") << QStringLiteral("Comment");
+    }
+
+    void localizedValue()
+    {
+        QFETCH(QString, key);
+
+        Liri::DesktopFile file;
+        QVERIFY(file.load(mFileName));
+
+        QBENCHMARK {
+            file.localizedValue(key);
+        }
+    }
+
+    void expandExecString_data()
+    {
+        QTest::addColumn<QStringList>("urls");
+
+        QTest::newRow("no-urls") << QStringList();
+        QTest::newRow("10-urls") << QStringList(10, QStringLiteral("file:///tmp/some%20file.txt"));
+    }
+
+    void expandExecString()
+    {
+        QFETCH(QStringList, urls);
+
+        Liri::DesktopFile file;
+        QVERIFY(file.load(mFileName));
+
+        QBENCHMARK {
+            file.expandExecString(urls);
+        }
+    }
+
+    // Parses every file and writes the store
+    void cacheBuildStoreMiss()
+    {
+        const QString storeDir = mDir.filePath(QStringLiteral("cache/liri"));
+        QBENCHMARK {
+            QDir(storeDir).removeRecursively();
+            Liri::DesktopFileCache cache;
+        }
+    }
+
+    // Reads the store written by another cache
+    void cacheBuildStoreHit()
+    {
+        {
+            Liri::DesktopFileCache cache;
+        }
+        QBENCHMARK {
+            Liri::DesktopFileCache cache;
+        }
+    }
+
+    void getDefaultApp_data()
+    {
+        QTest::addColumn<QString>("mimeType");
+
+        QTest::newRow("mimeapps") << QStringLiteral("text/x-bench42");
+        QTest::newRow("fallback") << QStringLiteral("text/x-bench-fallback");
+    }
+
+    void getDefaultApp()
+    {
+        QFETCH(QString, mimeType);
+
+        QVERIFY(Liri::DesktopFileCache::getDefaultApp(mimeType));
+        QBENCHMARK {
+            Liri::DesktopFileCache::getDefaultApp(mimeType);
+        }
+    }
+
+    void readMenu()
+    {
+        Liri::DesktopMenu menu;
+        QBENCHMARK {
+            QVERIFY(menu.read(mMenuFileName));
+        }
+    }
+
+    void autostartDesktopFileList()
+    {
+        QCOMPARE(Liri::AutoStart::desktopFileList().size(), autostartCount);
+        QBENCHMARK {
+            Liri::AutoStart::desktopFileList();
+        }
+    }
+
+private:
+    QTemporaryDir mDir;
+    QString mFileName;
+    QString mMenuFileName;
+};
+
+QTEST_MAIN(TestBenchDesktopFile)
+
+#include "tst_bench_desktopfile.moc"
@@ -0,0 +1,146 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/DesktopMenu>
+
+/*
+ * Writes a menu with at most budget nodes, each with fanout sub-menus
+ * down to the given depth. Every menu also contains a duplicate of its
+ * first sub-menu, to be merged, and moves it into a new sub-menu.
+ */
+static void writeMenu(QTextStream &ts, const QString &name, int fanout, int depth, int &budget)
+{
+    ts << "<Menu><Name>" << name << "</Name>"
+       << "<Include><Category>" << name << "</Category></Include>\n";
+    --budget;
+
+    QString first;
+    for (int i = 0; i < fanout && depth > 0 && budget > 0; ++i) {
+        const QString child = QStringLiteral("m%1").arg(budget);
+        if (first.isEmpty())
+            first = child;
+        writeMenu(ts, child, fanout, depth - 1, budget);
+    }
+
+    if (!first.isEmpty()) {
+        ts << "<Menu><Name>" << first << "</Name><OnlyUnallocated/></Menu>\n"
+           << "<Move><Old>" << first << "</Old><New>moved/" << first << "</New></Move>\n";
+    }
+
+    ts << "</Menu>\n";
+}
+
+static bool writeMenuFile(const QString &fileName, int nodes, int fanout, int depth)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    QTextStream ts(&file);
+    ts << "<!DOCTYPE Menu PUBLIC \"-//freedesktop//DTD Menu 1.0//EN\"\n"
+          " \"http://www.freedesktop.org/standards/menu-spec/menu-1.0.dtd\">\n";
+    int budget = nodes;
+    writeMenu(ts, QStringLiteral("Applications"), fanout, depth, budget);
+    ts.flush();
+    return ts.status() == QTextStream::Ok;
+}
+
+// Best wall time of a few reads, in nanoseconds
+static qint64 readTime(const QString &fileName)
+{
+    qint64 best = -1;
+    for (int i = 0; i < 3; ++i) {
+        Liri::DesktopMenu menu;
+        QElapsedTimer timer;
+        timer.start();
+        if (!menu.read(fileName))
+            return -1;
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+class TestBenchDesktopMenu : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void read_data()
+    {
+        QTest::addColumn<int>("nodes");
+        QTest::addColumn<int>("fanout");
+        QTest::addColumn<int>("depth");
+
+        QTest::newRow("wide-1k") << 1000 << 1000 << 1;
+        QTest::newRow("wide-10k") << 10000 << 10000 << 1;
+        QTest::newRow("deep-1k") << 1000 << 2 << 20;
+        QTest::newRow("deep-10k") << 10000 << 2 << 20;
+    }
+
+    void read()
+    {
+        QFETCH(int, nodes);
+        QFETCH(int, fanout);
+        QFETCH(int, depth);
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        const QString fileName = dir.filePath(QStringLiteral("applications.menu"));
+        QVERIFY(writeMenuFile(fileName, nodes, fanout, depth));
+
+        Liri::DesktopMenu menu;
+        QBENCHMARK {
+            QVERIFY(menu.read(fileName));
+        }
+    }
+
+    void scaling_data()
+    {
+        QTest::addColumn<int>("smallFanout");
+        QTest::addColumn<int>("largeFanout");
+        QTest::addColumn<int>("depth");
+
+        QTest::newRow("wide") << 1000 << 10000 << 1;
+        QTest::newRow("deep") << 2 << 2 << 20;
+    }
+
+    /*
+     * Ten times the nodes should take about ten times longer. The bound
+     * is loose enough for noisy machines but still fails when merging
+     * or moving menus is quadratic again, which is a hundred times.
+     */
+    void scaling()
+    {
+        QFETCH(int, smallFanout);
+        QFETCH(int, largeFanout);
+        QFETCH(int, depth);
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        const QString small = dir.filePath(QStringLiteral("small.menu"));
+        const QString large = dir.filePath(QStringLiteral("large.menu"));
+        QVERIFY(writeMenuFile(small, 1000, smallFanout, depth));
+        QVERIFY(writeMenuFile(large, 10000, largeFanout, depth));
+
+        const qint64 smallTime = readTime(small);
+        const qint64 largeTime = readTime(large);
+        QVERIFY(smallTime > 0);
+        QVERIFY(largeTime > 0);
+
+        const double ratio = double(largeTime) / double(smallTime);
+        qInfo("1k nodes: %lld us, 10k nodes: %lld us, ratio %.1f",
+              smallTime / 1000, largeTime / 1000, ratio);
+        QVERIFY2(ratio < 30, qPrintable(QStringLiteral("Reading 10 times the nodes took %1 times longer").arg(ratio, 0, 'f', 1)));
+    }
+};
+
+QTEST_MAIN(TestBenchDesktopMenu)
+
+#include "tst_bench_desktopmenu.moc"
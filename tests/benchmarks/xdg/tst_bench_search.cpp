@@ -0,0 +1,88 @@
+// Copyright (C) 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QObject>
+#include <QtTest>
+
+#include <LiriXdg/DesktopFile>
+
+static const int corpusSize = 5000;
+
+/*
+ * Deterministic made up word, so that names share prefixes
+ * and trigrams like real application names do.
+ */
+static QString word(int seed)
+{
+    static const char *const syllables[] = {
+        "fi", "re", "fox", "ter", "mi", "nal", "ka", "te", "gim", "po", "wri", "ter",
+        "vi", "de", "o", "pla", "yer", "cal", "cu", "la", "tor", "mail", "chat", "net",
+    };
+    const int count = sizeof(syllables) / sizeof(syllables[0]);
+
+    QString result;
+    for (int i = 0; i < 3; ++i) {
+        result += QLatin1String(syllables[seed % count]);
+        seed = seed / count + i * 7;
+    }
+    return result;
+}
+
+class TestBenchSearch : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        const QString applications = mDir.filePath(QStringLiteral("applications"));
+        QVERIFY(QDir().mkpath(applications));
+
+        for (int i = 0; i < corpusSize; ++i) {
+            QFile file(QStringLiteral("%1/app%2.desktop").arg(applications).arg(i));
+            QVERIFY(file.open(QFile::WriteOnly | QFile::Text));
+            QTextStream ts(&file);
+            ts << "[Desktop Entry]\n"
+                  "Type=Application\n"
+                  "Name=" << word(i) << " " << word(i * 31 + 5) << "\n"
+                  "GenericName=" << word(i * 17 + 3) << "\n"
+                  "Comment=The " << word(i * 13 + 1) << " for " << word(i * 7 + 2) << "\n"
+                  "Keywords=" << word(i + 11) << ";" << word(i + 23) << ";\n"
+                  "Exec=" << word(i) << i << " %U\n";
+        }
+
+        // Must happen before the cache is created
+        qputenv("XDG_DATA_HOME", mDir.filePath(QStringLiteral("home")).toLocal8Bit());
+        qputenv("XDG_DATA_DIRS", mDir.path().toLocal8Bit());
+
+        QVERIFY(!Liri::DesktopFileCache::search(word(0)).isEmpty());
+    }
+
+    void search_data()
+    {
+        QTest::addColumn<QString>("query");
+
+        QTest::newRow("exact") << word(42);
+        QTest::newRow("prefix") << word(42).left(3);
+        QTest::newRow("typo") << QString(word(42)).replace(1, 1, QLatin1Char('x'));
+        QTest::newRow("two-words") << word(42) + QLatin1Char(' ') + word(42 * 31 + 5).left(4);
+    }
+
+    void search()
+    {
+        QFETCH(QString, query);
+
+        QBENCHMARK {
+            Liri::DesktopFileCache::search(query, 20);
+        }
+    }
+
+private:
+    QTemporaryDir mDir;
+};
+
+QTEST_MAIN(TestBenchSearch)
+
+#include "tst_bench_search.moc"